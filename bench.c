@@ -0,0 +1,308 @@
+/**
+ * @file bench.c
+ * @brief On-target microbenchmarks for the display driver and the controller.
+ *
+ * Built as the interactive-traffic-light-bench executable. It includes the
+ * application source (without its main()) so the benchmarks exercise the
+ * exact code that ships. Every run prints one CSV table:
+ *
+ *     benchmark,parameter,iterations,total_us,cycles_per_iter,ns_per_iter
+ *
+ * Loops are timed with the microsecond timer; single interrupts are timed
+ * in clk_sys cycles with SysTick. Runs are started from the serial console
+ * (press Enter), so results can be collected repeatedly without a reset.
+ */
+
+#define TRAFFIC_LIGHT_NO_MAIN 1
+#include "interactive-traffic-light.c"
+#include "hardware/structs/systick.h"
+
+#define BENCH_DRAW_ITERATIONS 2000
+#define BENCH_UPDATE_ITERATIONS 20
+#define BENCH_STATE_ITERATIONS 2000
+#define BENCH_ISR_ITERATIONS 1000
+
+/**
+ * @brief SysTick readings taken by bench_isr_handler().
+ */
+volatile uint32_t bench_isr_entry = 0;
+volatile uint32_t bench_isr_exit = 0;
+
+/**
+ * @brief Starts SysTick as a free-running 24-bit down counter at clk_sys.
+ */
+void bench_systick_start()
+{
+    systick_hw->csr = 0;
+    systick_hw->rvr = 0xFFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+}
+
+/**
+ * @brief Cycles elapsed between two SysTick readings (less than 2^24 apart).
+ */
+static inline uint32_t bench_cycles(uint32_t from, uint32_t to)
+{
+    return (from - to) & 0xFFFFFF;
+}
+
+/**
+ * @brief Prints one CSV row from a total loop time.
+ *
+ * @param name Benchmark name.
+ * @param param Benchmark parameter (e.g. I2C clock), or "".
+ * @param iterations Number of iterations timed.
+ * @param total_us Total time of all iterations.
+ */
+void bench_report(const char *name, const char *param, uint iterations, uint64_t total_us)
+{
+    uint64_t sys_mhz = clock_get_hz(clk_sys) / MHZ;
+    printf("%s,%s,%u,%llu,%llu,%llu\n", name, param, iterations, (unsigned long long)total_us,
+           (unsigned long long)(total_us * sys_mhz / iterations),
+           (unsigned long long)(total_us * 1000 / iterations));
+}
+
+/**
+ * @brief Prints one CSV row from a total cycle count.
+ */
+void bench_report_cycles(const char *name, const char *param, uint iterations, uint64_t cycles)
+{
+    uint64_t sys_mhz = clock_get_hz(clk_sys) / MHZ;
+    printf("%s,%s,%u,%llu,%llu,%llu\n", name, param, iterations, (unsigned long long)(cycles / sys_mhz),
+           (unsigned long long)(cycles / iterations),
+           (unsigned long long)(cycles * 1000 / sys_mhz / iterations));
+}
+
+/**
+ * @brief Glyph, string and icon rendering into the back buffer.
+ *
+ * Page-aligned and unaligned rows take different blit paths. The scaled
+ * strings and the icon are copied from the pre-scaled sprite atlas.
+ */
+void bench_draw()
+{
+    static const int rows[] = {16, 19};
+    char param[8];
+
+    for (uint r = 0; r < count_of(rows); r++)
+    {
+        snprintf(param, sizeof(param), "y=%d", rows[r]);
+        uint64_t start = time_us_64();
+        for (uint i = 0; i < BENCH_DRAW_ITERATIONS; i++)
+            ssd1306_draw_char((i % DISPLAY_COLUMNS) * CHAR_WIDTH, rows[r], 'A' + i % 26, i & 1);
+        bench_report("draw_char", param, BENCH_DRAW_ITERATIONS, time_us_64() - start);
+
+        start = time_us_64();
+        for (uint i = 0; i < BENCH_DRAW_ITERATIONS; i++)
+            ssd1306_draw_string(0, rows[r], "Traffic Light System", i & 1);
+        bench_report("draw_string_20", param, BENCH_DRAW_ITERATIONS, time_us_64() - start);
+
+        start = time_us_64();
+        for (uint i = 0; i < BENCH_DRAW_ITERATIONS; i++)
+            ssd1306_draw_string_scaled(0, rows[r], i & 1 ? "YELLOW" : "GREEN ", 2, true);
+        bench_report("draw_string_x2_6", param, BENCH_DRAW_ITERATIONS, time_us_64() - start);
+
+        start = time_us_64();
+        for (uint i = 0; i < BENCH_DRAW_ITERATIONS; i++)
+            ssd1306_draw_string_scaled(0, rows[r], i & 1 ? "12" : "34", 3, true);
+        bench_report("draw_string_x3_2", param, BENCH_DRAW_ITERATIONS, time_us_64() - start);
+    }
+
+    // Full-height icon, alternating so every iteration rewrites the columns
+    uint64_t start = time_us_64();
+    for (uint i = 0; i < BENCH_DRAW_ITERATIONS; i++)
+        ssd1306_draw_icon(0, 0, i & 1 ? SSD1306_ICON_WALK : SSD1306_ICON_HAND, true);
+    bench_report("draw_icon", "", BENCH_DRAW_ITERATIONS, time_us_64() - start);
+}
+
+/**
+ * @brief Fills the back buffer with text, inverted on odd frames.
+ *
+ * Consecutive frames differ in almost every column, so the update that
+ * follows is close to a full frame.
+ */
+void bench_fill_frame(uint frame)
+{
+    for (int y = 0; y < SSD1306_HEIGHT; y += 8)
+        ssd1306_draw_string(0, y, "#####################", frame & 1);
+}
+
+/**
+ * @brief Full and partial display updates at every I2C clock step.
+ *
+ * - update_full: blocking ssd1306_update() of a nearly full frame.
+ * - update_partial: blocking update after one digit changed.
+ * - update_async_full: ssd1306_update_async() until the bus is idle.
+ *
+ * Restores the clock chosen by the startup probe afterwards.
+ */
+void bench_update()
+{
+    char param[12];
+
+    for (uint r = 0; r < count_of(i2c_rates) && i2c_rates[r] <= I2C_MAX_BAUD; r++)
+    {
+        snprintf(param, sizeof(param), "%u", i2c_rates[r]);
+        ssd1306_set_baudrate(I2C_PORT, i2c_rates[r]);
+        ssd1306_take_error();
+
+        uint64_t total = 0;
+        for (uint i = 0; i < BENCH_UPDATE_ITERATIONS; i++)
+        {
+            bench_fill_frame(i);
+            ssd1306_present();
+            uint64_t start = time_us_64();
+            ssd1306_update(I2C_PORT);
+            total += time_us_64() - start;
+        }
+        bench_report("update_full", param, BENCH_UPDATE_ITERATIONS, total);
+
+        total = 0;
+        for (uint i = 0; i < BENCH_UPDATE_ITERATIONS; i++)
+        {
+            ssd1306_draw_char(60, 32, '0' + i % 10, true);
+            ssd1306_present();
+            uint64_t start = time_us_64();
+            ssd1306_update(I2C_PORT);
+            total += time_us_64() - start;
+        }
+        bench_report("update_partial", param, BENCH_UPDATE_ITERATIONS, total);
+
+        total = 0;
+        for (uint i = 0; i < BENCH_UPDATE_ITERATIONS; i++)
+        {
+            bench_fill_frame(i);
+            ssd1306_present();
+            uint64_t start = time_us_64();
+            ssd1306_update_async(I2C_PORT, NULL);
+            ssd1306_update_wait();
+            total += time_us_64() - start;
+        }
+        bench_report("update_async_full", param, BENCH_UPDATE_ITERATIONS, total);
+
+        if (ssd1306_take_error())
+            printf("# bus errors at %u Hz\n", i2c_rates[r]);
+    }
+
+    ssd1306_set_baudrate(I2C_PORT, i2c_rates[i2c_rate_index]);
+}
+
+/**
+ * @brief Cost of a phase change, with and without the signal write.
+ *
+ * Runs with interrupts masked; the event queue is emptied after every
+ * iteration so that posting never takes the drop path.
+ */
+void bench_change_state()
+{
+    struct intersection *x = &intersections[0];
+    uint32_t irq_status = save_and_disable_interrupts();
+
+    uint64_t start = time_us_64();
+    for (uint i = 0; i < BENCH_STATE_ITERATIONS; i++)
+    {
+        change_state(x);
+        event_tail = event_head;
+    }
+    uint64_t change_us = time_us_64() - start;
+
+    start = time_us_64();
+    for (uint i = 0; i < BENCH_STATE_ITERATIONS; i++)
+    {
+        change_state(x);
+        flush_signals();
+        event_tail = event_head;
+    }
+    uint64_t flush_us = time_us_64() - start;
+
+    enter_phase(x, RED);
+    flush_signals();
+    event_tail = event_head;
+    restore_interrupts(irq_status);
+
+    bench_report("change_state", "", BENCH_STATE_ITERATIONS, change_us);
+    bench_report("change_state_flush", "", BENCH_STATE_ITERATIONS, flush_us);
+}
+
+/**
+ * @brief Spare-IRQ handler that runs the button ISR body between two SysTick reads.
+ */
+void bench_isr_handler()
+{
+    bench_isr_entry = systick_hw->cvr;
+    button_pio_irq_handler();
+    bench_isr_exit = systick_hw->cvr;
+}
+
+/**
+ * @brief Interrupt entry, body and exit cycles.
+ *
+ * A spare user IRQ is pended by software and runs the real button ISR
+ * body (with empty FIFOs):
+ * - isr_entry: from pending the IRQ to the first handler instruction.
+ * - isr_body: handler execution.
+ * - isr_exit: from the last handler instruction back to the caller.
+ */
+void bench_isr()
+{
+    uint irq = user_irq_claim_unused(true);
+    irq_set_exclusive_handler(irq, bench_isr_handler);
+    irq_set_enabled(irq, true);
+
+    uint64_t entry = 0, body = 0, exit = 0;
+    for (uint i = 0; i < BENCH_ISR_ITERATIONS; i++)
+    {
+        uint32_t before = systick_hw->cvr;
+        irq_set_pending(irq);
+        uint32_t after = systick_hw->cvr;
+        entry += bench_cycles(before, bench_isr_entry);
+        body += bench_cycles(bench_isr_entry, bench_isr_exit);
+        exit += bench_cycles(bench_isr_exit, after);
+    }
+
+    irq_set_enabled(irq, false);
+    irq_remove_handler(irq, bench_isr_handler);
+    user_irq_unclaim(irq);
+
+    bench_report_cycles("isr_entry", "", BENCH_ISR_ITERATIONS, entry);
+    bench_report_cycles("isr_body", "", BENCH_ISR_ITERATIONS, body);
+    bench_report_cycles("isr_exit", "", BENCH_ISR_ITERATIONS, exit);
+}
+
+/**
+ * @brief Runs every benchmark and prints the CSV table.
+ */
+void run_benchmarks()
+{
+    printf("benchmark,parameter,iterations,total_us,cycles_per_iter,ns_per_iter\n");
+    bench_draw();
+    bench_update();
+    bench_change_state();
+    bench_isr();
+    printf("# done, clk_sys %lu Hz, display I2C %u Hz\n",
+           (unsigned long)clock_get_hz(clk_sys), i2c_rates[i2c_rate_index]);
+
+    // Leave a clean screen behind
+    ssd1306_clear();
+    ssd1306_present();
+    ssd1306_update(I2C_PORT);
+}
+
+int main()
+{
+    init_signals();
+    setup();
+    init_display();
+    bench_systick_start();
+
+    while (true)
+    {
+        printf("# press Enter to run the benchmarks\n");
+        int c = getchar_timeout_us(2000000);
+        if (c == '\r' || c == '\n')
+            run_benchmarks();
+    }
+
+    return 0;
+}
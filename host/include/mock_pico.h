@@ -0,0 +1,491 @@
+/**
+ * @file mock_pico.h
+ * @brief Host-side stand-in for the subset of the Pico SDK the firmware uses.
+ *
+ * Every SDK header the firmware includes (pico/stdlib.h, hardware/i2c.h,
+ * ...) resolves to a one-line file under host/include that includes this
+ * header, so interactive-traffic-light.c and ssd1306.c compile unchanged
+ * for the host. The implementation lives in host/mock_pico.c:
+ *
+ * - A virtual microsecond clock. Time only moves when the firmware sleeps
+ *   or waits on the bus, or when the simulator advances it; code itself
+ *   runs in zero time.
+ * - Alarms and other timed work (DMA completion, injected button presses)
+ *   run from a single timer list, in "interrupt context", unless masked
+ *   with save_and_disable_interrupts().
+ * - GPIO levels with per-pin transition counters.
+ * - PIO state machines reduced to what the firmware relies on: button
+ *   state machines push presses into their RX FIFO, the signal output
+ *   state machine drives its pin window.
+ * - An I2C sink that decodes the SSD1306 command/data protocol into a
+ *   virtual GDDRAM. Blocking writes and DMA streams take 9 bit times per
+ *   byte at the configured baud rate.
+ * - A 2 MB flash array mapped at XIP_BASE. Erasing a sector takes 45 ms
+ *   and programming a page 1 ms of virtual time, with interrupts held off
+ *   like on the device when the caller masked them.
+ * - A watchdog that never resets the host; a feed that comes later than
+ *   the timeout is counted instead. Its scratch registers can be preset to
+ *   simulate a boot after a watchdog reset.
+ *
+ * The second half of the file is the simulator control API (mock_*).
+ */
+
+#ifndef MOCK_PICO_H
+#define MOCK_PICO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef unsigned int uint;
+
+//
+// pico/types.h, pico/platform.h
+//
+
+#define PICO_ERROR_NONE 0
+#define PICO_ERROR_TIMEOUT -1
+#define PICO_ERROR_GENERIC -2
+
+#define KHZ 1000
+#define MHZ 1000000
+
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+#ifndef MIN
+#define MIN(a, b) ((b) > (a) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+#define __not_in_flash_func(f) f
+#define __time_critical_func(f) f
+#define __unused __attribute__((unused))
+
+static inline void tight_loop_contents(void) {}
+
+//
+// pico/time.h, hardware/timer.h
+//
+
+typedef uint64_t absolute_time_t;
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+
+static inline uint64_t to_us_since_boot(absolute_time_t t) { return t; }
+static inline absolute_time_t from_us_since_boot(uint64_t us) { return us; }
+
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+absolute_time_t get_absolute_time(void);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+alarm_id_t add_alarm_at(absolute_time_t time, alarm_callback_t callback, void *user_data, bool fire_if_past);
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past);
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data, bool fire_if_past);
+bool cancel_alarm(alarm_id_t alarm_id);
+
+//
+// hardware/sync.h
+//
+
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+void __wfi(void);
+void __wfe(void);
+void __sev(void);
+static inline void __mem_fence_acquire(void) { __atomic_thread_fence(__ATOMIC_ACQUIRE); }
+static inline void __mem_fence_release(void) { __atomic_thread_fence(__ATOMIC_RELEASE); }
+static inline void __compiler_memory_barrier(void) { __atomic_signal_fence(__ATOMIC_SEQ_CST); }
+
+//
+// hardware/irq.h
+//
+
+typedef void (*irq_handler_t)(void);
+
+enum irq_num {
+    TIMER_IRQ_0, TIMER_IRQ_1, TIMER_IRQ_2, TIMER_IRQ_3, PWM_IRQ_WRAP, USBCTRL_IRQ, XIP_IRQ,
+    PIO0_IRQ_0, PIO0_IRQ_1, PIO1_IRQ_0, PIO1_IRQ_1, DMA_IRQ_0, DMA_IRQ_1, IO_IRQ_BANK0, IO_IRQ_QSPI,
+    SIO_IRQ_PROC0, SIO_IRQ_PROC1, CLOCKS_IRQ, SPI0_IRQ, SPI1_IRQ, UART0_IRQ, UART1_IRQ,
+    ADC_IRQ_FIFO, I2C0_IRQ, I2C1_IRQ, RTC_IRQ, MOCK_IRQ_COUNT
+};
+
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority);
+void irq_remove_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+void irq_set_pending(uint num);
+
+//
+// hardware/clocks.h, hardware/pll.h, hardware/xosc.h
+//
+
+enum clock_index { clk_gpout0, clk_gpout1, clk_gpout2, clk_gpout3, clk_ref, clk_sys, clk_peri, clk_usb, clk_adc,
+                   clk_rtc, CLK_COUNT };
+
+#define CLOCKS_CLK_REF_CTRL_SRC_VALUE_XOSC_CLKSRC 2
+#define CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLK_REF 0
+#define CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX 1
+#define CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS 0
+#define CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB 1
+#define CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_XOSC_CLKSRC 3
+#define CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLK_SYS 0
+#define CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB 2
+#define CLOCKS_CLK_USB_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB 0
+#define CLOCKS_CLK_ADC_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB 0
+#define CLOCKS_CLK_RTC_CTRL_AUXSRC_VALUE_XOSC_CLKSRC 3
+#define XOSC_KHZ 12000
+#define USB_CLK_KHZ 48000
+
+typedef struct pll_hw pll_hw_t;
+typedef pll_hw_t *PLL;
+extern pll_hw_t *const pll_sys;
+extern pll_hw_t *const pll_usb;
+
+uint32_t clock_get_hz(enum clock_index clk_index);
+bool clock_configure(enum clock_index clk_index, uint32_t src, uint32_t auxsrc, uint32_t src_freq, uint32_t freq);
+void clock_stop(enum clock_index clk_index);
+void clocks_init(void);
+bool set_sys_clock_khz(uint32_t freq_khz, bool required);
+void pll_init(PLL pll, uint ref_div, uint vco_freq, uint post_div1, uint post_div2);
+void pll_deinit(PLL pll);
+void xosc_init(void);
+void xosc_dormant(void);
+
+//
+// hardware/gpio.h
+//
+
+#define NUM_BANK0_GPIOS 30
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+enum gpio_irq_level {
+    GPIO_IRQ_LEVEL_LOW = 0x1u,
+    GPIO_IRQ_LEVEL_HIGH = 0x2u,
+    GPIO_IRQ_EDGE_FALL = 0x4u,
+    GPIO_IRQ_EDGE_RISE = 0x8u,
+};
+
+enum gpio_function {
+    GPIO_FUNC_XIP = 0, GPIO_FUNC_SPI = 1, GPIO_FUNC_UART = 2, GPIO_FUNC_I2C = 3, GPIO_FUNC_PWM = 4,
+    GPIO_FUNC_SIO = 5, GPIO_FUNC_PIO0 = 6, GPIO_FUNC_PIO1 = 7, GPIO_FUNC_GPCK = 8, GPIO_FUNC_USB = 9,
+    GPIO_FUNC_NULL = 0x1f,
+};
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+
+void gpio_init(uint gpio);
+void gpio_init_mask(uint32_t mask);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_set_dir_out_masked(uint32_t mask);
+void gpio_pull_up(uint gpio);
+void gpio_put(uint gpio, bool value);
+void gpio_put_masked(uint32_t mask, uint32_t value);
+bool gpio_get(uint gpio);
+uint32_t gpio_get_all(void);
+void gpio_set_irq_callback(gpio_irq_callback_t callback);
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled);
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback);
+void gpio_set_dormant_irq_enabled(uint gpio, uint32_t event_mask, bool enabled);
+void gpio_acknowledge_irq(uint gpio, uint32_t event_mask);
+uint32_t gpio_get_irq_event_mask(uint gpio);
+
+//
+// hardware/pwm.h
+//
+
+typedef struct {
+    uint32_t csr;
+    uint32_t div;
+    uint32_t top;
+} pwm_config;
+
+uint pwm_gpio_to_slice_num(uint gpio);
+uint pwm_gpio_to_channel(uint gpio);
+pwm_config pwm_get_default_config(void);
+void pwm_config_set_clkdiv(pwm_config *c, float div);
+void pwm_config_set_wrap(pwm_config *c, uint16_t wrap);
+void pwm_init(uint slice_num, pwm_config *c, bool start);
+void pwm_set_clkdiv(uint slice_num, float divider);
+void pwm_set_wrap(uint slice_num, uint16_t wrap);
+void pwm_set_gpio_level(uint gpio, uint16_t level);
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level);
+void pwm_set_enabled(uint slice_num, bool enabled);
+
+//
+// hardware/i2c.h
+//
+
+#define I2C_IC_DATA_CMD_STOP_BITS 0x00000200u
+#define I2C_IC_DATA_CMD_RESTART_BITS 0x00000400u
+#define I2C_IC_STATUS_TFE_BITS 0x00000004u
+#define I2C_IC_STATUS_MST_ACTIVITY_BITS 0x00000020u
+#define I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS 0x00000040u
+
+typedef struct {
+    volatile uint32_t con, tar, data_cmd, status, enable, raw_intr_stat, clr_tx_abrt, tx_abrt_source, txflr,
+        dma_cr;
+} i2c_hw_t;
+
+typedef struct i2c_inst {
+    i2c_hw_t *hw;
+    bool restart_on_next;
+} i2c_inst_t;
+
+extern i2c_inst_t i2c0_inst;
+extern i2c_inst_t i2c1_inst;
+#define i2c0 (&i2c0_inst)
+#define i2c1 (&i2c1_inst)
+
+static inline i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c) { return i2c->hw; }
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+void i2c_deinit(i2c_inst_t *i2c);
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate);
+uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx);
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop,
+                         uint timeout_us);
+
+//
+// hardware/dma.h
+//
+
+typedef enum { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 } dma_channel_transfer_size_t;
+
+typedef struct {
+    uint32_t ctrl;
+} dma_channel_config;
+
+int dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(uint channel);
+dma_channel_config dma_channel_get_default_config(uint channel);
+void channel_config_set_transfer_data_size(dma_channel_config *c, dma_channel_transfer_size_t size);
+void channel_config_set_read_increment(dma_channel_config *c, bool incr);
+void channel_config_set_write_increment(dma_channel_config *c, bool incr);
+void channel_config_set_dreq(dma_channel_config *c, uint dreq);
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger);
+bool dma_channel_is_busy(uint channel);
+void dma_channel_wait_for_finish_blocking(uint channel);
+void dma_channel_abort(uint channel);
+void dma_channel_set_irq0_enabled(uint channel, bool enabled);
+bool dma_channel_get_irq0_status(uint channel);
+void dma_channel_acknowledge_irq0(uint channel);
+
+//
+// hardware/pio.h
+//
+
+typedef struct pio_hw pio_hw_t;
+typedef pio_hw_t *PIO;
+
+extern pio_hw_t *const mock_pios[2];
+#define pio0 (mock_pios[0])
+#define pio1 (mock_pios[1])
+
+typedef struct pio_program {
+    const uint16_t *instructions;
+    uint8_t length;
+    int8_t origin;
+} pio_program_t;
+
+typedef struct {
+    int jmp_pin;
+    uint out_base;
+    uint out_count;
+    float clkdiv;
+} pio_sm_config;
+
+enum pio_fifo_join { PIO_FIFO_JOIN_NONE = 0, PIO_FIFO_JOIN_TX = 1, PIO_FIFO_JOIN_RX = 2 };
+
+enum pio_interrupt_source {
+    pis_sm0_rx_fifo_not_empty = 0, pis_sm1_rx_fifo_not_empty, pis_sm2_rx_fifo_not_empty, pis_sm3_rx_fifo_not_empty,
+    pis_sm0_tx_fifo_not_full, pis_sm1_tx_fifo_not_full, pis_sm2_tx_fifo_not_full, pis_sm3_tx_fifo_not_full,
+};
+
+pio_sm_config pio_get_default_sm_config(void);
+void sm_config_set_jmp_pin(pio_sm_config *c, uint pin);
+void sm_config_set_out_pins(pio_sm_config *c, uint out_base, uint out_count);
+void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint pull_threshold);
+void sm_config_set_in_shift(pio_sm_config *c, bool shift_right, bool autopush, uint push_threshold);
+void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join);
+void sm_config_set_clkdiv(pio_sm_config *c, float div);
+
+uint pio_add_program(PIO pio, const pio_program_t *program);
+int pio_claim_unused_sm(PIO pio, bool required);
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_sm_set_clkdiv(PIO pio, uint sm, float div);
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t pin_values, uint32_t pin_mask);
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t pin_dirs, uint32_t pin_mask);
+void pio_gpio_init(PIO pio, uint pin);
+void pio_set_irq0_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled);
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm);
+uint32_t pio_sm_get(PIO pio, uint sm);
+void pio_sm_put(PIO pio, uint sm, uint32_t data);
+
+//
+// pico/stdio.h, pico/multicore.h
+//
+
+bool stdio_init_all(void);
+void stdio_set_chars_available_callback(void (*fn)(void *), void *param);
+int getchar_timeout_us(uint32_t timeout_us);
+int putchar_raw(int c);
+void stdio_flush(void);
+int mock_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+#define printf mock_printf
+
+void multicore_launch_core1(void (*entry)(void));
+void multicore_lockout_victim_init(void);
+void multicore_lockout_start_blocking(void);
+void multicore_lockout_end_blocking(void);
+
+//
+// hardware/flash.h
+//
+
+#define FLASH_PAGE_SIZE (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+
+extern uint8_t mock_flash[PICO_FLASH_SIZE_BYTES];
+#define XIP_BASE ((uintptr_t)mock_flash)
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count);
+
+//
+// hardware/watchdog.h
+//
+
+typedef struct {
+    uint32_t scratch[8];
+} watchdog_hw_t;
+
+extern watchdog_hw_t *const watchdog_hw;
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug);
+void watchdog_update(void);
+bool watchdog_caused_reboot(void);
+bool watchdog_enable_caused_reboot(void);
+
+//
+// Simulator control
+//
+
+/**
+ * @brief Timed work queued on the virtual clock.
+ *
+ * Runs in interrupt context at its due time.
+ */
+typedef void (*mock_timer_fn_t)(void *data);
+
+/**
+ * @brief Counters kept by the mock peripherals.
+ */
+struct mock_stats {
+    uint64_t irqs;               // Interrupt-context callbacks run
+    uint64_t gpio_transitions;   // Output level changes on any pin
+    uint64_t i2c_transactions;   // Blocking writes plus DMA streams
+    uint64_t i2c_bytes;          // Bytes clocked onto the bus
+    uint64_t i2c_errors;         // Writes refused by the injected fault
+    uint64_t display_data_bytes; // GDDRAM bytes written by the panel
+    uint64_t console_bytes;      // Bytes printed or written raw
+    uint64_t pio_rx_overflows;   // Presses lost to a full RX FIFO
+    uint64_t alarms_added;       // Alarms taken from the pool
+    uint64_t pwm_tones;          // PWM outputs switched on (buzzer tones started)
+    uint64_t flash_erases;       // Sectors erased
+    uint64_t flash_programs;     // Pages programmed
+    uint64_t flash_unmasked;     // Flash operations started with interrupts enabled
+    uint64_t watchdog_feeds;     // watchdog_update() calls
+    uint64_t watchdog_timeouts;  // Feeds (or the end of the run) later than the timeout
+};
+
+extern struct mock_stats mock_stats;
+
+/**
+ * @brief Queues work on the virtual clock.
+ *
+ * @param at_us Due time, in microseconds since boot.
+ * @param fn Callback, run in interrupt context.
+ * @param data Callback argument.
+ * @return false if the timer list is full.
+ */
+bool mock_timer_add(uint64_t at_us, mock_timer_fn_t fn, void *data);
+
+/**
+ * @brief Advances the virtual clock, running every timer due on the way.
+ *
+ * @param until_us Target time, in microseconds since boot.
+ */
+void mock_run_until(uint64_t until_us);
+
+/**
+ * @brief Advances the virtual clock to the next timer and runs it.
+ *
+ * The equivalent of sleeping in WFI until the next interrupt.
+ *
+ * @param limit_us Do not advance past this time.
+ * @return false if no timer was due before limit_us.
+ */
+bool mock_wait_for_irq(uint64_t limit_us);
+
+/**
+ * @brief Installs a function called after every interrupt-context callback.
+ */
+void mock_set_irq_hook(void (*hook)(void));
+
+/**
+ * @brief Simulates one debounced press of a button.
+ *
+ * The press is pushed into the RX FIFO of the PIO state machine reading
+ * the pin, raising its interrupt; a button without a state machine gets
+ * a falling-edge GPIO interrupt instead.
+ *
+ * @param gpio Button GPIO.
+ */
+void mock_button_press(uint gpio);
+
+/**
+ * @brief Makes the panel stop acknowledging above a bus clock.
+ *
+ * @param max_baud Highest clock the panel follows; 0 for no limit.
+ */
+void mock_i2c_set_max_baud(uint max_baud);
+
+/**
+ * @brief Virtual GDDRAM of the panel, page by page.
+ *
+ * Each page holds MOCK_PANEL_COLUMNS bytes, enough for the 132-column
+ * SH1106; an SSD1306 uses the first 128.
+ */
+#define MOCK_PANEL_COLUMNS 132
+const uint8_t *mock_display_ram(void);
+
+/**
+ * @brief Enables or mutes console output (counted either way).
+ */
+void mock_set_console(bool enabled);
+
+/**
+ * @brief Makes the next boot look like one after a watchdog reset.
+ *
+ * @param timeout true for a reset by the watchdog timer, false for a
+ *                reboot requested through the watchdog.
+ */
+void mock_watchdog_set_reboot(bool timeout);
+
+/**
+ * @brief Checks the watchdog at the end of a run, like one more feed.
+ */
+void mock_watchdog_check(void);
+
+#endif // MOCK_PICO_H
@@ -0,0 +1,1050 @@
+/**
+ * @file mock_pico.c
+ * @brief Mock Pico HAL for the host simulator.
+ *
+ * See mock_pico.h for the model. Everything runs on one host thread:
+ * "interrupts" are timer list entries run by mock_run_until(),
+ * mock_wait_for_irq() and by any call that advances the virtual clock
+ * (sleeps and blocking bus transfers) while interrupts are enabled.
+ * Interrupt-context callbacks never nest, like handlers sharing one
+ * NVIC priority on the device.
+ */
+
+#include <stdarg.h>
+#include <string.h>
+
+#include "mock_pico.h"
+
+#define MOCK_TIMER_SLOTS 64
+#define MOCK_IRQ_HANDLERS 4
+#define MOCK_PIO_SMS 4
+#define MOCK_PIO_RX_DEPTH 8 // RX FIFO joined
+#define MOCK_DMA_CHANNELS 12
+#define MOCK_PANEL_ADDR 0x3C
+#define MOCK_PANEL_RAM (MOCK_PANEL_COLUMNS * 8)
+
+struct mock_stats mock_stats = {0};
+
+//
+// Virtual clock and timer list
+//
+
+/**
+ * @brief One entry of the timer list: either an SDK alarm or mock work.
+ */
+struct mock_timer {
+    bool used;
+    uint64_t at_us;
+    uint64_t order; // Entries due at the same time run in insertion order
+    alarm_id_t alarm_id;
+    alarm_callback_t alarm_callback;
+    mock_timer_fn_t fn;
+    void *data;
+};
+
+static struct mock_timer timers[MOCK_TIMER_SLOTS];
+static uint64_t timer_order = 0;
+static alarm_id_t next_alarm_id = 1;
+static uint64_t now_us = 0;
+static uint32_t irq_mask_depth = 0; // save_and_disable_interrupts() nesting
+static bool in_irq = false;
+static void (*irq_hook)(void) = NULL;
+
+static struct mock_timer *timer_insert(uint64_t at_us) {
+    for (uint i = 0; i < MOCK_TIMER_SLOTS; i++) {
+        if (!timers[i].used) {
+            memset(&timers[i], 0, sizeof(timers[i]));
+            timers[i].used = true;
+            timers[i].at_us = at_us;
+            timers[i].order = timer_order++;
+            return &timers[i];
+        }
+    }
+    return NULL;
+}
+
+static struct mock_timer *timer_earliest(void) {
+    struct mock_timer *best = NULL;
+    for (uint i = 0; i < MOCK_TIMER_SLOTS; i++) {
+        struct mock_timer *t = &timers[i];
+        if (t->used && (!best || t->at_us < best->at_us || (t->at_us == best->at_us && t->order < best->order)))
+            best = t;
+    }
+    return best;
+}
+
+/**
+ * @brief Runs one timer entry in interrupt context and frees its slot.
+ */
+static void timer_run(struct mock_timer *t) {
+    struct mock_timer entry = *t;
+    t->used = false;
+    if (entry.at_us > now_us)
+        now_us = entry.at_us;
+
+    in_irq = true;
+    mock_stats.irqs++;
+    if (entry.alarm_callback) {
+        uint64_t started_us = now_us;
+        int64_t repeat = entry.alarm_callback(entry.alarm_id, entry.data);
+        if (repeat) {
+            // < 0: relative to the previous target; > 0: to the callback return
+            struct mock_timer *again = timer_insert(repeat < 0 ? entry.at_us - repeat : started_us + repeat);
+            if (again) {
+                again->alarm_id = entry.alarm_id;
+                again->alarm_callback = entry.alarm_callback;
+                again->data = entry.data;
+            }
+        }
+    } else {
+        entry.fn(entry.data);
+    }
+    in_irq = false;
+
+    if (irq_hook)
+        irq_hook();
+}
+
+/**
+ * @brief Runs every entry due by `until_us`, if interrupts may be taken now.
+ */
+static void timers_dispatch(uint64_t until_us) {
+    if (in_irq || irq_mask_depth)
+        return;
+    struct mock_timer *t;
+    while ((t = timer_earliest()) && t->at_us <= until_us)
+        timer_run(t);
+}
+
+/**
+ * @brief Moves the clock forward from any context.
+ *
+ * From thread context with interrupts enabled the entries due on the way
+ * run at their own time; otherwise they stay pending until the interrupt
+ * returns or interrupts are restored.
+ */
+static void clock_advance(uint64_t us) {
+    uint64_t target = now_us + us;
+    timers_dispatch(target);
+    if (target > now_us)
+        now_us = target;
+}
+
+/**
+ * @brief Removes queued mock work matching a callback and argument.
+ */
+static void timer_cancel(mock_timer_fn_t fn, void *data) {
+    for (uint i = 0; i < MOCK_TIMER_SLOTS; i++)
+        if (timers[i].used && timers[i].fn == fn && timers[i].data == data)
+            timers[i].used = false;
+}
+
+bool mock_timer_add(uint64_t at_us, mock_timer_fn_t fn, void *data) {
+    struct mock_timer *t = timer_insert(at_us);
+    if (!t)
+        return false;
+    t->fn = fn;
+    t->data = data;
+    return true;
+}
+
+void mock_run_until(uint64_t until_us) {
+    timers_dispatch(until_us);
+    if (until_us > now_us)
+        now_us = until_us;
+}
+
+bool mock_wait_for_irq(uint64_t limit_us) {
+    struct mock_timer *t = timer_earliest();
+    if (!t || t->at_us > limit_us) {
+        if (limit_us > now_us)
+            now_us = limit_us;
+        return false;
+    }
+    timer_run(t);
+    timers_dispatch(now_us);
+    return true;
+}
+
+void mock_set_irq_hook(void (*hook)(void)) {
+    irq_hook = hook;
+}
+
+uint64_t time_us_64(void) {
+    return now_us;
+}
+
+uint32_t time_us_32(void) {
+    return (uint32_t)now_us;
+}
+
+absolute_time_t get_absolute_time(void) {
+    return now_us;
+}
+
+void sleep_us(uint64_t us) {
+    clock_advance(us);
+}
+
+void sleep_ms(uint32_t ms) {
+    clock_advance((uint64_t)ms * 1000);
+}
+
+alarm_id_t add_alarm_at(absolute_time_t time, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    if (time <= now_us && !fire_if_past)
+        return 0;
+    struct mock_timer *t = timer_insert(time);
+    if (!t)
+        return -1;
+    mock_stats.alarms_added++;
+    t->alarm_id = next_alarm_id++;
+    if (next_alarm_id <= 0)
+        next_alarm_id = 1;
+    t->alarm_callback = callback;
+    t->data = user_data;
+    alarm_id_t id = t->alarm_id;
+    timers_dispatch(now_us);
+    return id;
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    return add_alarm_at(now_us + us, callback, user_data, fire_if_past);
+}
+
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    return add_alarm_at(now_us + (uint64_t)ms * 1000, callback, user_data, fire_if_past);
+}
+
+bool cancel_alarm(alarm_id_t alarm_id) {
+    for (uint i = 0; i < MOCK_TIMER_SLOTS; i++) {
+        if (timers[i].used && timers[i].alarm_callback && timers[i].alarm_id == alarm_id) {
+            timers[i].used = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+//
+// Interrupts
+//
+
+static struct {
+    bool enabled;
+    irq_handler_t handlers[MOCK_IRQ_HANDLERS];
+} irqs[MOCK_IRQ_COUNT];
+
+uint32_t save_and_disable_interrupts(void) {
+    return irq_mask_depth++;
+}
+
+void restore_interrupts(uint32_t status) {
+    irq_mask_depth = status;
+    timers_dispatch(now_us);
+}
+
+void __wfi(void) {
+    if (!in_irq)
+        mock_wait_for_irq(UINT64_MAX);
+}
+
+void __wfe(void) {
+    __wfi();
+}
+
+void __sev(void) {}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+    memset(irqs[num].handlers, 0, sizeof(irqs[num].handlers));
+    irqs[num].handlers[0] = handler;
+}
+
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority) {
+    for (uint i = 0; i < MOCK_IRQ_HANDLERS; i++) {
+        if (!irqs[num].handlers[i]) {
+            irqs[num].handlers[i] = handler;
+            return;
+        }
+    }
+}
+
+void irq_remove_handler(uint num, irq_handler_t handler) {
+    for (uint i = 0; i < MOCK_IRQ_HANDLERS; i++)
+        if (irqs[num].handlers[i] == handler)
+            irqs[num].handlers[i] = NULL;
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+    irqs[num].enabled = enabled;
+}
+
+/**
+ * @brief Timer entry that enters the handlers of one interrupt line.
+ */
+static void irq_run(void *data) {
+    uint num = (uintptr_t)data;
+    if (!irqs[num].enabled)
+        return;
+    for (uint i = 0; i < MOCK_IRQ_HANDLERS; i++)
+        if (irqs[num].handlers[i])
+            irqs[num].handlers[i]();
+}
+
+void irq_set_pending(uint num) {
+    mock_timer_add(now_us, irq_run, (void *)(uintptr_t)num);
+    timers_dispatch(now_us);
+}
+
+//
+// Clocks
+//
+
+struct pll_hw {
+    uint32_t vco_hz;
+};
+
+static pll_hw_t plls[2];
+pll_hw_t *const pll_sys = &plls[0];
+pll_hw_t *const pll_usb = &plls[1];
+
+static uint32_t clock_hz[CLK_COUNT] = {
+    [clk_ref] = 12 * MHZ, [clk_sys] = 125 * MHZ, [clk_peri] = 125 * MHZ,
+    [clk_usb] = 48 * MHZ, [clk_adc] = 48 * MHZ,  [clk_rtc] = 46875,
+};
+
+uint32_t clock_get_hz(enum clock_index clk_index) {
+    return clock_hz[clk_index];
+}
+
+bool clock_configure(enum clock_index clk_index, uint32_t src, uint32_t auxsrc, uint32_t src_freq, uint32_t freq) {
+    if (freq > src_freq)
+        return false;
+    clock_hz[clk_index] = freq;
+    return true;
+}
+
+void clock_stop(enum clock_index clk_index) {
+    clock_hz[clk_index] = 0;
+}
+
+void clocks_init(void) {}
+
+bool set_sys_clock_khz(uint32_t freq_khz, bool required) {
+    clock_hz[clk_sys] = freq_khz * KHZ;
+    return true;
+}
+
+void pll_init(PLL pll, uint ref_div, uint vco_freq, uint post_div1, uint post_div2) {
+    pll->vco_hz = vco_freq;
+}
+
+void pll_deinit(PLL pll) {
+    pll->vco_hz = 0;
+}
+
+void xosc_init(void) {}
+
+void xosc_dormant(void) {}
+
+//
+// GPIO
+//
+
+static uint32_t gpio_levels = 0;
+static uint32_t gpio_dirs = 0;
+static uint32_t gpio_fall_irqs = 0;
+static gpio_irq_callback_t gpio_callback = NULL;
+
+/**
+ * @brief Sets output levels under a mask, counting the pins that change.
+ */
+static void gpio_drive(uint32_t mask, uint32_t value) {
+    uint32_t levels = (gpio_levels & ~mask) | (value & mask);
+    mock_stats.gpio_transitions += __builtin_popcount(levels ^ gpio_levels);
+    gpio_levels = levels;
+}
+
+void gpio_init(uint gpio) {
+    gpio_init_mask(1u << gpio);
+}
+
+void gpio_init_mask(uint32_t mask) {
+    gpio_dirs &= ~mask;
+    gpio_levels &= ~mask;
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {}
+
+void gpio_set_dir(uint gpio, bool out) {
+    if (out)
+        gpio_dirs |= 1u << gpio;
+    else
+        gpio_dirs &= ~(1u << gpio);
+}
+
+void gpio_set_dir_out_masked(uint32_t mask) {
+    gpio_dirs |= mask;
+}
+
+void gpio_pull_up(uint gpio) {
+    // Buttons are never held down: an input with its pull-up reads high
+    if (!(gpio_dirs & (1u << gpio)))
+        gpio_levels |= 1u << gpio;
+}
+
+void gpio_put(uint gpio, bool value) {
+    gpio_drive(1u << gpio, value ? 1u << gpio : 0);
+}
+
+void gpio_put_masked(uint32_t mask, uint32_t value) {
+    gpio_drive(mask, value);
+}
+
+bool gpio_get(uint gpio) {
+    return gpio_levels & (1u << gpio);
+}
+
+uint32_t gpio_get_all(void) {
+    return gpio_levels;
+}
+
+void gpio_set_irq_callback(gpio_irq_callback_t callback) {
+    gpio_callback = callback;
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled) {
+    if (!(event_mask & GPIO_IRQ_EDGE_FALL))
+        return;
+    if (enabled)
+        gpio_fall_irqs |= 1u << gpio;
+    else
+        gpio_fall_irqs &= ~(1u << gpio);
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback) {
+    gpio_set_irq_callback(callback);
+    gpio_set_irq_enabled(gpio, event_mask, enabled);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+void gpio_set_dormant_irq_enabled(uint gpio, uint32_t event_mask, bool enabled) {}
+
+void gpio_acknowledge_irq(uint gpio, uint32_t event_mask) {}
+
+uint32_t gpio_get_irq_event_mask(uint gpio) {
+    return 0;
+}
+
+/**
+ * @brief Timer entry delivering a falling edge to the GPIO callback.
+ */
+static void gpio_edge_run(void *data) {
+    uint gpio = (uintptr_t)data;
+    if (irqs[IO_IRQ_BANK0].enabled && (gpio_fall_irqs & (1u << gpio)) && gpio_callback)
+        gpio_callback(gpio, GPIO_IRQ_EDGE_FALL);
+}
+
+//
+// PWM (the buzzer is silent; only the tones started are counted)
+//
+
+static uint16_t pwm_levels[NUM_BANK0_GPIOS];
+
+uint pwm_gpio_to_slice_num(uint gpio) {
+    return (gpio >> 1) & 7;
+}
+
+uint pwm_gpio_to_channel(uint gpio) {
+    return gpio & 1;
+}
+
+pwm_config pwm_get_default_config(void) {
+    pwm_config c = {0, 1 << 4, 0xffff};
+    return c;
+}
+
+void pwm_config_set_clkdiv(pwm_config *c, float div) {
+    c->div = (uint32_t)(div * 16);
+}
+
+void pwm_config_set_wrap(pwm_config *c, uint16_t wrap) {
+    c->top = wrap;
+}
+
+void pwm_init(uint slice_num, pwm_config *c, bool start) {}
+
+void pwm_set_clkdiv(uint slice_num, float divider) {}
+
+void pwm_set_wrap(uint slice_num, uint16_t wrap) {}
+
+void pwm_set_gpio_level(uint gpio, uint16_t level) {
+    if (level && !pwm_levels[gpio])
+        mock_stats.pwm_tones++;
+    pwm_levels[gpio] = level;
+}
+
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level) {}
+
+void pwm_set_enabled(uint slice_num, bool enabled) {}
+
+//
+// PIO
+//
+
+struct mock_sm {
+    bool claimed;
+    bool enabled;
+    pio_sm_config config;
+    uint rx_count;
+};
+
+struct pio_hw {
+    struct mock_sm sm[MOCK_PIO_SMS];
+    uint32_t irq0_sources;
+    uint next_offset;
+};
+
+static pio_hw_t pios[2];
+pio_hw_t *const mock_pios[2] = {&pios[0], &pios[1]};
+
+pio_sm_config pio_get_default_sm_config(void) {
+    pio_sm_config c = {-1, 0, 0, 1.0f};
+    return c;
+}
+
+void sm_config_set_jmp_pin(pio_sm_config *c, uint pin) {
+    c->jmp_pin = pin;
+}
+
+void sm_config_set_out_pins(pio_sm_config *c, uint out_base, uint out_count) {
+    c->out_base = out_base;
+    c->out_count = out_count;
+}
+
+void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint pull_threshold) {}
+
+void sm_config_set_in_shift(pio_sm_config *c, bool shift_right, bool autopush, uint push_threshold) {}
+
+void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join) {}
+
+void sm_config_set_clkdiv(pio_sm_config *c, float div) {
+    c->clkdiv = div;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program) {
+    uint offset = pio->next_offset;
+    pio->next_offset += program->length ? program->length : 1;
+    return offset;
+}
+
+int pio_claim_unused_sm(PIO pio, bool required) {
+    for (uint sm = 0; sm < MOCK_PIO_SMS; sm++) {
+        if (!pio->sm[sm].claimed) {
+            pio->sm[sm].claimed = true;
+            return sm;
+        }
+    }
+    return -1;
+}
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config) {
+    pio->sm[sm].config = *config;
+    pio->sm[sm].enabled = false;
+    pio->sm[sm].rx_count = 0;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+    pio->sm[sm].enabled = enabled;
+}
+
+void pio_sm_set_clkdiv(PIO pio, uint sm, float div) {
+    pio->sm[sm].config.clkdiv = div;
+}
+
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t pin_values, uint32_t pin_mask) {
+    gpio_drive(pin_mask, pin_values);
+}
+
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t pin_dirs, uint32_t pin_mask) {
+    gpio_dirs = (gpio_dirs & ~pin_mask) | (pin_dirs & pin_mask);
+}
+
+void pio_gpio_init(PIO pio, uint pin) {}
+
+void pio_set_irq0_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled) {
+    if (enabled)
+        pio->irq0_sources |= 1u << source;
+    else
+        pio->irq0_sources &= ~(1u << source);
+}
+
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm) {
+    return pio->sm[sm].rx_count == 0;
+}
+
+uint32_t pio_sm_get(PIO pio, uint sm) {
+    if (pio->sm[sm].rx_count)
+        pio->sm[sm].rx_count--;
+    return 0;
+}
+
+void pio_sm_put(PIO pio, uint sm, uint32_t data) {
+    const pio_sm_config *c = &pio->sm[sm].config;
+    if (!pio->sm[sm].enabled || !c->out_count)
+        return;
+    uint32_t window = ((1u << c->out_count) - 1) << c->out_base;
+    gpio_drive(window, data << c->out_base);
+}
+
+void mock_button_press(uint gpio) {
+    for (uint p = 0; p < count_of(pios); p++) {
+        PIO pio = &pios[p];
+        for (uint sm = 0; sm < MOCK_PIO_SMS; sm++) {
+            struct mock_sm *s = &pio->sm[sm];
+            if (!s->enabled || s->config.jmp_pin != (int)gpio)
+                continue;
+            // push noblock: a press is lost when the CPU has not kept up
+            if (s->rx_count == MOCK_PIO_RX_DEPTH)
+                mock_stats.pio_rx_overflows++;
+            else
+                s->rx_count++;
+            if (pio->irq0_sources & (1u << (pis_sm0_rx_fifo_not_empty + sm)))
+                irq_set_pending(p ? PIO1_IRQ_0 : PIO0_IRQ_0);
+            return;
+        }
+    }
+    mock_timer_add(now_us, gpio_edge_run, (void *)(uintptr_t)gpio);
+    timers_dispatch(now_us);
+}
+
+//
+// I2C and the SSD1306 panel
+//
+
+/**
+ * @brief Decoder state of the virtual panel.
+ */
+static struct {
+    uint8_t ram[MOCK_PANEL_RAM];
+    uint8_t mode; // 0 horizontal, 1 vertical, 2 page addressing
+    uint8_t col, page;
+    uint8_t col_first, col_last, page_first, page_last;
+    uint8_t cmd[8];
+    uint8_t cmd_len, cmd_need;
+} panel = {.mode = 2, .col_last = 127, .page_last = 7};
+
+static i2c_hw_t i2c_regs[2];
+i2c_inst_t i2c0_inst = {&i2c_regs[0], false};
+i2c_inst_t i2c1_inst = {&i2c_regs[1], false};
+static uint i2c_baud[2];
+static uint panel_max_baud = 0;
+
+/**
+ * @brief Argument bytes that follow a command byte.
+ */
+static uint8_t panel_command_args(uint8_t cmd) {
+    switch (cmd) {
+    case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xAD: case 0xD3: case 0xD5: case 0xD9: case 0xDA:
+    case 0xDB:
+        return 1;
+    case 0x21: case 0x22: case 0xA3:
+        return 2;
+    case 0x29: case 0x2A:
+        return 5;
+    case 0x26: case 0x27:
+        return 6;
+    default:
+        return 0;
+    }
+}
+
+static void panel_execute(const uint8_t *cmd) {
+    switch (cmd[0]) {
+    case 0x20:
+        panel.mode = cmd[1] & 3;
+        break;
+    case 0x21:
+        panel.col_first = panel.col = cmd[1] & 0x7F;
+        panel.col_last = cmd[2] & 0x7F;
+        break;
+    case 0x22:
+        panel.page_first = panel.page = cmd[1] & 7;
+        panel.page_last = cmd[2] & 7;
+        break;
+    default:
+        if (cmd[0] <= 0x0F)
+            panel.col = (panel.col & 0xF0) | cmd[0];
+        else if (cmd[0] <= 0x1F)
+            panel.col = (panel.col & 0x0F) | ((cmd[0] & 0x0F) << 4);
+        else if (cmd[0] >= 0xB0 && cmd[0] <= 0xB7)
+            panel.page = cmd[0] & 7;
+        break;
+    }
+}
+
+static void panel_command_byte(uint8_t b) {
+    if (panel.cmd_len == 0)
+        panel.cmd_need = panel_command_args(b);
+    panel.cmd[panel.cmd_len++] = b;
+    if (panel.cmd_len > panel.cmd_need) {
+        panel_execute(panel.cmd);
+        panel.cmd_len = 0;
+    }
+}
+
+static void panel_data_byte(uint8_t b) {
+    panel.ram[(panel.page & 7) * MOCK_PANEL_COLUMNS + panel.col % MOCK_PANEL_COLUMNS] = b;
+    mock_stats.display_data_bytes++;
+
+    switch (panel.mode) {
+    case 0: // Horizontal: column first, then page, inside the window
+        if (panel.col++ >= panel.col_last) {
+            panel.col = panel.col_first;
+            if (panel.page++ >= panel.page_last)
+                panel.page = panel.page_first;
+        }
+        break;
+    case 1: // Vertical: page first, then column
+        if (panel.page++ >= panel.page_last) {
+            panel.page = panel.page_first;
+            if (panel.col++ >= panel.col_last)
+                panel.col = panel.col_first;
+        }
+        break;
+    default: // Page: the column wraps inside the page
+        panel.col = (panel.col + 1) % MOCK_PANEL_COLUMNS;
+        break;
+    }
+}
+
+/**
+ * @brief Decodes one I2C transaction addressed to the panel.
+ *
+ * Each control byte selects commands (D/C# = 0) or GDDRAM data
+ * (D/C# = 1); with Co = 1 it covers one byte and another control byte
+ * follows, with Co = 0 it covers the rest of the transaction.
+ */
+static void panel_transaction(const uint16_t *words, const uint8_t *bytes, size_t len) {
+    size_t i = 0;
+    while (i < len) {
+        uint8_t control = words ? (uint8_t)words[i++] : bytes[i++];
+        bool data = control & 0x40;
+        size_t end = (control & 0x80) ? MIN(i + 1, len) : len;
+        for (; i < end; i++) {
+            uint8_t b = words ? (uint8_t)words[i] : bytes[i];
+            if (data)
+                panel_data_byte(b);
+            else
+                panel_command_byte(b);
+        }
+    }
+    panel.cmd_len = 0; // A STOP ends any unfinished command
+}
+
+/**
+ * @brief Bus time of a write: address plus payload, 9 bit times per byte.
+ */
+static uint64_t i2c_transfer_us(i2c_inst_t *i2c, size_t len) {
+    uint baud = i2c_baud[i2c == i2c1];
+    return baud ? ((uint64_t)len + 1) * 9 * 1000000 / baud : 0;
+}
+
+static bool panel_acknowledges(i2c_inst_t *i2c, uint8_t addr) {
+    return addr == MOCK_PANEL_ADDR && i2c == i2c1 && (!panel_max_baud || i2c_baud[1] <= panel_max_baud);
+}
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+    i2c->hw->status = I2C_IC_STATUS_TFE_BITS;
+    i2c->hw->raw_intr_stat = 0;
+    return i2c_set_baudrate(i2c, baudrate);
+}
+
+void i2c_deinit(i2c_inst_t *i2c) {
+    i2c_baud[i2c == i2c1] = 0;
+}
+
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate) {
+    i2c_baud[i2c == i2c1] = baudrate;
+    return baudrate;
+}
+
+uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx) {
+    return (i2c == i2c1 ? 34 : 32) + !is_tx;
+}
+
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop,
+                         uint timeout_us) {
+    mock_stats.i2c_transactions++;
+    if (!panel_acknowledges(i2c, addr)) {
+        // NACK on the address byte
+        mock_stats.i2c_errors++;
+        mock_stats.i2c_bytes++;
+        clock_advance(i2c_transfer_us(i2c, 0));
+        return PICO_ERROR_GENERIC;
+    }
+
+    uint64_t us = i2c_transfer_us(i2c, len);
+    if (us > timeout_us) {
+        // The SDK gives up mid-transfer; the panel keeps what it got
+        size_t sent = (size_t)(len * timeout_us / us);
+        panel_transaction(NULL, src, sent);
+        mock_stats.i2c_errors++;
+        mock_stats.i2c_bytes += sent + 1;
+        clock_advance(timeout_us);
+        return PICO_ERROR_TIMEOUT;
+    }
+
+    panel_transaction(NULL, src, len);
+    mock_stats.i2c_bytes += len + 1;
+    clock_advance(us);
+    return len;
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    return i2c_write_timeout_us(i2c, addr, src, len, nostop, UINT32_MAX);
+}
+
+void mock_i2c_set_max_baud(uint max_baud) {
+    panel_max_baud = max_baud;
+}
+
+const uint8_t *mock_display_ram(void) {
+    return panel.ram;
+}
+
+//
+// DMA (only memory to I2C DATA_CMD streams are modelled)
+//
+
+static struct {
+    bool claimed;
+    bool irq0_enabled;
+    bool irq0_status;
+    uint64_t done_us; // Busy until this time
+} dma[MOCK_DMA_CHANNELS];
+
+int dma_claim_unused_channel(bool required) {
+    for (uint ch = 0; ch < MOCK_DMA_CHANNELS; ch++) {
+        if (!dma[ch].claimed) {
+            dma[ch].claimed = true;
+            return ch;
+        }
+    }
+    return -1;
+}
+
+void dma_channel_unclaim(uint channel) {
+    dma[channel].claimed = false;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    dma_channel_config c = {0};
+    return c;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, dma_channel_transfer_size_t size) {}
+
+void channel_config_set_read_increment(dma_channel_config *c, bool incr) {}
+
+void channel_config_set_write_increment(dma_channel_config *c, bool incr) {}
+
+void channel_config_set_dreq(dma_channel_config *c, uint dreq) {}
+
+/**
+ * @brief Timer entry raising the completion interrupt of a DMA stream.
+ */
+static void dma_done_run(void *data) {
+    uintptr_t ch = (uintptr_t)data;
+    if (!dma[ch].irq0_enabled)
+        return;
+    dma[ch].irq0_status = true;
+    irq_run((void *)(uintptr_t)DMA_IRQ_0);
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger) {
+    i2c_inst_t *i2c = NULL;
+    if (write_addr == &i2c0_inst.hw->data_cmd)
+        i2c = i2c0;
+    else if (write_addr == &i2c1_inst.hw->data_cmd)
+        i2c = i2c1;
+    if (!trigger || !i2c)
+        return;
+
+    // The panel sees the stream at once; the channel and the bus stay
+    // busy for its transfer time. A RESTART word starts a new segment,
+    // with the address sent again.
+    const uint16_t *words = (const uint16_t *)read_addr;
+    uint restarts = 0;
+    for (uint i = 1; i < transfer_count; i++)
+        restarts += (words[i] & I2C_IC_DATA_CMD_RESTART_BITS) != 0;
+    mock_stats.i2c_transactions++;
+    mock_stats.i2c_bytes += transfer_count + 1 + restarts;
+    if (panel_acknowledges(i2c, i2c->hw->tar)) {
+        uint start = 0;
+        for (uint i = 1; i <= transfer_count; i++) {
+            if (i == transfer_count || (words[i] & I2C_IC_DATA_CMD_RESTART_BITS)) {
+                panel_transaction(words + start, NULL, i - start);
+                start = i;
+            }
+        }
+    } else {
+        mock_stats.i2c_errors++;
+        i2c->hw->raw_intr_stat |= I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS;
+    }
+
+    dma[channel].done_us = now_us + i2c_transfer_us(i2c, transfer_count + restarts);
+    mock_timer_add(dma[channel].done_us, dma_done_run, (void *)(uintptr_t)channel);
+}
+
+bool dma_channel_is_busy(uint channel) {
+    return now_us < dma[channel].done_us;
+}
+
+void dma_channel_wait_for_finish_blocking(uint channel) {
+    if (dma_channel_is_busy(channel))
+        clock_advance(dma[channel].done_us - now_us);
+}
+
+void dma_channel_abort(uint channel) {
+    dma[channel].done_us = now_us;
+    timer_cancel(dma_done_run, (void *)(uintptr_t)channel);
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled) {
+    dma[channel].irq0_enabled = enabled;
+}
+
+bool dma_channel_get_irq0_status(uint channel) {
+    return dma[channel].irq0_status;
+}
+
+void dma_channel_acknowledge_irq0(uint channel) {
+    dma[channel].irq0_status = false;
+}
+
+//
+// stdio
+//
+
+static bool console_enabled = true;
+
+bool stdio_init_all(void) {
+    return true;
+}
+
+void stdio_set_chars_available_callback(void (*fn)(void *), void *param) {}
+
+int getchar_timeout_us(uint32_t timeout_us) {
+    return PICO_ERROR_TIMEOUT;
+}
+
+void stdio_flush(void) {
+    if (console_enabled)
+        fflush(stdout);
+}
+
+int putchar_raw(int c) {
+    mock_stats.console_bytes++;
+    if (console_enabled)
+        putchar(c);
+    return c;
+}
+
+#undef printf
+int mock_printf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = console_enabled ? vprintf(format, args) : vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (n > 0)
+        mock_stats.console_bytes += n;
+    return n;
+}
+
+void mock_set_console(bool enabled) {
+    console_enabled = enabled;
+}
+
+void multicore_launch_core1(void (*entry)(void)) {}
+
+void multicore_lockout_victim_init(void) {}
+
+void multicore_lockout_start_blocking(void) {}
+
+void multicore_lockout_end_blocking(void) {}
+
+//
+// Flash (W25Q16JV typical timings; program bits only go from 1 to 0)
+//
+
+#define MOCK_FLASH_ERASE_US 45000
+#define MOCK_FLASH_PROGRAM_US 1000
+
+uint8_t mock_flash[PICO_FLASH_SIZE_BYTES];
+
+__attribute__((constructor)) static void flash_init(void) {
+    memset(mock_flash, 0xFF, sizeof(mock_flash));
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+    if (!irq_mask_depth)
+        mock_stats.flash_unmasked++;
+    memset(mock_flash + flash_offs, 0xFF, count);
+    mock_stats.flash_erases += count / FLASH_SECTOR_SIZE;
+    clock_advance((uint64_t)MOCK_FLASH_ERASE_US * (count / FLASH_SECTOR_SIZE));
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+    if (!irq_mask_depth)
+        mock_stats.flash_unmasked++;
+    for (size_t i = 0; i < count; i++)
+        mock_flash[flash_offs + i] &= data[i];
+    mock_stats.flash_programs += count / FLASH_PAGE_SIZE;
+    clock_advance((uint64_t)MOCK_FLASH_PROGRAM_US * (count / FLASH_PAGE_SIZE));
+}
+
+//
+// Watchdog
+//
+
+static watchdog_hw_t watchdog_regs;
+watchdog_hw_t *const watchdog_hw = &watchdog_regs;
+
+static struct {
+    bool enabled;
+    uint64_t timeout_us;
+    uint64_t deadline_us;
+    bool rebooted;
+    bool timeout_reboot;
+} watchdog;
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug) {
+    watchdog.enabled = true;
+    watchdog.timeout_us = (uint64_t)delay_ms * 1000;
+    watchdog.deadline_us = now_us + watchdog.timeout_us;
+}
+
+void mock_watchdog_check(void) {
+    if (watchdog.enabled && now_us > watchdog.deadline_us)
+        mock_stats.watchdog_timeouts++;
+}
+
+void watchdog_update(void) {
+    mock_watchdog_check();
+    mock_stats.watchdog_feeds++;
+    watchdog.deadline_us = now_us + watchdog.timeout_us;
+}
+
+bool watchdog_caused_reboot(void) {
+    return watchdog.rebooted;
+}
+
+bool watchdog_enable_caused_reboot(void) {
+    return watchdog.rebooted && watchdog.timeout_reboot;
+}
+
+void mock_watchdog_set_reboot(bool timeout) {
+    watchdog.rebooted = true;
+    watchdog.timeout_reboot = timeout;
+}
@@ -0,0 +1,413 @@
+/**
+ * @file sim.c
+ * @brief Fast-forward load test of the controller on the host.
+ *
+ * Built as traffic-light-sim by host/CMakeLists.txt. It includes the
+ * application source (without its main()) and runs it against the mock
+ * HAL of mock_pico.c: the same boot sequence as main(), then the same
+ * event loop, except that sleeping in WFI jumps the virtual clock to the
+ * next interrupt. Hours of operation take well under a second.
+ *
+ * Optionally injects a storm of pedestrian button presses (Poisson
+ * arrivals at a given rate) and slows the consumer down, then reports
+ * event throughput, drops, worst-case queue depth, bus traffic and the
+ * firmware's own latency histograms.
+ *
+ * With TRAFFIC_LIGHT_PERSIST, --flash keeps the persistent store in a
+ * file, so consecutive runs see each other's configuration and counters
+ * like consecutive boots of one board. With TRAFFIC_LIGHT_WATCHDOG,
+ * --watchdog-state does the same for the watchdog scratch registers: a
+ * run that finds the file boots as if the previous run had ended in a
+ * watchdog reset.
+ */
+
+#define TRAFFIC_LIGHT_NO_MAIN 1
+#include "../interactive-traffic-light.c"
+
+#include <getopt.h>
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * @brief Command line options.
+ */
+struct sim_options
+{
+    double seconds;            // Simulated time
+    double storm_rate;         // Button presses per second during the storm (0 = none)
+    double storm_start;        // Storm start, in seconds after the controller starts
+    double storm_length;       // Storm length in seconds (0 = until the end)
+    uint32_t consumer_period;  // Main loop runs at most every this many us (0 = on every interrupt)
+    uint32_t panel_max_baud;   // Panel stops acknowledging above this clock (0 = never)
+    uint32_t seed;             // Random seed of the storm
+    const char *flash_file;    // Image of the persistent store, loaded at boot and saved at exit
+    const char *watchdog_file; // Watchdog scratch registers, loaded at boot and saved at exit
+    bool console;              // Echo the firmware console
+    bool show_display;         // Dump the panel contents at the end
+};
+
+struct sim_options options = {
+    .seconds = 600,
+    .storm_start = 10,
+    .seed = 1,
+};
+
+/**
+ * @brief Measurements taken by the simulator itself.
+ */
+struct sim_results
+{
+    uint64_t presses;          // Presses injected
+    uint32_t max_queue_depth;  // Worst event queue occupancy seen after an interrupt
+    uint64_t loop_passes;      // Main loop iterations
+};
+
+struct sim_results results = {0};
+
+uint64_t storm_end_us = 0;
+uint32_t rng_state = 1;
+
+/**
+ * @brief xorshift32, so runs are reproducible across hosts.
+ */
+uint32_t sim_random()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/**
+ * @brief Exponentially distributed gap between two storm presses.
+ */
+uint64_t storm_gap_us()
+{
+    double u = (sim_random() + 1.0) / 4294967297.0;
+    return (uint64_t)(-log(u) * 1e6 / options.storm_rate) + 1;
+}
+
+/**
+ * @brief Timer entry of the storm: presses a random button and queues the next press.
+ */
+void storm_press(void *data)
+{
+    uint buttons = INTERSECTION_COUNT * 2;
+    uint pick = sim_random() % buttons;
+    const struct intersection_config *config = &intersection_configs[pick / 2];
+    mock_button_press(pick & 1 ? config->button_b : config->button_a);
+    results.presses++;
+
+    uint64_t next = time_us_64() + storm_gap_us();
+    if (next < storm_end_us)
+        mock_timer_add(next, storm_press, NULL);
+}
+
+/**
+ * @brief Samples the event queue after every interrupt.
+ */
+void sample_queue()
+{
+    uint32_t depth = event_head - event_tail;
+    if (depth > results.max_queue_depth)
+        results.max_queue_depth = depth;
+}
+
+/**
+ * @brief Prints the panel GDDRAM, two pixel rows per text line.
+ */
+void show_display()
+{
+    static const char *const cells[] = {" ", "▀", "▄", "█"};
+    const uint8_t *ram = mock_display_ram();
+
+    for (int y = 0; y < SSD1306_HEIGHT; y += 2)
+    {
+        for (int x = 0; x < SSD1306_WIDTH; x++)
+        {
+            const uint8_t column = ram[(y / 8) * MOCK_PANEL_COLUMNS + SSD1306_COLUMN_OFFSET + x];
+            uint top = (column >> (y % 8)) & 1;
+            uint bottom = (column >> (y % 8 + 1)) & 1;
+            fputs(cells[top | bottom << 1], stdout);
+        }
+        fputc('\n', stdout);
+    }
+}
+
+/**
+ * @brief Prints the load test report.
+ *
+ * @param start_us Virtual time the controller started at.
+ * @param wall_s Host time the run took, in seconds.
+ */
+void report(uint64_t start_us, double wall_s)
+{
+    double sim_s = (time_us_64() - start_us) / 1e6;
+    uint64_t posted = (uint64_t)event_head + events_dropped;
+
+    fprintf(stdout, "\n== traffic-light-sim ==\n");
+    fprintf(stdout, "simulated: %.3f s in %.3f s wall (%.0fx real time)\n", sim_s, wall_s,
+            wall_s > 0 ? sim_s / wall_s : 0);
+    fprintf(stdout, "presses: %llu injected, %llu lost in PIO FIFOs\n", (unsigned long long)results.presses,
+            (unsigned long long)mock_stats.pio_rx_overflows);
+    fprintf(stdout, "events: %llu posted, %lu processed, %lu dropped (%.3f%%), worst queue depth %lu/%u\n",
+            (unsigned long long)posted, (unsigned long)event_tail, (unsigned long)events_dropped,
+            posted ? 100.0 * events_dropped / posted : 0, (unsigned long)results.max_queue_depth,
+            EVENT_QUEUE_SIZE);
+    fprintf(stdout, "throughput: %.1f events/s simulated, %.0f events/s wall\n", sim_s > 0 ? event_tail / sim_s : 0,
+            wall_s > 0 ? event_tail / wall_s : 0);
+    fprintf(stdout, "interrupts: %llu, main loop passes: %llu, signal transitions: %llu\n",
+            (unsigned long long)mock_stats.irqs, (unsigned long long)results.loop_passes,
+            (unsigned long long)mock_stats.gpio_transitions);
+    fprintf(stdout, "display: %u kHz, %llu transactions, %llu bytes (%.1f B/s), %llu errors, %llu GDDRAM bytes\n",
+            i2c_rates[i2c_rate_index] / 1000, (unsigned long long)mock_stats.i2c_transactions,
+            (unsigned long long)mock_stats.i2c_bytes, sim_s > 0 ? mock_stats.i2c_bytes / sim_s : 0,
+            (unsigned long long)mock_stats.i2c_errors, (unsigned long long)mock_stats.display_data_bytes);
+    fprintf(stdout, "console: %llu bytes (%.1f B/s)\n", (unsigned long long)mock_stats.console_bytes,
+            sim_s > 0 ? mock_stats.console_bytes / sim_s : 0);
+    fprintf(stdout, "buzzer: %llu tones, alarms taken from the pool: %llu\n",
+            (unsigned long long)mock_stats.pwm_tones, (unsigned long long)mock_stats.alarms_added);
+    fprintf(stdout, "watchdog: %llu feeds, %llu timeouts\n", (unsigned long long)mock_stats.watchdog_feeds,
+            (unsigned long long)mock_stats.watchdog_timeouts);
+    fprintf(stdout, "flash: %llu sector erases, %llu page programs, %llu with interrupts enabled\n",
+            (unsigned long long)mock_stats.flash_erases, (unsigned long long)mock_stats.flash_programs,
+            (unsigned long long)mock_stats.flash_unmasked);
+
+    fprintf(stdout, "\nfirmware latency statistics:\n");
+    fflush(stdout);
+    mock_set_console(true);
+    print_latency_stats();
+    print_persist();
+
+    if (options.show_display)
+    {
+        fprintf(stdout, "\nfinal display:\n");
+        show_display();
+    }
+}
+
+#if TRAFFIC_LIGHT_PERSIST
+/**
+ * @brief Loads the persistent store region of the mock flash from a file.
+ *
+ * A missing file leaves the flash erased, like a new board.
+ */
+void load_flash(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return;
+    size_t n = fread(mock_flash + PERSIST_BASE, 1, PICO_FLASH_SIZE_BYTES - PERSIST_BASE, file);
+    fclose(file);
+    if (n != PICO_FLASH_SIZE_BYTES - PERSIST_BASE)
+        fprintf(stderr, "%s: short flash image, rest left erased\n", path);
+}
+
+/**
+ * @brief Saves the persistent store region of the mock flash to a file.
+ */
+void save_flash(const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file || fwrite(mock_flash + PERSIST_BASE, 1, PICO_FLASH_SIZE_BYTES - PERSIST_BASE, file) !=
+                     PICO_FLASH_SIZE_BYTES - PERSIST_BASE)
+        perror(path);
+    if (file)
+        fclose(file);
+}
+#endif
+
+#if TRAFFIC_LIGHT_WATCHDOG
+/**
+ * @brief Presets the watchdog scratch registers from a file and flags a watchdog reset.
+ *
+ * A missing file means a power-on boot.
+ */
+void load_watchdog_state(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return;
+    if (fread(watchdog_hw->scratch, sizeof(watchdog_hw->scratch), 1, file) == 1)
+        mock_watchdog_set_reboot(true);
+    fclose(file);
+}
+
+/**
+ * @brief Saves the watchdog scratch registers to a file.
+ */
+void save_watchdog_state_file(const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file || fwrite(watchdog_hw->scratch, sizeof(watchdog_hw->scratch), 1, file) != 1)
+        perror(path);
+    if (file)
+        fclose(file);
+}
+#endif
+
+void usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --seconds S            simulated run time after start-up (default 600)\n"
+            "  --storm-rate R         button presses per second during the storm (default 0: no storm)\n"
+            "  --storm-start S        storm start, seconds after start-up (default 10)\n"
+            "  --storm-length S       storm length in seconds (default: until the end)\n"
+            "  --consumer-period US   run the main loop at most every US microseconds\n"
+            "  --panel-max-baud HZ    panel NACKs above this I2C clock\n"
+            "  --seed N               storm random seed (default 1)\n"
+            "  --flash FILE           keep the persistent store in FILE (TRAFFIC_LIGHT_PERSIST)\n"
+            "  --watchdog-state FILE  boot from the watchdog scratch registers in FILE, save them at\n"
+            "                         exit (TRAFFIC_LIGHT_WATCHDOG)\n"
+            "  --console              echo the firmware console\n"
+            "  --show-display         print the final panel contents\n",
+            program);
+}
+
+void parse_options(int argc, char **argv)
+{
+    static const struct option long_options[] = {
+        {"seconds", required_argument, NULL, 's'},
+        {"storm-rate", required_argument, NULL, 'r'},
+        {"storm-start", required_argument, NULL, 'b'},
+        {"storm-length", required_argument, NULL, 'l'},
+        {"consumer-period", required_argument, NULL, 'c'},
+        {"panel-max-baud", required_argument, NULL, 'p'},
+        {"seed", required_argument, NULL, 'n'},
+        {"flash", required_argument, NULL, 'f'},
+        {"watchdog-state", required_argument, NULL, 'w'},
+        {"console", no_argument, NULL, 'v'},
+        {"show-display", no_argument, NULL, 'd'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "", long_options, NULL)) != -1)
+    {
+        switch (c)
+        {
+        case 's': options.seconds = atof(optarg); break;
+        case 'r': options.storm_rate = atof(optarg); break;
+        case 'b': options.storm_start = atof(optarg); break;
+        case 'l': options.storm_length = atof(optarg); break;
+        case 'c': options.consumer_period = strtoul(optarg, NULL, 0); break;
+        case 'p': options.panel_max_baud = strtoul(optarg, NULL, 0); break;
+        case 'n': options.seed = strtoul(optarg, NULL, 0); break;
+        case 'f': options.flash_file = optarg; break;
+        case 'w': options.watchdog_file = optarg; break;
+        case 'v': options.console = true; break;
+        case 'd': options.show_display = true; break;
+        default:
+            usage(argv[0]);
+            exit(c == 'h' ? 0 : 2);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    parse_options(argc, argv);
+    rng_state = options.seed ? options.seed : 1;
+    mock_set_console(options.console);
+    mock_i2c_set_max_baud(options.panel_max_baud);
+#if TRAFFIC_LIGHT_PERSIST
+    if (options.flash_file)
+        load_flash(options.flash_file);
+#endif
+
+    struct timespec wall_start, wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+    // Same boot sequence as the single-core main()
+    init_signals();
+#if TRAFFIC_LIGHT_WATCHDOG
+    if (options.watchdog_file)
+        load_watchdog_state(options.watchdog_file);
+    check_watchdog_reboot();
+    if (monitor.safe_mode)
+    {
+        start_safe_mode();
+        uint64_t end_us = time_us_64() + (uint64_t)(options.seconds * 1e6);
+        while (time_us_64() < end_us)
+            mock_wait_for_irq(end_us);
+        mock_watchdog_check();
+        fprintf(stdout, "\n== traffic-light-sim ==\nsafe mode: %llu signal transitions, %llu watchdog feeds, %llu timeouts\n",
+                (unsigned long long)mock_stats.gpio_transitions, (unsigned long long)mock_stats.watchdog_feeds,
+                (unsigned long long)mock_stats.watchdog_timeouts);
+        if (options.watchdog_file)
+            save_watchdog_state_file(options.watchdog_file);
+        return 0;
+    }
+#endif
+#if TRAFFIC_LIGHT_LOW_POWER
+    init_clocks();
+#endif
+    setup();
+    if (!quick_start)
+    {
+        init_display();
+        report_boot_time();
+    }
+
+    uint64_t start_us = time_us_64();
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+        start_step(&intersections[i], start_us);
+    schedule_next_step();
+
+    if (quick_start)
+    {
+        init_display();
+        report_boot_time();
+    }
+#if TRAFFIC_LIGHT_WATCHDOG
+    init_watchdog();
+#endif
+
+    uint64_t end_us = start_us + (uint64_t)(options.seconds * 1e6);
+    if (options.storm_rate > 0)
+    {
+        uint64_t storm_start_us = start_us + (uint64_t)(options.storm_start * 1e6);
+        storm_end_us = options.storm_length > 0 ? storm_start_us + (uint64_t)(options.storm_length * 1e6) : end_us;
+        mock_timer_add(storm_start_us, storm_press, NULL);
+    }
+    mock_set_irq_hook(sample_queue);
+
+    // The main loop, with WFI replaced by a jump to the next interrupt
+    while (time_us_64() < end_us)
+    {
+        process_events();
+        poll_console();
+#if TRAFFIC_LIGHT_LOW_POWER
+        update_power_mode();
+#endif
+#if TRAFFIC_LIGHT_PERSIST
+        persist_service();
+#endif
+#if TRAFFIC_LIGHT_WATCHDOG
+        service_watchdog();
+#endif
+        results.loop_passes++;
+        if (options.consumer_period)
+            mock_run_until(MIN(end_us, time_us_64() + options.consumer_period));
+        else
+            mock_wait_for_irq(end_us);
+    }
+    ssd1306_update_wait();
+#if TRAFFIC_LIGHT_PERSIST
+    if (options.flash_file)
+        save_flash(options.flash_file);
+#endif
+#if TRAFFIC_LIGHT_WATCHDOG
+    mock_watchdog_check();
+    if (options.watchdog_file)
+        save_watchdog_state_file(options.watchdog_file);
+#endif
+
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    double wall_s = (wall_end.tv_sec - wall_start.tv_sec) + (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+    report(start_us, wall_s);
+    return 0;
+}
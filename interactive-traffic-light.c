@@ -1,11 +1,182 @@
 #include <stdio.h>
+#include <string.h>
 #include "pico/stdlib.h"
 #include "hardware/pwm.h"
 #include "hardware/clocks.h"
 #include "hardware/timer.h"
 #include "hardware/gpio.h"
 #include "hardware/i2c.h"
+#include "hardware/sync.h"
+#include "hardware/irq.h"
+#include "hardware/pll.h"
+#include "hardware/xosc.h"
+#include "hardware/pio.h"
+#include "pico/multicore.h"
 #include "ssd1306.h"
+#include "traffic_light.pio.h"
+#if TRAFFIC_LIGHT_GREEN_WAVE || TRAFFIC_LIGHT_TELEMETRY
+#include "pico/cyw43_arch.h"
+#include "pico/rand.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#endif
+#if TRAFFIC_LIGHT_PERSIST
+#include "hardware/flash.h"
+#endif
+#if TRAFFIC_LIGHT_WATCHDOG
+#include "hardware/watchdog.h"
+#endif
+
+/**
+ * @brief Runs the display and stdio pipeline on core 1.
+ *
+ * When non-zero, core 0 only runs the traffic-light state machine and
+ * the GPIO handlers, while core 1 owns the SSD1306, the event queue
+ * consumer and USB/UART logging. Set from CMake (TRAFFIC_LIGHT_DUAL_CORE).
+ */
+#ifndef TRAFFIC_LIGHT_DUAL_CORE
+#define TRAFFIC_LIGHT_DUAL_CORE 0
+#endif
+
+/**
+ * @brief Enables the power-managed idle path.
+ *
+ * When non-zero, clk_sys is scaled down while there is no pedestrian
+ * demand, and after NIGHT_IDLE_CYCLES GREEN periods without demand the
+ * controller rests in GREEN and puts the chip in dormant mode until a
+ * button is pressed. Set from CMake (TRAFFIC_LIGHT_LOW_POWER).
+ */
+#ifndef TRAFFIC_LIGHT_LOW_POWER
+#define TRAFFIC_LIGHT_LOW_POWER 0
+#endif
+
+/**
+ * @brief Enables the fast boot path.
+ *
+ * When non-zero, setup() does not wait 2 seconds for a serial terminal
+ * and, in single-core mode, the display is brought up after the
+ * controller is already running. Set from CMake (TRAFFIC_LIGHT_FAST_BOOT).
+ */
+#ifndef TRAFFIC_LIGHT_FAST_BOOT
+#define TRAFFIC_LIGHT_FAST_BOOT 0
+#endif
+
+/**
+ * @brief Ships the event log to the host in binary.
+ *
+ * When non-zero, process_events() writes every event record as a raw
+ * frame (EVENT_LOG_SYNC + 16 bytes) instead of formatting it. Set from
+ * CMake (TRAFFIC_LIGHT_RAW_LOG).
+ */
+#ifndef TRAFFIC_LIGHT_RAW_LOG
+#define TRAFFIC_LIGHT_RAW_LOG 0
+#endif
+
+/**
+ * @brief Coordinates the cycle with neighbouring controllers (Pico W).
+ *
+ * When non-zero, the board joins Wi-Fi and keeps a time base shared with
+ * a master controller over UDP. While in step, the controller runs a
+ * fixed cycle of GREEN_WAVE_CYCLE_MS whose GREEN starts
+ * GREEN_WAVE_OFFSET_MS into the shared cycle, so consecutive heads of a
+ * corridor turn green one travel time apart. Set from CMake
+ * (TRAFFIC_LIGHT_GREEN_WAVE).
+ */
+#ifndef TRAFFIC_LIGHT_GREEN_WAVE
+#define TRAFFIC_LIGHT_GREEN_WAVE 0
+#endif
+
+/**
+ * @brief Streams telemetry and accepts commands over UDP (Pico W).
+ *
+ * When non-zero, the event log and the latency counters are sent to a
+ * collector as batched binary datagrams, and authenticated commands can
+ * change the phase tables at run time. Set from CMake
+ * (TRAFFIC_LIGHT_TELEMETRY).
+ */
+#ifndef TRAFFIC_LIGHT_TELEMETRY
+#define TRAFFIC_LIGHT_TELEMETRY 0
+#endif
+
+/**
+ * @brief Keeps configuration and lifetime counters in flash.
+ *
+ * When non-zero, the phase timings, the display bus speed limit and the
+ * green-wave offset are kept in a key/value store in the last sectors of
+ * flash, and the lifetime counters in a wear-levelled append log next to
+ * it. Set from CMake (TRAFFIC_LIGHT_PERSIST).
+ */
+#ifndef TRAFFIC_LIGHT_PERSIST
+#define TRAFFIC_LIGHT_PERSIST 0
+#endif
+
+/**
+ * @brief Enables the hardware watchdog and the mid-cycle restart after it fires.
+ *
+ * When non-zero, the main loop feeds the watchdog only while the
+ * scheduler meets its deadlines and the display pipeline drains its
+ * work, and keeps the phase and remaining time of every intersection in
+ * the watchdog scratch registers. After a watchdog reset the controller
+ * resumes from them without the start-up delays; after
+ * WATCHDOG_MAX_FAULTS resets in a row it stays in flashing-red safe
+ * mode. Set from CMake (TRAFFIC_LIGHT_WATCHDOG).
+ */
+#ifndef TRAFFIC_LIGHT_WATCHDOG
+#define TRAFFIC_LIGHT_WATCHDOG 0
+#endif
+
+/**
+ * @brief Replaces the status screen with a multi-line dashboard.
+ *
+ * When non-zero, the display shows the state, a phase progress bar, the
+ * lifetime counters, the display bus status and a scrolling history of
+ * the last button presses, built from incremental text, bar and list
+ * widgets. Needs a 64-row panel. Set from CMake
+ * (TRAFFIC_LIGHT_DASHBOARD).
+ */
+#ifndef TRAFFIC_LIGHT_DASHBOARD
+#define TRAFFIC_LIGHT_DASHBOARD 0
+#endif
+
+/**
+ * @brief Replaces the status screen with a large-type screen readable from a distance.
+ *
+ * When non-zero, the display shows a walk or hand icon over the full
+ * panel height, with the signal, the pedestrian countdown and the
+ * instruction next to it in 2x and 3x type from the sprite atlas of the
+ * display driver. Set from CMake (TRAFFIC_LIGHT_LARGE_DISPLAY).
+ */
+#ifndef TRAFFIC_LIGHT_LARGE_DISPLAY
+#define TRAFFIC_LIGHT_LARGE_DISPLAY 0
+#endif
+#if TRAFFIC_LIGHT_DASHBOARD && TRAFFIC_LIGHT_LARGE_DISPLAY
+#error "TRAFFIC_LIGHT_DASHBOARD and TRAFFIC_LIGHT_LARGE_DISPLAY both replace the status screen; enable only one"
+#endif
+
+/**
+ * @brief Set when the phase tables live in RAM and may change at run time.
+ */
+#define TRAFFIC_LIGHT_RUNTIME_PHASES (TRAFFIC_LIGHT_TELEMETRY || TRAFFIC_LIGHT_PERSIST)
+
+/**
+ * @brief Set when some feature needs the CYW43 radio and lwIP.
+ */
+#define TRAFFIC_LIGHT_NETWORK (TRAFFIC_LIGHT_GREEN_WAVE || TRAFFIC_LIGHT_TELEMETRY)
+#if TRAFFIC_LIGHT_NETWORK && TRAFFIC_LIGHT_LOW_POWER
+#error "Wi-Fi keeps the radio and the clocks running; TRAFFIC_LIGHT_GREEN_WAVE and TRAFFIC_LIGHT_TELEMETRY cannot be combined with TRAFFIC_LIGHT_LOW_POWER"
+#endif
+
+/**
+ * @brief Builds this file as part of another program.
+ *
+ * When non-zero, main() is left out so that the benchmark firmware
+ * (bench.c) and the host simulator (host/sim.c) can include this file and
+ * drive its functions directly. Defined by those files.
+ */
+#ifndef TRAFFIC_LIGHT_NO_MAIN
+#define TRAFFIC_LIGHT_NO_MAIN 0
+#endif
+#define EVENT_LOG_SYNC 0xA5
 
 /**
  * @brief Pin definitions for the BitDogLab project.
@@ -17,434 +188,4817 @@
 #define BUTTON_A 5
 #define BUTTON_B 6
 #define BUZZER 21
-#define BUZZER_FREQ 100
 
 /**
- * @brief Definitions for the OLED display via I2C.
+ * @brief Counter clock of the buzzer PWM slice, in Hz.
+ *
+ * The divider keeps the counter at this rate whatever clk_sys is, so a
+ * tone of f Hz is simply a wrap of BUZZER_PWM_HZ / f (16 Hz to 20 kHz).
+ */
+#define BUZZER_PWM_HZ 1000000
+
+/**
+ * @brief PIO configuration for buttons and signal LEDs.
+ *
+ * Each pedestrian button gets a debounce state machine on BUTTON_PIO; a
+ * press must be stable for DEBOUNCE_MS. The signal LEDs are driven by one
+ * state machine on SIGNAL_PIO over the GPIO window starting at
+ * SIGNAL_PIN_BASE (GPIO 11-13, which includes the unused blue LED).
+ */
+#define BUTTON_PIO pio0
+#define SIGNAL_PIO pio1
+#define DEBOUNCE_MS 10
+#define SIGNAL_PIN_BASE 11
+#define SIGNAL_PIN_COUNT 3
+
+/**
+ * @brief Definitions for the OLED display via I2C.
+ *
+ * This section contains the configuration parameters and pin definitions
+ * related to the OLED display communication using the I2C protocol.
+ */
+
+#define I2C_PORT i2c1
+#define I2C_SDA 14
+#define I2C_SCL 15
+
+/**
+ * @brief Fastest I2C clock the startup probe may select, in Hz.
+ *
+ * The display bus starts at the first entry of i2c_rates[] and is raised
+ * step by step up to this limit while the panel keeps acknowledging. Set
+ * from CMake (TRAFFIC_LIGHT_I2C_MAX_BAUD).
+ */
+#ifndef I2C_MAX_BAUD
+#define I2C_MAX_BAUD 1000000
+#endif
+#define I2C_PROBE_ROUNDS 8
+
+/**
+ * @brief Screen layout, in character cells of the 5x7 font (6 px wide).
+ *
+ * The labels are drawn once as a static layer; only the fields after
+ * them are redrawn, and only when their value changes. The four lines
+ * are spread over the panel height, with a blank row between them on
+ * 64-row panels and packed on 32-row ones.
+ */
+#define CHAR_WIDTH 6
+#define DISPLAY_COLUMNS (SSD1306_WIDTH / CHAR_WIDTH)
+#define STATE_FIELD_COLUMN 15     // After "Current State: "
+#define COUNTDOWN_FIELD_COLUMN 11 // After "Countdown: "
+#define SUMMARY_SLOT_COLUMNS 4    // "1:R "
+#define DISPLAY_LINE_HEIGHT (SSD1306_HEIGHT / 4)
+#define TITLE_ROW 0
+#define STATE_ROW DISPLAY_LINE_HEIGHT
+#define MESSAGE_ROW (2 * DISPLAY_LINE_HEIGHT)
+#define SUMMARY_ROW (3 * DISPLAY_LINE_HEIGHT)
+
+/**
+ * @brief Dashboard layout, one 8-pixel page per line (TRAFFIC_LIGHT_DASHBOARD).
+ *
+ * The history takes the pages left below the fixed lines, under a
+ * title, newest entry at the bottom. The progress bar is a frame with
+ * BAR_INSET pixels of margin, inside one page; its fill moves in
+ * BAR_STEPS steps per phase, each redrawn by an alarm at the step
+ * boundary.
+ */
+#define DASHBOARD_STATE_PAGE 0
+#define DASHBOARD_BAR_PAGE 1
+#define DASHBOARD_COUNTERS_PAGE 2
+#define DASHBOARD_BUS_PAGE 3
+#define DASHBOARD_HISTORY_TITLE_PAGE 4
+#define DASHBOARD_HISTORY_PAGE 5
+#define DASHBOARD_HISTORY_ROWS (SSD1306_PAGES - DASHBOARD_HISTORY_PAGE)
+#define BAR_X (6 * CHAR_WIDTH)
+#define BAR_WIDTH 48
+#define BAR_INSET 2
+#define BAR_STEPS 4
+#define COUNT_CHARS 5 // Widest counter from format_count()
+
+/**
+ * @brief Large-type layout (TRAFFIC_LIGHT_LARGE_DISPLAY), in pixels.
+ *
+ * The icon takes the full panel height on the left and the text column
+ * starts LARGE_TEXT_X pixels in. The signal is in 2x type at the top,
+ * the countdown in 3x type below it (2x on 32-row panels, which have no
+ * room for the instruction line at LARGE_REQUEST_ROW).
+ */
+#define LARGE_TEXT_X (SSD1306_ICON_WIDTH + 4)
+#define LARGE_TEXT_COLUMNS(scale) ((SSD1306_WIDTH - LARGE_TEXT_X) / (CHAR_WIDTH * (scale)))
+#define LARGE_SIGNAL_ROW 0
+#define LARGE_COUNTDOWN_ROW 16
+#define LARGE_COUNTDOWN_SCALE (SSD1306_PAGES >= 8 ? 3 : 2)
+#define LARGE_REQUEST_ROW 48
+
+/**
+ * @brief Wi-Fi network joined by the green-wave and telemetry builds.
+ *
+ * A lost or failed connection is retried every NETWORK_RETRY_MS.
+ */
+#ifndef WIFI_SSID
+#define WIFI_SSID ""
+#endif
+#ifndef WIFI_PASSWORD
+#define WIFI_PASSWORD ""
+#endif
+#define NETWORK_RETRY_MS 5000
+
+/**
+ * @brief Green-wave network and timing parameters.
+ *
+ * GREEN_WAVE_MASTER is the IPv4 address of the time master, or "" on the
+ * master itself. The other values are set from CMake as well; the wire
+ * protocol is described at struct green_wave_packet.
+ *
+ * Every GREEN_WAVE_SYNC_MS a follower timestamps one exchange with the
+ * master; the clock offset is taken from the fastest of the last
+ * GREEN_WAVE_SAMPLES exchanges, whose error is at most half its round
+ * trip. Exchanges slower than GREEN_WAVE_MAX_RTT_US are discarded, and
+ * after GREEN_WAVE_HOLDOVER_MS without a valid one the controller falls
+ * back to free (actuated) operation.
+ */
+#ifndef GREEN_WAVE_MASTER
+#define GREEN_WAVE_MASTER ""
+#endif
+#ifndef GREEN_WAVE_CYCLE_MS
+#define GREEN_WAVE_CYCLE_MS 23000
+#endif
+#ifndef GREEN_WAVE_OFFSET_MS
+#define GREEN_WAVE_OFFSET_MS 0
+#endif
+#define GREEN_WAVE_PORT 4810
+#define GREEN_WAVE_MAGIC 0x57564E47 // "GNVW" on the wire
+#define GREEN_WAVE_SYNC_MS 1000
+#define GREEN_WAVE_SAMPLES 8
+#define GREEN_WAVE_MAX_RTT_US 20000
+#define GREEN_WAVE_HOLDOVER_MS 30000
+
+/**
+ * @brief Telemetry parameters.
+ *
+ * Datagrams go to TELEMETRY_HOST:TELEMETRY_PORT ("" = no stream) and
+ * commands are accepted on TELEMETRY_PORT. TELEMETRY_KEY is the 128-bit
+ * command key as 32 hex digits ("" = commands disabled). The event log
+ * is sent every TELEMETRY_PERIOD_MS, at most TELEMETRY_BATCH records per
+ * datagram, and the latency counters every TELEMETRY_STATS_MS. The wire
+ * format is described at struct telemetry_header.
+ */
+#ifndef TELEMETRY_HOST
+#define TELEMETRY_HOST ""
+#endif
+#ifndef TELEMETRY_KEY
+#define TELEMETRY_KEY ""
+#endif
+#define TELEMETRY_PORT 4811
+#define TELEMETRY_MAGIC 0x4D4C5454 // "TTLM" on the wire
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_PERIOD_MS 100
+#define TELEMETRY_STATS_MS 10000
+#define TELEMETRY_BATCH 64
+
+/**
+ * @brief Flash layout and write policy of the persistent store.
+ *
+ * The store takes the last PERSIST_KV_SECTORS + PERSIST_LOG_SECTORS
+ * sectors of flash; the program image must end below PERSIST_BASE.
+ * Configuration changes are written once they have settled for
+ * PERSIST_CONFIG_DELAY_MS, and the counter log gets a record every
+ * PERSIST_LOG_INTERVAL_MS while the counters change. A flash operation
+ * stalls XIP and masks interrupts, so it only starts when no step
+ * deadline, buzzer step or the like is due within its worst-case time
+ * (PERSIST_ERASE_WINDOW_US for a sector erase, PERSIST_PROGRAM_WINDOW_US
+ * for a page program, both with margin over the W25Q16JV datasheet
+ * limits).
+ */
+#define PERSIST_KV_SECTORS 2
+#define PERSIST_LOG_SECTORS 6
+#define PERSIST_BASE (PICO_FLASH_SIZE_BYTES - (PERSIST_KV_SECTORS + PERSIST_LOG_SECTORS) * FLASH_SECTOR_SIZE)
+#define PERSIST_LOG_BASE (PERSIST_BASE + PERSIST_KV_SECTORS * FLASH_SECTOR_SIZE)
+#define PERSIST_CONFIG_DELAY_MS 5000
+#define PERSIST_LOG_INTERVAL_MS 600000
+#define PERSIST_ERASE_WINDOW_US 500000
+#define PERSIST_PROGRAM_WINDOW_US 5000
+#define KV_MAGIC 0x5256564B  // "KVVR" on the wire
+#define LOG_MAGIC 0x5447434C // "LCGT" on the wire
+#define KV_PAGES_PER_SECTOR (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+
+/**
+ * @brief Watchdog timing and recovery policy.
+ *
+ * The board resets WATCHDOG_TIMEOUT_MS after the last feed. The main loop
+ * is woken every WATCHDOG_CHECK_MS to feed it, and stops feeding once a
+ * step deadline is WATCHDOG_STALL_MS late, or the event queue or a
+ * display transfer has not moved for that long. A run of
+ * WATCHDOG_STABLE_MS without a reset clears the fault count. Safe mode
+ * flashes every red signal at 1 Hz.
+ */
+#define WATCHDOG_TIMEOUT_MS 2000
+#define WATCHDOG_CHECK_MS 500
+#define WATCHDOG_STALL_MS 1000
+#define WATCHDOG_MAX_FAULTS 3
+#define WATCHDOG_STABLE_MS 600000
+#define WATCHDOG_MAGIC 0x57445400 // "WDT" in the upper 24 bits, fault count below
+#define SAFE_MODE_FLASH_MS 500
+
+/**
+ * @brief Power management parameters.
+ *
+ * clk_sys runs from pll_sys at full speed while a pedestrian request is
+ * being served and from pll_usb during quiet phases. clk_peri is moved to
+ * pll_usb at boot so UART and I2C baud rates do not depend on clk_sys.
+ */
+#define SYS_CLOCK_FULL_HZ (125 * MHZ)
+#define SYS_CLOCK_QUIET_HZ (48 * MHZ)
+#define PERI_CLOCK_HZ (48 * MHZ)
+#define NIGHT_IDLE_CYCLES 30
+
+/**
+ * @brief Actuation parameters.
+ *
+ * Pedestrian requests are counted in windows of DEMAND_WINDOW_MS; the
+ * count of the last complete window is the demand that stretches phases.
+ * A request never ends a phase sooner than REQUEST_CLEARANCE_MS after the
+ * press.
+ */
+#define DEMAND_WINDOW_MS 60000
+#define REQUEST_CLEARANCE_MS 1000
+
+/**
+ * @brief Logical signal outputs of a phase.
+ *
+ * Mapped to the LED pins of each intersection by turn_on_signal().
+ */
+#define OUTPUT_GREEN (1u << 0)
+#define OUTPUT_RED (1u << 1)
+
+/**
+ * @enum traffic_light_state
+ * @brief Possible states of the traffic light.
+ *
+ * Represents the colors of a traffic light in traffic control. Each value
+ * indexes the phase table; new phases are added here and in `phases`.
+ */
+typedef enum
+{
+    RED,
+    YELLOW,
+    GREEN,
+    PHASE_COUNT
+} traffic_light_state;
+
+/**
+ * @brief Tunable timing of a phase: the fields of struct phase that
+ * remote commands and the persistent store may change.
+ */
+struct phase_timing
+{
+    uint32_t duration;
+    uint32_t min_duration;
+    uint32_t max_duration;
+    uint32_t stretch;
+};
+
+/**
+ * @brief One step of a buzzer pattern.
+ */
+struct tone
+{
+    uint16_t freq_hz;     // Pitch (0 = silence)
+    uint16_t duration_ms; // Length of the step, at least 1 ms
+};
+
+/**
+ * @brief Tone sequence played in a loop by buzzer_play().
+ */
+struct buzzer_pattern
+{
+    const struct tone *tones;
+    uint count;
+};
+
+/**
+ * @brief Accessible pedestrian signal cadences.
+ *
+ * - locator_pattern: a short tick every second, so the push button can
+ *   be found while the request waits.
+ * - walk_pattern: a rapid tick during the walk countdown.
+ */
+static const struct tone locator_tones[] = {{880, 40}, {0, 960}};
+static const struct tone walk_tones[] = {{880, 30}, {0, 70}};
+static const struct buzzer_pattern locator_pattern = {locator_tones, count_of(locator_tones)};
+static const struct buzzer_pattern walk_pattern = {walk_tones, count_of(walk_tones)};
+
+/**
+ * @brief Static description of one signal phase.
+ *
+ * Everything the controller needs to know about a phase lives here, so
+ * adding a phase only means adding a table entry.
+ */
+struct phase
+{
+    uint32_t duration;        // Phase length in milliseconds
+    uint32_t min_duration;    // A pedestrian request may cut the phase down to this length (0 = never cut)
+    uint32_t max_duration;    // Upper bound of the demand stretch (0 = fixed length)
+    uint32_t stretch;         // Added per request counted in the last demand window, in milliseconds
+    uint32_t outputs;         // Logical outputs driven high (OUTPUT_*)
+    uint32_t countdown_from;  // With a pedestrian request, countdown shown from this remaining time (0 = never)
+    uint32_t beep_duration;   // With a pedestrian request, beep length when the countdown starts (0 = silent)
+    const struct buzzer_pattern *beep; // Pattern played for beep_duration
+    const char *label[2];     // Display text without / with a pedestrian request
+    const char *signal_name;  // Name printed on the console
+    bool serves_pedestrians;  // Leaving this phase completes the pedestrian request
+    bool rest_point;          // Repeated while no request is pending; low-power mode may rest here
+    traffic_light_state next; // Phase that follows
+};
+
+/**
+ * @brief Phase table, placed in flash and indexed by traffic_light_state.
+ *
+ * YELLOW is represented by driving both the green and red LEDs. The
+ * telemetry build runs from a RAM copy that commands may retune.
+ *
+ * Actuated timing: GREEN is repeated while nobody asks to cross, and a
+ * request cuts it short once it has lasted 5 s, so a pedestrian waits at
+ * most 8 s (5 s of GREEN + 3 s of YELLOW) and traffic always gets at
+ * least 5 s of GREEN per cycle. The walk phase (RED) grows by 0.5 s per
+ * request of the last minute, up to 16 s.
+ */
+static const struct phase phases[PHASE_COUNT] = {
+    [RED] = {
+        .duration = 10000,
+        .max_duration = 16000,
+        .stretch = 500,
+        .outputs = OUTPUT_RED,
+        .countdown_from = 5000,
+        .beep_duration = 5000,
+        .beep = &walk_pattern,
+        .label = {"RED", "Walk!"},
+        .signal_name = "Red",
+        .serves_pedestrians = true,
+        .next = GREEN,
+    },
+    [YELLOW] = {
+        .duration = 3000,
+        .outputs = OUTPUT_GREEN | OUTPUT_RED,
+        .label = {"YELLOW", "Wait"},
+        .signal_name = "Yellow",
+        .next = RED,
+    },
+    [GREEN] = {
+        .duration = 10000,
+        .min_duration = 5000,
+        .outputs = OUTPUT_GREEN,
+        .label = {"GREEN", "Wait"},
+        .signal_name = "Green",
+        .rest_point = true,
+        .next = YELLOW,
+    },
+};
+
+/**
+ * @brief Controller state of one intersection, packed in a single word.
+ *
+ * - Bits 0-23: remaining time of the current phase, in milliseconds.
+ * - Bits 24-27: current phase (traffic_light_state).
+ * - LIGHT_REQUEST_A / LIGHT_REQUEST_B: pedestrian request from button A / B.
+ * - LIGHT_RESTING: resting at a rest point until demand.
+ *
+ * An aligned 32-bit load or store is single-copy atomic on the
+ * Cortex-M0+, so whoever reads the word sees one whole state and never a
+ * phase from one update with the duration of another. The M0+ has no
+ * exclusive load/store, hence no compare-and-swap: writers serialise
+ * their read-modify-write sequences in a short critical section instead
+ * (see control_enter()).
+ */
+typedef uint32_t light_state;
+
+#define LIGHT_DURATION_MASK 0x00FFFFFFu // Phase durations must stay below 2^24 ms
+#define LIGHT_PHASE_SHIFT 24
+#define LIGHT_PHASE_MASK (0xFu << LIGHT_PHASE_SHIFT)
+#define LIGHT_REQUEST_A (1u << 28)
+#define LIGHT_REQUEST_B (1u << 29)
+#define LIGHT_RESTING (1u << 30)
+#define LIGHT_REQUESTS (LIGHT_REQUEST_A | LIGHT_REQUEST_B)
+#define LIGHT_FLAGS (LIGHT_REQUESTS | LIGHT_RESTING)
+
+#define LIGHT_PHASE(s) ((traffic_light_state)(((s) & LIGHT_PHASE_MASK) >> LIGHT_PHASE_SHIFT))
+#define LIGHT_DURATION(s) ((s) & LIGHT_DURATION_MASK)
+#define LIGHT_STATE(phase, duration, flags) \
+    (((light_state)(phase) << LIGHT_PHASE_SHIFT) | ((duration) & LIGHT_DURATION_MASK) | ((flags) & LIGHT_FLAGS))
+
+/**
+ * @brief Pins and phase table of one signal head.
+ */
+struct intersection_config
+{
+    uint green_led;
+    uint red_led;
+    uint button_a;
+    uint button_b;
+    const struct phase *phases; // Indexed by traffic_light_state
+};
+
+/**
+ * @brief Signal heads driven by this board.
+ *
+ * Each entry is an independent intersection with its own LEDs, pedestrian
+ * buttons and phase table. Add an entry to drive another head.
+ */
+static const struct intersection_config intersection_configs[] = {
+    {GREEN_LED, RED_LED, BUTTON_A, BUTTON_B, phases},
+};
+
+#define INTERSECTION_COUNT count_of(intersection_configs)
+
+/**
+ * @brief Runtime state of one intersection.
+ *
+ * Owned by the control side: only the scheduler alarm and the button
+ * handlers on core 0 modify it, each transition inside control_enter() /
+ * control_exit(), so it stays consistent whatever the relative IRQ
+ * priorities. Other contexts read the published snapshots instead.
+ */
+struct intersection
+{
+    const struct intersection_config *config;
+    const struct phase *phases;   // Phase table in use: config->phases, or its RAM copy (TRAFFIC_LIGHT_RUNTIME_PHASES)
+    volatile light_state current; // Phase, remaining time and flags at the last step (LIGHT_*)
+    uint64_t phase_end_us;        // End of the current phase (0 = open-ended, resting)
+    uint64_t step_deadline_us;    // End of the step in progress (0 = not scheduled)
+    uint32_t idle_cycles;         // Consecutive rest-point periods without demand
+    uint64_t phase_start_us;      // Entry into the current phase
+    uint32_t request_us;          // Oldest request not yet served (time_us_32(), 0 = none)
+    uint64_t window_start_us;     // Start of the current demand window
+    uint32_t window_requests;     // Requests counted in the current demand window
+    uint32_t demand;              // Requests in the last complete demand window
+    uint32_t requests;            // Requests since boot
+    uint32_t merged_requests;     // Requests merged into one pending or being served
+    uint32_t pedestrian_phases;   // Pedestrian phases entered
+    bool wave_locked;             // The GREEN in progress ends at the shared force-off point
+    uint32_t press_us;            // IRQ entry of a press not yet shown on the signals (0 = none)
+    uint32_t light_press_us;      // Press answered by the signal write being queued (0 = none)
+};
+
+/**
+ * @enum power_mode
+ * @brief Power states of the controller.
+ */
+typedef enum
+{
+    POWER_ACTIVE,  // clk_sys at SYS_CLOCK_FULL_HZ
+    POWER_QUIET,   // clk_sys at SYS_CLOCK_QUIET_HZ
+    POWER_DORMANT  // Oscillators stopped until a button edge
+} power_mode;
+
+/**
+ * @enum light_event_type
+ * @brief Kinds of events posted from interrupt context to the main loop.
+ */
+typedef enum
+{
+    EVENT_TICK,   // state_controller() ran; a visible value changed
+    EVENT_SIGNAL, // A signal output changed
+    EVENT_BUTTON  // A pedestrian button was pressed
+} light_event_type;
+
+/**
+ * @brief Consistent copy of the controller state.
+ *
+ * Taken by the control side whenever the state changes, so rendering and
+ * logging never read `current` concurrently.
+ */
+struct light_snapshot
+{
+    traffic_light_state state;
+    const struct phase *phase; // Entry of the intersection's phase table
+    uint64_t start_us;         // Start of the phase
+    uint64_t end_us;           // End of the phase (0 = open-ended)
+    bool pedestrian;
+    bool resting;
+};
+
+/**
+ * @brief Flags of a light_event.
+ */
+#define EVENT_FLAG_PEDESTRIAN (1u << 0) // A pedestrian request was pending
+#define EVENT_FLAG_RESTING (1u << 1)    // The intersection was resting
+
+/**
+ * @brief Binary event log record, 16 bytes.
+ *
+ * Filled with a handful of stores when the event is posted: a timestamp
+ * from the low word of the microsecond timer and the state of the
+ * intersection at that instant. The layout is fixed so that records can
+ * also be shipped raw to a host (see TRAFFIC_LIGHT_RAW_LOG). seq counts
+ * every posted event, including dropped ones, so a gap in it shows how
+ * many records were lost.
+ */
+struct light_event
+{
+    uint32_t time_us;     // time_us_32() when posted
+    uint32_t duration;    // Remaining phase time in milliseconds
+    uint16_t seq;         // Posting sequence number
+    uint8_t type;         // light_event_type
+    uint8_t intersection; // Index into intersections[]
+    uint8_t gpio;         // Button GPIO (EVENT_BUTTON), 0 otherwise
+    uint8_t state;        // traffic_light_state
+    uint8_t flags;        // EVENT_FLAG_*
+    uint8_t reserved;
+};
+_Static_assert(sizeof(struct light_event) == 16, "event log records are 16 bytes on the wire");
+
+/**
+ * @brief Number of power-of-two buckets of a latency histogram.
+ *
+ * Bucket 0 counts 0 us, bucket i counts [2^(i-1), 2^i) us; the last
+ * bucket also takes everything longer.
+ */
+#define HISTOGRAM_BUCKETS 24
+
+/**
+ * @brief Latency histogram in microseconds.
+ *
+ * Recording costs a count-leading-zeros and a few stores, so it can be
+ * done from interrupt handlers. Percentiles are reported as the upper
+ * bound of the bucket they fall in.
+ */
+struct latency_histogram
+{
+    const char *name;
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+};
+
+/**
+ * @brief Instrumented hot paths, reported by the "stats" command.
+ */
+typedef enum
+{
+    STAT_BUTTON_HANDLER,  // Button IRQ entry to state change
+    STAT_BUTTON_TO_LIGHT, // Button IRQ entry to the signal write it causes
+    STAT_TICK_JITTER,     // Scheduler alarm firing after its deadline
+    STAT_CONTROLLER,      // state_controller() execution time
+    STAT_DISPLAY_RENDER,  // update_display() execution time
+    STAT_DISPLAY_FLUSH,   // Asynchronous SSD1306 update, start to end of DMA
+    STAT_PEDESTRIAN_WAIT, // First pedestrian request to the start of its walk phase
+    STAT_WAVE_ALIGNMENT,  // Coordinated GREEN start to the shared cycle start
+    STAT_COUNT
+} latency_stat;
+
+/**
+ * @brief Length of a serial console command line.
+ */
+#define CONSOLE_LINE_MAX 32
+
+/**
+ * @brief Message shown on the third line of the display.
+ */
+typedef enum
+{
+    MESSAGE_COUNTDOWN,
+    MESSAGE_PRESSED,
+    MESSAGE_WAITING,
+    MESSAGE_NONE
+} display_message;
+
+/**
+ * @brief Values currently rendered in the dynamic display fields.
+ *
+ * update_display() compares against these and only formats and draws a
+ * field whose value changed. valid is false until the static layer has
+ * been drawn.
+ */
+struct display_cache
+{
+    bool valid;
+    const char *state;
+    display_message message;
+    int countdown;
+    char signals[INTERSECTION_COUNT];
+};
+
+/**
+ * @brief Capacity of the event queue. Must be a power of two.
+ */
+#define EVENT_QUEUE_SIZE 64
+
+/**
+ * @brief State of every intersection, indexed like intersection_configs.
+ */
+struct intersection intersections[INTERSECTION_COUNT];
+
+/**
+ * @brief I2C clock steps for the display bus: standard, fast and fast-mode plus.
+ */
+static const uint i2c_rates[] = {100000, 400000, 1000000};
+
+/**
+ * @brief Index into i2c_rates[] of the clock currently in use.
+ */
+uint i2c_rate_index = 0;
+
+/**
+ * @brief Contents of the display, owned by the core running update_display().
+ */
+struct display_cache display_cache = {0};
+
+/**
+ * @brief Display bus errors since boot, counted by downshift_display_bus().
+ */
+uint display_bus_errors = 0;
+
+/**
+ * @brief Set by an alarm when the display should be redrawn without an event.
+ */
+volatile bool display_refresh_due = false;
+
+/**
+ * @brief Set when a frame could not be presented because a flush was in
+ * flight; display_flush_done() then requests the redraw that sends it.
+ */
+volatile bool display_present_pending = false;
+
+#if TRAFFIC_LIGHT_DASHBOARD
+_Static_assert(DASHBOARD_HISTORY_ROWS > 0, "the dashboard needs a 64-row panel");
+
+/**
+ * @brief Fixed-width line of text, redrawn only when its text changes.
+ */
+struct text_widget
+{
+    uint8_t column; // First character cell
+    uint8_t row;    // Pixel row
+    uint8_t width;  // Width in character cells
+    char text[DISPLAY_COLUMNS + 1];
+};
+
+/**
+ * @brief Horizontal bar that fills from the left.
+ *
+ * Only the columns between the old and the new fill are drawn.
+ */
+struct bar_widget
+{
+    uint8_t x, y;          // Top left corner of the frame
+    uint8_t width, height; // Frame size in pixels
+    uint8_t steps;         // Positions of the fill between empty and full
+    uint8_t filled;        // Filled columns inside the frame
+};
+
+/**
+ * @brief Scrolling list of text lines, one page each.
+ *
+ * Once full, a new line shifts the pages above it up by one in the
+ * framebuffer instead of redrawing every line.
+ */
+struct list_widget
+{
+    uint8_t page;  // First page
+    uint8_t rows;  // Pages in the list
+    uint8_t shown; // Lines drawn so far (saturates at rows)
+};
+
+/**
+ * @brief Widgets of the dashboard, owned by the core running update_dashboard().
+ *
+ * valid is false until the static layer has been drawn.
+ */
+struct dashboard
+{
+    bool valid;
+    struct text_widget state;
+    struct bar_widget progress;
+    struct text_widget counters;
+    struct text_widget bus;
+    struct list_widget history;
+};
+
+struct dashboard dashboard = {
+    .state = {.row = DASHBOARD_STATE_PAGE * 8, .width = DISPLAY_COLUMNS},
+    .progress = {.x = BAR_X, .y = DASHBOARD_BAR_PAGE * 8, .width = BAR_WIDTH, .height = 7, .steps = BAR_STEPS},
+    .counters = {.row = DASHBOARD_COUNTERS_PAGE * 8, .width = DISPLAY_COLUMNS},
+    .bus = {.row = DASHBOARD_BUS_PAGE * 8, .width = DISPLAY_COLUMNS},
+    .history = {.page = DASHBOARD_HISTORY_PAGE, .rows = DASHBOARD_HISTORY_ROWS},
+};
+#endif
+
+#if TRAFFIC_LIGHT_LARGE_DISPLAY
+/**
+ * @brief Contents of the large-type screen, owned by the core running update_large_display().
+ *
+ * valid is false until the screen has been cleared.
+ */
+struct large_display
+{
+    bool valid;
+    int icon;            // ssd1306_icon shown (-1 = none yet)
+    const char *signal;  // Signal label shown
+    const char *request; // Instruction shown ("" = blank line)
+    int countdown;       // Seconds shown (-1 = blank)
+};
+
+struct large_display large_display = {0};
+#endif
+
+/**
+ * @brief One-shot alarm that drives every intersection.
+ *
+ * Armed for the earliest step deadline among all intersections: the end
+ * of a phase, or the next visible step of a pedestrian countdown.
+ */
+alarm_id_t scheduler_alarm = 0;
+
+/**
+ * @brief Buzzer pattern player.
+ *
+ * A single alarm is taken per pattern and rescheduled from its own
+ * callback for every following step, so a playing pattern costs one
+ * short interrupt per tone and no alarm-pool traffic.
+ */
+struct buzzer_player
+{
+    const struct buzzer_pattern *pattern; // Pattern playing (NULL = silent)
+    uint index;                           // Step being played
+    uint64_t step_end_us;                 // End of that step
+    uint64_t end_us;                      // Stop at the first step ending at or after this (0 = until replaced)
+    alarm_id_t alarm;
+};
+
+struct buzzer_player buzzer = {0};
+
+#if TRAFFIC_LIGHT_GREEN_WAVE
+/**
+ * @brief Time-sync exchange between a follower and the master, 32 bytes.
+ *
+ * A follower sends t1 with t2 = t3 = 0; the master echoes seq and t1 and
+ * fills in t2 and t3 from its own clock. With t4 the follower's receive
+ * time, the offset of the master clock is ((t2 - t1) + (t3 - t4)) / 2
+ * and the network round trip (t4 - t1) - (t3 - t2). All boards run this
+ * firmware, so fields are sent in the RP2040's little-endian order.
+ */
+struct green_wave_packet
+{
+    uint32_t magic; // GREEN_WAVE_MAGIC
+    uint32_t seq;   // Request sequence number, echoed in the reply
+    uint64_t t1;    // Request sent, follower clock
+    uint64_t t2;    // Request received, master clock (0 in a request)
+    uint64_t t3;    // Reply sent, master clock (0 in a request)
+};
+_Static_assert(sizeof(struct green_wave_packet) == 32, "green-wave packets are 32 bytes on the wire");
+
+/**
+ * @brief One timed exchange with the master.
+ */
+struct green_wave_sample
+{
+    int64_t offset_us; // Master clock minus local clock
+    uint32_t rtt_us;   // Network round trip of the exchange
+};
+
+/**
+ * @brief Shared time base and cycle position of this controller.
+ *
+ * `synced`, `clock_offset_us` and `offset_ms` are read by the scheduler
+ * alarm and written from the lwIP callbacks (a lower-priority interrupt)
+ * or the console, always inside control_enter() / control_exit().
+ */
+struct green_wave
+{
+    bool is_master;
+    volatile bool synced;        // Shared time base valid
+    int64_t clock_offset_us;     // Shared time minus local time
+    uint32_t rtt_us;             // Round trip of the exchange the offset comes from
+    uint64_t last_sync_us;       // Local time of the last valid exchange
+    uint32_t offset_ms;          // GREEN start within the shared cycle
+    uint32_t seq;                // Sequence number of the request in flight
+    uint64_t request_us;         // Local time it was sent
+    struct green_wave_sample samples[GREEN_WAVE_SAMPLES];
+    uint sample_count;
+    uint next_sample;
+    uint32_t exchanges;          // Replies accepted
+    uint32_t rejected;           // Replies discarded (too slow, stale, malformed)
+    struct udp_pcb *pcb;
+    ip_addr_t master;
+    async_at_time_worker_t worker;
+};
+
+struct green_wave wave = {.offset_ms = GREEN_WAVE_OFFSET_MS % GREEN_WAVE_CYCLE_MS};
+#endif
+
+#if TRAFFIC_LIGHT_NETWORK
+/**
+ * @brief Set once the radio and lwIP are up; earliest time of the next join attempt.
+ */
+bool network_ready = false;
+uint64_t network_retry_us = 0;
+#endif
+
+#if TRAFFIC_LIGHT_TELEMETRY
+/**
+ * @brief Kinds of telemetry datagrams.
+ */
+typedef enum
+{
+    TELEMETRY_EVENTS = 1, // struct light_event records, in posting order
+    TELEMETRY_STATS = 2,  // One struct telemetry_counters, then STAT_COUNT struct telemetry_stat
+    TELEMETRY_ACK = 3     // One struct telemetry_ack
+} telemetry_type;
+
+/**
+ * @brief Header of every telemetry datagram, 16 bytes.
+ *
+ * `session` is drawn at random on every boot; commands must quote it, so
+ * a command recorded before a reset cannot be replayed after it. `seq`
+ * counts datagrams, so the collector sees lost ones. Fields are in the
+ * RP2040's little-endian order.
+ */
+struct telemetry_header
+{
+    uint32_t magic;   // TELEMETRY_MAGIC
+    uint8_t version;  // TELEMETRY_VERSION
+    uint8_t type;     // telemetry_type
+    uint16_t count;   // Records that follow
+    uint32_t session; // Boot session
+    uint32_t seq;     // Datagram sequence number
+};
+_Static_assert(sizeof(struct telemetry_header) == 16, "telemetry headers are 16 bytes on the wire");
+
+/**
+ * @brief Global counters at the start of a TELEMETRY_STATS datagram.
+ */
+struct telemetry_counters
+{
+    uint32_t uptime_ms;
+    uint32_t events_dropped;   // Events the queue had no room for
+    uint32_t events_lost;      // Events overwritten before the stream sent them
+    uint32_t commands_refused; // Commands that failed authentication or validation
+};
+
+/**
+ * @brief One latency histogram in a TELEMETRY_STATS datagram, in latency_stat order.
+ */
+struct telemetry_stat
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+};
+
+/**
+ * @brief Command opcodes.
+ */
+typedef enum
+{
+    COMMAND_SET_PHASE = 1,  // Retune one phase of one intersection
+    COMMAND_RESET_STATS = 2 // Clear the latency histograms
+} command_opcode;
+
+/**
+ * @brief Outcome of a command, returned in its acknowledgement.
+ */
+typedef enum
+{
+    COMMAND_OK,
+    COMMAND_DISABLED, // No key configured
+    COMMAND_BAD_MAC,  // Authentication failed, or wrong session
+    COMMAND_REPLAY,   // Counter not above the last accepted one
+    COMMAND_INVALID   // Unknown opcode or values out of range
+} command_status;
+
+/**
+ * @brief Command datagram, 40 bytes.
+ *
+ * `mac` is SipHash-2-4 of the first 32 bytes under TELEMETRY_KEY. The
+ * counter must grow with every command of a session. For
+ * COMMAND_SET_PHASE `timing` replaces that of phases[phase] of
+ * intersection `intersection` from the next time the phase is entered
+ * (and is saved when TRAFFIC_LIGHT_PERSIST is set); it is ignored by the
+ * other opcodes.
+ */
+struct telemetry_command
+{
+    uint32_t magic;        // TELEMETRY_MAGIC
+    uint8_t version;       // TELEMETRY_VERSION
+    uint8_t opcode;        // command_opcode
+    uint8_t intersection;  // Index into intersections[]
+    uint8_t phase;         // traffic_light_state
+    uint32_t session;      // Session of the controller, from its datagrams
+    uint32_t counter;      // Replay counter
+    struct phase_timing timing;
+    uint8_t mac[8];
+};
+_Static_assert(sizeof(struct telemetry_command) == 40, "commands are 40 bytes on the wire");
+
+/**
+ * @brief Acknowledgement of a command, sent back to its source.
+ */
+struct telemetry_ack
+{
+    uint32_t counter; // Counter of the command
+    uint8_t opcode;   // command_opcode
+    uint8_t status;   // command_status
+    uint16_t reserved;
+};
+
+/**
+ * @brief Telemetry stream and command channel state.
+ *
+ * Only touched from the cyw43 async context (workers and lwIP receive
+ * callbacks), except the phase tables, which commands update inside
+ * control_enter() / control_exit().
+ */
+struct telemetry
+{
+    struct udp_pcb *pcb;
+    ip_addr_t host;
+    bool streaming;         // A collector is configured
+    bool keyed;             // Commands can be authenticated
+    uint64_t key[2];        // SipHash key
+    uint32_t session;
+    uint32_t seq;           // Next datagram sequence number
+    uint32_t tail;          // Next event_queue record to stream (free-running, like event_tail)
+    uint32_t events_lost;
+    uint32_t datagrams;
+    uint32_t last_counter;  // Counter of the last accepted command
+    uint32_t commands;
+    uint32_t commands_refused;
+    uint64_t stats_due_us;
+    async_at_time_worker_t worker;
+};
+
+struct telemetry telemetry = {0};
+
+#endif
+
+#if TRAFFIC_LIGHT_RUNTIME_PHASES
+/**
+ * @brief Phase tables in use when they may change at run time, indexed like intersections[].
+ */
+struct phase phase_tables[INTERSECTION_COUNT][PHASE_COUNT];
+#endif
+
+/**
+ * @brief Counts kept across resets by the persistent counter log.
+ */
+struct lifetime_counters
+{
+    uint32_t boots;
+    uint32_t presses; // Pedestrian requests
+    uint32_t cycles;  // Pedestrian phases run
+    uint32_t faults;  // Display bus errors and events dropped
+};
+
+/**
+ * @brief Lifetime counters, incremented where the counted thing happens.
+ *
+ * Restored from the counter log at boot when TRAFFIC_LIGHT_PERSIST is
+ * set, otherwise counted from zero.
+ */
+struct lifetime_counters lifetime = {0};
+
+/**
+ * @brief Fastest entry of i2c_rates[] the startup probe may select.
+ *
+ * Lowered for good by a bus failure, so a marginal panel is not probed
+ * into errors again after every reset (with TRAFFIC_LIGHT_PERSIST).
+ */
+uint i2c_rate_limit = count_of(i2c_rates) - 1;
+
+#if TRAFFIC_LIGHT_PERSIST
+/**
+ * @brief Keys of the persistent store.
+ */
+typedef enum
+{
+    PERSIST_I2C_RATE,    // uint8_t i2c_rate_limit
+    PERSIST_WAVE_OFFSET, // uint32_t green-wave offset in ms (TRAFFIC_LIGHT_GREEN_WAVE)
+    PERSIST_PHASES,      // struct phase_timing[PHASE_COUNT] of intersection 0; one key per intersection follows
+    PERSIST_KEY_COUNT = PERSIST_PHASES + INTERSECTION_COUNT
+} persist_key;
+_Static_assert(PERSIST_KEY_COUNT < 32, "dirty keys are tracked in one word");
+_Static_assert(PERSIST_KEY_COUNT <= FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE, "every key must fit in one sector");
+
+/**
+ * @brief Header of a key/value record; each record takes one flash page.
+ *
+ * Records are appended to the active sector. The one with the highest
+ * `seq` for a key holds its value; when the sector is full, the other one
+ * is erased and every key is rewritten into it. A record torn by a reset
+ * fails its CRC and is skipped, leaving the previous value.
+ */
+struct kv_header
+{
+    uint32_t magic;  // KV_MAGIC
+    uint32_t seq;    // Store-wide write sequence
+    uint16_t key;    // persist_key
+    uint16_t length; // Value bytes that follow
+    uint32_t crc;    // CRC-32 of the header up to here and of the value
+};
+
+#define KV_VALUE_MAX (FLASH_PAGE_SIZE - sizeof(struct kv_header))
+_Static_assert(PHASE_COUNT * sizeof(struct phase_timing) <= KV_VALUE_MAX, "a phase table must fit in one record");
+
+/**
+ * @brief Counter log record, 32 bytes; eight share a flash page.
+ *
+ * Appended round-robin over the log sectors, so every sector is erased
+ * once per PERSIST_LOG_SECTORS * 128 records. A sector is erased when
+ * the log wraps into it, which drops its oldest 128 records. The valid
+ * record with the highest `seq` is current.
+ */
+struct counter_record
+{
+    uint32_t magic; // LOG_MAGIC
+    uint32_t seq;
+    struct lifetime_counters counters;
+    uint32_t reserved;
+    uint32_t crc;   // CRC-32 of the preceding bytes
+};
+_Static_assert(sizeof(struct counter_record) == 32, "counter records are 32 bytes in flash");
+
+#define LOG_RECORDS_PER_SECTOR (FLASH_SECTOR_SIZE / sizeof(struct counter_record))
+#define LOG_SLOTS (PERSIST_LOG_SECTORS * LOG_RECORDS_PER_SECTOR)
+
+/**
+ * @brief Persistent store state, owned by the loop that runs persist_service().
+ *
+ * `dirty` is also set from interrupt handlers and the network context,
+ * inside the control-side critical section.
+ */
+struct persist
+{
+    volatile uint32_t dirty;          // Bit per persist_key with a value to write
+    uint32_t kv_seq;                  // Highest key/value sequence in flash
+    uint kv_sector;                   // Active key/value sector
+    uint kv_next_page;                // Next blank page in it (KV_PAGES_PER_SECTOR = full)
+    uint64_t config_due_us;           // Earliest time of the next key/value write
+    uint32_t log_seq;                 // Sequence of the last counter record
+    uint log_next;                    // Next counter log slot
+    uint64_t log_due_us;              // Earliest time of the next counter record
+    struct lifetime_counters logged;  // Counters in the last record
+    uint32_t erases;
+    uint32_t programs;
+    uint32_t deferred;                // Attempts put off because the window was too short
+};
+
+struct persist persist = {0};
+#endif
+
+/**
+ * @brief Set when the boot skips the start-up delays and brings the display up last.
+ *
+ * Fixed by TRAFFIC_LIGHT_FAST_BOOT, and also set when the controller
+ * resumes after a watchdog reset.
+ */
+bool quick_start = TRAFFIC_LIGHT_FAST_BOOT;
+
+#if TRAFFIC_LIGHT_WATCHDOG
+_Static_assert(count_of(intersection_configs) <= 3, "watchdog scratch registers 1-3 hold one state each");
+
+/**
+ * @brief Progress checks behind the watchdog feed, and the recovery state.
+ *
+ * Scratch register 0 holds WATCHDOG_MAGIC and the count of watchdog
+ * resets in a row; registers 1 to 3 hold the state word of each
+ * intersection, with the remaining time of its phase in place of the
+ * duration. Registers 4 to 7 belong to the SDK.
+ */
+struct fault_monitor
+{
+    uint32_t faults;       // Watchdog resets in a row
+    bool resumed;          // This boot restored saved phases
+    bool safe_mode;        // Too many resets: flashing red
+    bool lamps_on;         // Safe mode flash phase
+    uint32_t last_tail;    // event_tail at the last check
+    uint64_t consumer_us;  // Last time the event consumer was seen keeping up
+    alarm_id_t heartbeat;  // Wakes the main loop to feed the watchdog
+};
+
+struct fault_monitor monitor = {0};
+#endif
+
+/**
+ * @brief Signal outputs accumulated during a scheduler pass.
+ *
+ * turn_on_signal() only records the new levels; flush_signals() applies
+ * them to every head in a single gpio_put_masked() write.
+ */
+uint32_t pending_signal_mask = 0;
+uint32_t pending_signal_value = 0;
+
+/**
+ * @brief Levels of every signal GPIO, as last written by flush_signals().
+ */
+uint32_t signal_levels = 0;
+
+/**
+ * @brief Boot milestones, in microseconds since reset.
+ *
+ * boot_red_us is taken when the fail-safe red is on every head and
+ * boot_display_us when the display is initialized; both are reported by
+ * report_boot_time().
+ */
+uint64_t boot_red_us = 0;
+uint64_t boot_display_us = 0;
+
+/**
+ * @brief Debounce state machine of each button on BUTTON_PIO.
+ *
+ * Indexed by intersection, then button (0 = A, 1 = B); -1 when no state
+ * machine was available and the button falls back to the GPIO edge IRQ.
+ */
+int button_sms[INTERSECTION_COUNT][2];
+
+/**
+ * @brief Signal output state machine on SIGNAL_PIO.
+ *
+ * -1 when some signal LED lies outside the PIO pin window; the LEDs are
+ * then written with gpio_put_masked().
+ */
+int signal_sm = -1;
+
+/**
+ * @brief Current power mode and the time it was entered.
+ *
+ * Each mode change is logged with the time spent in the previous mode so
+ * current-draw measurements per mode can be matched with residency.
+ */
+power_mode current_power_mode = POWER_ACTIVE;
+uint64_t power_mode_since_us = 0;
+uint32_t dormant_entries = 0;
+
+/**
+ * @brief Single-producer/single-consumer event ring.
+ *
+ * Interrupt handlers (scheduler alarm and GPIO) are the producer and the
+ * main loop is the consumer (the core 1 loop in dual-core mode). Both
+ * producers run at the same default IRQ priority on the same core, so
+ * they never preempt each other and act as a single producer. Indices
+ * are free-running; only the producer writes `event_head` and only the
+ * consumer writes `event_tail`.
+ */
+struct light_event event_queue[EVENT_QUEUE_SIZE];
+volatile uint32_t event_head = 0;
+volatile uint32_t event_tail = 0;
+
+/**
+ * @brief Number of events discarded because the queue was full.
+ */
+volatile uint32_t events_dropped = 0;
+
+/**
+ * @brief Sequence number of the next posted event, written by the producer only.
+ */
+uint16_t event_seq = 0;
+
+/**
+ * @brief Latency histograms, indexed by latency_stat.
+ *
+ * Interrupt handlers on core 0 and the display loop record into them
+ * without locking; a report printed while a sample is being recorded
+ * may be off by that one sample.
+ */
+struct latency_histogram latency_stats[STAT_COUNT] = {
+    [STAT_BUTTON_HANDLER] = {.name = "button handler"},
+    [STAT_BUTTON_TO_LIGHT] = {.name = "button to light"},
+    [STAT_TICK_JITTER] = {.name = "tick jitter"},
+    [STAT_CONTROLLER] = {.name = "controller"},
+    [STAT_DISPLAY_RENDER] = {.name = "display render"},
+    [STAT_DISPLAY_FLUSH] = {.name = "display flush"},
+    [STAT_PEDESTRIAN_WAIT] = {.name = "pedestrian wait"},
+    [STAT_WAVE_ALIGNMENT] = {.name = "wave alignment"},
+};
+
+/**
+ * @brief Deadline the scheduler alarm is armed for, to measure its jitter.
+ */
+uint64_t scheduler_deadline_us = 0;
+
+/**
+ * @brief Start of the asynchronous display flush in progress.
+ */
+volatile uint32_t display_flush_start_us = 0;
+
+/**
+ * @brief Serial console input collected so far, owned by poll_console().
+ */
+char console_line[CONSOLE_LINE_MAX];
+uint console_length = 0;
+
+/**
+ * @brief Latest state of each intersection, published under a sequence lock.
+ *
+ * The control side (core 0 interrupt handlers) is the only writer. The
+ * sequence counter is odd while an update is in progress; readers retry
+ * until they observe the same even value before and after copying, so the
+ * writer never waits on a reader on the other core.
+ */
+struct light_snapshot published_snapshots[INTERSECTION_COUNT];
+volatile uint32_t snapshot_seq = 0;
+
+// Function prototypes
+
+void turn_on_signal(struct intersection *x);
+void flush_signals();
+void enter_phase(struct intersection *x, traffic_light_state state);
+void setup();
+void init_signals();
+void report_boot_time();
+void button_interrupt_handler(uint gpio, uint32_t events);
+void button_pio_irq_handler();
+void handle_button_press(uint gpio, uint32_t irq_us);
+void init_pio();
+void update_debounce_clock();
+void change_state(struct intersection *x);
+uint32_t phase_duration(const struct intersection *x, traffic_light_state state, uint64_t start_us);
+void update_demand(struct intersection *x, uint64_t now_us);
+uint32_t phase_remaining_ms(const struct intersection *x, uint64_t now_us);
+bool request_crossing(struct intersection *x, light_state request);
+#if TRAFFIC_LIGHT_GREEN_WAVE
+uint32_t green_wave_hold_ms(const struct intersection *x, traffic_light_state state, uint64_t start_us);
+uint32_t green_wave_error_us(uint64_t now_us);
+void init_green_wave();
+void green_wave_sync(async_context_t *context, async_at_time_worker_t *worker);
+void green_wave_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
+void green_wave_add_sample(const struct green_wave_packet *packet, uint64_t t4);
+void green_wave_send(const struct green_wave_packet *packet, const ip_addr_t *addr, u16_t port);
+void print_green_wave();
+#endif
+#if TRAFFIC_LIGHT_NETWORK
+bool init_network();
+bool network_link_up();
+#endif
+#if TRAFFIC_LIGHT_TELEMETRY
+void init_telemetry();
+void telemetry_work(async_context_t *context, async_at_time_worker_t *worker);
+void telemetry_send_events();
+void telemetry_send_stats();
+bool telemetry_send(telemetry_type type, uint count, struct pbuf *body, const ip_addr_t *addr, u16_t port);
+void telemetry_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
+command_status run_remote_command(const struct telemetry_command *command);
+void sipround(uint64_t v[4]);
+uint64_t siphash24(const uint64_t key[2], const uint8_t *data, size_t len);
+void print_telemetry();
+#endif
+#if TRAFFIC_LIGHT_RUNTIME_PHASES
+bool phase_timing_valid(const struct phase *phase, const struct phase_timing *timing);
+void set_phase_timing(struct phase *phase, const struct phase_timing *timing);
+#endif
+#if TRAFFIC_LIGHT_PERSIST
+uint32_t crc32(const void *data, size_t len, uint32_t crc);
+void init_persist();
+void persist_load_config();
+void persist_load_counters();
+void persist_mark(persist_key key);
+uint persist_encode(persist_key key, uint8_t *value);
+bool persist_decode(persist_key key, const uint8_t *value, uint length);
+void persist_service();
+bool persist_write_config();
+void persist_write_counters();
+bool persist_window_open(uint32_t need_us);
+bool persist_flash_op(uint32_t offset, const uint8_t *page);
+bool flash_blank(uint32_t offset, size_t len);
+#endif
+void print_persist();
+#if TRAFFIC_LIGHT_WATCHDOG
+void check_watchdog_reboot();
+void resume_saved_phases();
+void init_watchdog();
+void service_watchdog();
+void save_watchdog_state(uint64_t now_us);
+int64_t watchdog_heartbeat(alarm_id_t id, void *user_data);
+void start_safe_mode();
+int64_t safe_mode_flash(alarm_id_t id, void *user_data);
+#endif
+uint32_t control_enter();
+void control_exit(uint32_t irq_status);
+void pwm_init_buzzer(uint pin);
+void pwm_update_buzzer_clock(uint pin);
+void init_clocks();
+void set_power_mode(power_mode mode);
+void update_power_mode();
+void enter_dormant();
+void buzzer_play(const struct buzzer_pattern *pattern, uint32_t duration_ms);
+void buzzer_start_tone(const struct tone *tone);
+int64_t buzzer_step(alarm_id_t id, void *user_data);
+int64_t state_controller(alarm_id_t id, void *user_data);
+void advance_intersection(struct intersection *x);
+bool is_time_to_change(const struct intersection *x);
+uint64_t next_step_deadline(const struct intersection *x, uint64_t from_us);
+void start_step(struct intersection *x, uint64_t from_us);
+void schedule_next_step();
+bool event_queue_empty();
+void init_display();
+void update_display(const struct light_snapshot *snapshots);
+void draw_static_layer();
+void probe_display_bus();
+void downshift_display_bus();
+void draw_field(uint column, uint row, uint width, const char *text);
+display_message choose_message(const struct light_snapshot *snapshot, uint32_t remaining_ms);
+void flush_display();
+#if TRAFFIC_LIGHT_DASHBOARD
+void format_count(char *text, uint32_t value);
+void text_widget_set(struct text_widget *widget, const char *text);
+void bar_widget_draw_frame(const struct bar_widget *bar);
+uint64_t bar_widget_set(struct bar_widget *bar, uint64_t value, uint64_t total);
+void list_widget_push(struct list_widget *list, const char *text);
+void dashboard_begin();
+void update_dashboard(const struct light_snapshot *snapshots);
+void dashboard_log_event(const struct light_event *event);
+void dashboard_schedule(uint64_t at_us);
+int64_t dashboard_tick(alarm_id_t id, void *user_data);
+#endif
+#if TRAFFIC_LIGHT_LARGE_DISPLAY
+void draw_large_field(uint row, int scale, const char *text);
+void update_large_display(const struct light_snapshot *snapshots);
+#endif
+char *get_state_string(const struct light_snapshot *snapshot);
+
+int some_button_pressed(const struct intersection *x);
+bool any_button_pressed(const struct light_snapshot *snapshots);
+bool all_resting(const struct light_snapshot *snapshots);
+void take_snapshot(const struct intersection *x, struct light_snapshot *snapshot);
+void publish_snapshot(const struct intersection *x);
+void read_snapshots(struct light_snapshot *snapshots);
+void print_intersection(uint index);
+void core1_entry();
+bool post_event(light_event_type type, const struct intersection *x, uint gpio);
+bool pop_event(struct light_event *event);
+void write_raw_event(const struct light_event *event);
+void print_event(const struct light_event *event);
+void process_events();
+void record_latency(latency_stat stat, uint32_t us);
+void reset_latency_stats();
+void print_latency_stats();
+void display_flush_done();
+void poll_console();
+void run_command(const char *line);
+void console_chars_available(void *param);
+
+/**
+ * @brief Returns a string representing the current traffic light state or pedestrian instruction.
+ *
+ * Looks the text up in the phase table: with a pedestrian request pending
+ * it is the instruction ("Walk!" in RED, "Wait" otherwise), without it the
+ * traffic light color ("RED", "YELLOW" or "GREEN").
+ *
+ * @param snapshot State to describe.
+ * @return Pointer to a string literal representing the state or pedestrian instruction.
+ */
+char* get_state_string(const struct light_snapshot *snapshot){
+    return (char *)snapshot->phase->label[snapshot->pedestrian];
+}
+
+/**
+ * @brief Checks if any pedestrian button of an intersection is pressed.
+ *
+ * Returns a non-zero value if either button A or button B is currently pressed.
+ *
+ * @param x Intersection to check.
+ * @return int Non-zero if any button is pressed; zero otherwise.
+ */
+int some_button_pressed(const struct intersection *x)
+{
+    return x->current & LIGHT_REQUESTS;
+}
+
+/**
+ * @brief Checks if any intersection has a pedestrian request pending.
+ *
+ * @param snapshots Snapshots of every intersection.
+ * @return true if at least one request is pending.
+ */
+bool any_button_pressed(const struct light_snapshot *snapshots)
+{
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+        if (snapshots[i].pedestrian)
+            return true;
+    return false;
+}
+
+/**
+ * @brief Checks if every intersection is resting.
+ *
+ * @param snapshots Snapshots of every intersection.
+ * @return true if all intersections rest waiting for demand.
+ */
+bool all_resting(const struct light_snapshot *snapshots)
+{
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+        if (!snapshots[i].resting)
+            return false;
+    return true;
+}
+
+/**
+ * @brief Initializes the OLED display and I2C interface.
+ *
+ * Sets up the I2C peripheral at the slowest rate of i2c_rates[],
+ * configures SDA and SCL pins for I2C functionality with pull-ups,
+ * and initializes the SSD1306 OLED display. If the panel acknowledged
+ * its configuration, probe_display_bus() then raises the clock.
+ *
+ * Clears the display buffer and updates the display to show a blank screen.
+ */
+void init_display()
+{
+    i2c_init(I2C_PORT, i2c_rates[0]);
+    gpio_set_function(I2C_SDA, GPIO_FUNC_I2C);
+    gpio_set_function(I2C_SCL, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_SDA);
+    gpio_pull_up(I2C_SCL);
+    ssd1306_set_baudrate(I2C_PORT, i2c_rates[0]);
+    i2c_rate_index = 0;
+
+    // Inicializa o display OLED
+    if (ssd1306_init(I2C_PORT))
+        probe_display_bus();
+    else
+        printf("Display not responding!\n");
+    ssd1306_clear();
+    ssd1306_present();
+    ssd1306_update(I2C_PORT);
+    boot_display_us = time_us_64();
+}
+
+/**
+ * @brief Raises the display I2C clock to the fastest reliable rate.
+ *
+ * Steps through i2c_rates[] up to I2C_MAX_BAUD and i2c_rate_limit. A
+ * rate is kept only if I2C_PROBE_ROUNDS probes in a row are
+ * acknowledged; on the first failure the previous rate is restored,
+ * becomes i2c_rate_limit and the search stops.
+ */
+void probe_display_bus()
+{
+    for (uint i = i2c_rate_index + 1; i <= i2c_rate_limit && i2c_rates[i] <= I2C_MAX_BAUD; i++)
+    {
+        bool ok = true;
+        ssd1306_set_baudrate(I2C_PORT, i2c_rates[i]);
+        for (uint round = 0; round < I2C_PROBE_ROUNDS && ok; round++)
+            ok = ssd1306_probe(I2C_PORT);
+        if (!ok)
+        {
+            ssd1306_set_baudrate(I2C_PORT, i2c_rates[i2c_rate_index]);
+            i2c_rate_limit = i2c_rate_index;
+#if TRAFFIC_LIGHT_PERSIST
+            persist_mark(PERSIST_I2C_RATE);
+#endif
+            break;
+        }
+        i2c_rate_index = i;
+    }
+    printf("Display I2C at %u kHz\n", i2c_rates[i2c_rate_index] / 1000);
+}
+
+/**
+ * @brief Drops the display I2C clock one step after a bus failure.
+ *
+ * Called when the driver reports a NACK or timeout. The failed frame is
+ * resent in full by the next update. The lower rate also becomes
+ * i2c_rate_limit, so later probes stop below the one that failed.
+ */
+void downshift_display_bus()
+{
+    uint32_t irq_status = control_enter();
+    lifetime.faults++;
+    control_exit(irq_status);
+    display_bus_errors++;
+
+    if (i2c_rate_index == 0)
+    {
+        printf("Display I2C error at %u kHz\n", i2c_rates[0] / 1000);
+        return;
+    }
+    i2c_rate_index--;
+    i2c_rate_limit = i2c_rate_index;
+#if TRAFFIC_LIGHT_PERSIST
+    persist_mark(PERSIST_I2C_RATE);
+#endif
+    ssd1306_set_baudrate(I2C_PORT, i2c_rates[i2c_rate_index]);
+    printf("Display I2C error, down to %u kHz\n", i2c_rates[i2c_rate_index] / 1000);
+}
+
+/**
+ * @brief Draws the parts of the screen that never change.
+ *
+ * The title, the state and countdown labels and the intersection numbers
+ * of the summary line stay in the framebuffer; update_display() only
+ * draws over the fields next to them.
+ */
+void draw_static_layer()
+{
+    ssd1306_clear();
+    ssd1306_draw_string(0, TITLE_ROW, "Traffic Light System", true);
+    ssd1306_draw_string(0, STATE_ROW, "Current State:", true);
+
+    if (INTERSECTION_COUNT > 1)
+    {
+        char label[4];
+        for (uint i = 0; i < INTERSECTION_COUNT && (i + 1) * SUMMARY_SLOT_COLUMNS <= DISPLAY_COLUMNS; i++)
+        {
+            snprintf(label, sizeof(label), "%u:", i + 1);
+            ssd1306_draw_string(i * SUMMARY_SLOT_COLUMNS * CHAR_WIDTH, SUMMARY_ROW, label, true);
+        }
+    }
+}
+
+/**
+ * @brief Draws text into a fixed-width field, padding it with spaces.
+ *
+ * The padding erases whatever a longer previous value left behind, so a
+ * field can be redrawn without clearing the screen.
+ *
+ * @param column First character cell of the field.
+ * @param row Pixel row of the field.
+ * @param width Field width in character cells.
+ * @param text Text to draw; truncated to the field width.
+ */
+void draw_field(uint column, uint row, uint width, const char *text)
+{
+    char field[DISPLAY_COLUMNS + 1];
+    snprintf(field, sizeof(field), "%-*.*s", (int)width, (int)width, text);
+    ssd1306_draw_string(column * CHAR_WIDTH, row, field, true);
+}
+
+/**
+ * @brief Text of each display_message.
+ */
+static const char *const display_messages[] = {
+    [MESSAGE_COUNTDOWN] = "Countdown:",
+    [MESSAGE_PRESSED] = "Button Pressed!",
+    [MESSAGE_WAITING] = "Waiting for button...",
+};
+
+/**
+ * @brief Picks the message line for the first intersection.
+ *
+ * @param snapshot State of the intersection.
+ * @param remaining_ms Time left in its phase, rounded up.
+ * @return The countdown in a phase that has one and a pending request,
+ *         "pressed" with a request otherwise, "waiting" without one.
+ */
+display_message choose_message(const struct light_snapshot *snapshot, uint32_t remaining_ms)
+{
+    uint32_t countdown_from = snapshot->phase->countdown_from;
+    if (snapshot->pedestrian && countdown_from && remaining_ms <= countdown_from)
+        return MESSAGE_COUNTDOWN;
+    if (snapshot->pedestrian)
+        return MESSAGE_PRESSED;
+    return MESSAGE_WAITING;
+}
+
+/**
+ * @brief Updates the OLED display with current traffic light information.
+ *
+ * Displays the system title, the state of the first intersection, and additional
+ * messages based on its state and button interaction:
+ * - If the phase has a countdown (RED: ≤ 5 seconds remaining) and a button is pressed, shows it.
+ * - If a button is pressed in other states, shows "Button Pressed!".
+ * - Otherwise, shows "Waiting for button...".
+ *
+ * With more than one intersection, a summary line shows the signal of
+ * every head.
+ *
+ * The static layer is drawn on the first call only. Afterwards each
+ * dynamic field is formatted and drawn only when its value differs from
+ * display_cache, so an update without changes touches no framebuffer
+ * byte and, with dirty-page flushing, sends nothing over I2C.
+ *
+ * The frame is drawn into the back buffer, presented and flushed through
+ * DMA, so this returns without waiting for the I2C transfer to complete.
+ * A bus failure reported for the previous flush lowers the I2C clock
+ * first.
+ *
+ * @param snapshots State of every intersection.
+ */
+void update_display(const struct light_snapshot *snapshots)
+{
+    const struct light_snapshot *snapshot = &snapshots[0];
+    struct display_cache *cache = &display_cache;
+
+    if (!cache->valid)
+    {
+        draw_static_layer();
+        cache->state = NULL;
+        cache->message = MESSAGE_NONE;
+        cache->countdown = -1;
+        memset(cache->signals, 0, sizeof(cache->signals));
+        cache->valid = true;
+    }
+
+    const char *state = get_state_string(snapshot);
+    if (state != cache->state)
+    {
+        draw_field(STATE_FIELD_COLUMN, STATE_ROW, DISPLAY_COLUMNS - STATE_FIELD_COLUMN, state);
+        cache->state = state;
+    }
+
+    // Remaining time from the phase deadline, rounded up, so a late redraw still shows the right second
+    uint64_t now = time_us_64();
+    uint32_t remaining_ms = snapshot->end_us > now ? (snapshot->end_us - now + 999) / 1000 : 0;
+    display_message message = choose_message(snapshot, remaining_ms);
+
+    if (message != cache->message)
+    {
+        draw_field(0, MESSAGE_ROW, DISPLAY_COLUMNS, display_messages[message]);
+        cache->message = message;
+        cache->countdown = -1;
+    }
+
+    if (message == MESSAGE_COUNTDOWN && (int)((remaining_ms + 999) / 1000) != cache->countdown)
+    {
+        char digits[DISPLAY_COLUMNS + 1];
+        cache->countdown = (remaining_ms + 999) / 1000;
+        snprintf(digits, sizeof(digits), "%d s", cache->countdown);
+        draw_field(COUNTDOWN_FIELD_COLUMN, MESSAGE_ROW, DISPLAY_COLUMNS - COUNTDOWN_FIELD_COLUMN, digits);
+    }
+
+    if (INTERSECTION_COUNT > 1)
+    {
+        for (uint i = 0; i < INTERSECTION_COUNT && (i + 1) * SUMMARY_SLOT_COLUMNS <= DISPLAY_COLUMNS; i++)
+        {
+            char signal = snapshots[i].phase->signal_name[0];
+            if (signal == cache->signals[i])
+                continue;
+            cache->signals[i] = signal;
+            ssd1306_draw_char((i * SUMMARY_SLOT_COLUMNS + 2) * CHAR_WIDTH, SUMMARY_ROW, signal, true);
+        }
+    }
+    flush_display();
+}
+
+/**
+ * @brief Presents the drawn frame and starts sending it.
+ *
+ * A bus failure reported for the previous flush lowers the I2C clock
+ * first. The flush does not block; if the previous one is still in
+ * flight the frame stays in the back buffer and is presented by the
+ * redraw display_flush_done() requests once that flush completes.
+ */
+void flush_display()
+{
+    if (ssd1306_take_error())
+        downshift_display_bus();
+
+    // Set before trying, so a flush that completes in between still sees it
+    display_present_pending = true;
+    if (ssd1306_present())
+    {
+        display_present_pending = false;
+        display_flush_start_us = time_us_32();
+        ssd1306_update_async(I2C_PORT, display_flush_done);
+    }
+}
+
+#if TRAFFIC_LIGHT_DASHBOARD
+/**
+ * @brief Formats a counter in at most COUNT_CHARS characters.
+ *
+ * Counts that do not fit are shown in thousands ("9999k") or millions
+ * ("4294M"), rounded down, so a growing counter is never cut off.
+ *
+ * @param text Destination, COUNT_CHARS + 1 bytes.
+ * @param value Count to format.
+ */
+void format_count(char *text, uint32_t value)
+{
+    if (value < 100000)
+        snprintf(text, COUNT_CHARS + 1, "%u", (uint)value);
+    else if (value < 10000000)
+        snprintf(text, COUNT_CHARS + 1, "%uk", (uint)(value / 1000));
+    else
+        snprintf(text, COUNT_CHARS + 1, "%uM", (uint)(value / 1000000));
+}
+
+/**
+ * @brief Sets the text of a text widget.
+ *
+ * Compared with the text on screen first, so an unchanged line costs a
+ * string compare. A changed one is drawn padded to the widget width; the
+ * glyph blitter only marks dirty the columns that actually differ.
+ *
+ * @param widget Widget to update.
+ * @param text New text; truncated to the widget width.
+ */
+void text_widget_set(struct text_widget *widget, const char *text)
+{
+    if (strncmp(widget->text, text, widget->width) == 0)
+        return;
+    snprintf(widget->text, sizeof(widget->text), "%.*s", widget->width, text);
+    draw_field(widget->column, widget->row, widget->width, widget->text);
+}
+
+/**
+ * @brief Draws the frame of a bar widget and empties it.
+ *
+ * @param bar Widget to draw.
+ */
+void bar_widget_draw_frame(const struct bar_widget *bar)
+{
+    ssd1306_fill_rect(bar->x, bar->y, bar->width, 1, true);
+    ssd1306_fill_rect(bar->x, bar->y + bar->height - 1, bar->width, 1, true);
+    ssd1306_fill_rect(bar->x, bar->y, 1, bar->height, true);
+    ssd1306_fill_rect(bar->x + bar->width - 1, bar->y, 1, bar->height, true);
+    ssd1306_fill_rect(bar->x + 1, bar->y + 1, bar->width - 2, bar->height - 2, false);
+}
+
+/**
+ * @brief Fills a bar widget to value / total, rounded down to one of its steps.
+ *
+ * Only the columns between the previous and the new fill are drawn.
+ *
+ * @param bar Widget to update.
+ * @param value Progress, clamped to total.
+ * @param total Full scale; 0 empties the bar.
+ * @return The smallest value that moves the fill to the next step, or
+ *         total once the last step is reached.
+ */
+uint64_t bar_widget_set(struct bar_widget *bar, uint64_t value, uint64_t total)
+{
+    int inner = bar->width - 2 * BAR_INSET;
+    uint step = total ? MIN(value, total) * bar->steps / total : 0;
+    int filled = step * inner / bar->steps;
+    uint64_t next = total && step < bar->steps - 1u ? ((step + 1) * total + bar->steps - 1) / bar->steps : total;
+    if (filled == bar->filled)
+        return next;
+
+    int x = bar->x + BAR_INSET;
+    int y = bar->y + BAR_INSET;
+    int height = bar->height - 2 * BAR_INSET;
+    if (filled > bar->filled)
+        ssd1306_fill_rect(x + bar->filled, y, filled - bar->filled, height, true);
+    else
+        ssd1306_fill_rect(x + filled, y, bar->filled - filled, height, false);
+    bar->filled = filled;
+    return next;
+}
+
+/**
+ * @brief Appends a line at the bottom of a list widget.
+ *
+ * Until the list is full the line goes to the next free page. Afterwards
+ * only the pages of the list shift up by one in the framebuffer and the
+ * line is drawn on the last one, so the update only carries the columns
+ * in which neighbouring lines differ.
+ *
+ * @param list Widget to update.
+ * @param text Line to append.
+ */
+void list_widget_push(struct list_widget *list, const char *text)
+{
+    uint page;
+    if (list->shown < list->rows)
+    {
+        page = list->page + list->shown++;
+    }
+    else
+    {
+        page = list->page + list->rows - 1;
+        ssd1306_scroll_pages(list->page, page);
+    }
+    draw_field(0, page * 8, DISPLAY_COLUMNS, text);
+}
+
+/**
+ * @brief Draws the static layer of the dashboard on first use.
+ *
+ * Clears the screen, draws the bar frame and forgets what the widgets
+ * showed, so the next update draws every line.
+ */
+void dashboard_begin()
+{
+    struct dashboard *d = &dashboard;
+    if (d->valid)
+        return;
+
+    ssd1306_clear();
+    d->state.text[0] = d->counters.text[0] = d->bus.text[0] = '\0';
+    d->progress.filled = 0;
+    ssd1306_draw_string(0, DASHBOARD_BAR_PAGE * 8, "Phase", true);
+    bar_widget_draw_frame(&d->progress);
+    ssd1306_draw_string(0, DASHBOARD_HISTORY_TITLE_PAGE * 8, "Last presses:", true);
+    d->history.shown = 0;
+    d->valid = true;
+}
+
+/**
+ * @brief Updates the dashboard with the current state.
+ *
+ * Lines, from the top:
+ * - the state of the first intersection, with the seconds left while
+ *   the status screen would show its countdown (and the summary of all
+ *   of them when there are more than one);
+ * - the progress of its phase;
+ * - pedestrian phases run and requests, kept across resets with
+ *   TRAFFIC_LIGHT_PERSIST;
+ * - the display bus clock and error count;
+ * - the history of button presses, written by dashboard_log_event().
+ *
+ * Every widget draws only what changed, then the frame is flushed like
+ * the status screen.
+ *
+ * @param snapshots State of every intersection.
+ */
+void update_dashboard(const struct light_snapshot *snapshots)
+{
+    const struct light_snapshot *snapshot = &snapshots[0];
+    struct dashboard *d = &dashboard;
+    char text[DISPLAY_COLUMNS + 1];
+
+    dashboard_begin();
+
+    uint64_t now = time_us_64();
+    uint64_t end = snapshot->end_us;
+    uint32_t remaining_ms = end > now ? (end - now + 999) / 1000 : 0;
+
+    uint used = snprintf(text, sizeof(text), "%s", get_state_string(snapshot));
+    if (choose_message(snapshot, remaining_ms) == MESSAGE_COUNTDOWN)
+        used += snprintf(text + used, sizeof(text) - used, " %lu s", (unsigned long)((remaining_ms + 999) / 1000));
+    for (uint i = 0; INTERSECTION_COUNT > 1 && i < INTERSECTION_COUNT && used + 4 < sizeof(text); i++)
+        used += snprintf(text + used, sizeof(text) - used, " %u:%c", i + 1, snapshots[i].phase->signal_name[0]);
+    text_widget_set(&d->state, text);
+
+    if (end > snapshot->start_us)
+    {
+        uint64_t span = end - snapshot->start_us;
+        uint64_t next = bar_widget_set(&d->progress, now - snapshot->start_us, span);
+        dashboard_schedule(next < span ? snapshot->start_us + next : 0);
+    }
+    else
+    {
+        bar_widget_set(&d->progress, 0, 0);
+        dashboard_schedule(0);
+    }
+
+    char walks[COUNT_CHARS + 1], presses[COUNT_CHARS + 1], errors[COUNT_CHARS + 1];
+    format_count(walks, lifetime.cycles);
+    format_count(presses, lifetime.presses);
+    snprintf(text, sizeof(text), "Walk %s Push %s", walks, presses);
+    text_widget_set(&d->counters, text);
+
+    format_count(errors, display_bus_errors);
+    snprintf(text, sizeof(text), "I2C %ukHz err %s", MIN(i2c_rates[i2c_rate_index] / 1000, 9999u), errors);
+    text_widget_set(&d->bus, text);
+
+    flush_display();
+}
+
+/**
+ * @brief Adds a button press to the dashboard history.
+ *
+ * Each line holds the uptime of the press, the intersection (with more
+ * than one), the button and the initial of the signal that was showing.
+ *
+ * @param event Button event record.
+ */
+void dashboard_log_event(const struct light_event *event)
+{
+    char text[DISPLAY_COLUMNS + 1];
+    char intersection[4] = "";
+    const struct phase *phase = &intersections[event->intersection].phases[event->state];
+    char button = event->gpio == intersection_configs[event->intersection].button_a ? 'A' : 'B';
+
+    // 64-bit time of the press from its 32-bit timestamp
+    uint64_t at_us = time_us_64() - (uint32_t)(time_us_32() - event->time_us);
+    uint32_t seconds = at_us / 1000000;
+    if (INTERSECTION_COUNT > 1)
+        snprintf(intersection, sizeof(intersection), "%u", event->intersection + 1);
+
+    snprintf(text, sizeof(text), "%02lu:%02lu:%02lu %s%c %c", (unsigned long)(seconds / 3600 % 100),
+             (unsigned long)(seconds / 60 % 60), (unsigned long)(seconds % 60), intersection, button,
+             phase->signal_name[0]);
+    dashboard_begin();
+    list_widget_push(&dashboard.history, text);
+}
+
+/**
+ * @brief Alarm of the next progress bar step and its time (0 = none armed).
+ */
+alarm_id_t dashboard_alarm = 0;
+uint64_t dashboard_alarm_us = 0;
+
+/**
+ * @brief Arms the redraw of the next progress bar step, replacing the pending one.
+ *
+ * Nothing stays armed while the phase is open-ended or the bar is on its
+ * last step, so a resting controller never wakes up for the display.
+ *
+ * @param at_us Time of the next step, or 0 for none.
+ */
+void dashboard_schedule(uint64_t at_us)
+{
+    if (at_us == dashboard_alarm_us)
+        return;
+    if (dashboard_alarm > 0)
+        cancel_alarm(dashboard_alarm);
+    dashboard_alarm = at_us ? add_alarm_at(from_us_since_boot(at_us), dashboard_tick, NULL, true) : 0;
+    dashboard_alarm_us = at_us;
+}
+
+/**
+ * @brief Progress bar alarm: requests the redraw that moves the fill one step.
+ */
+int64_t dashboard_tick(alarm_id_t id, void *user_data)
+{
+    display_refresh_due = true;
+    __sev();
+    return 0;
+}
+#endif
+
+#if TRAFFIC_LIGHT_LARGE_DISPLAY
+/**
+ * @brief Draws text into a field of the large-type text column, padding it with spaces.
+ *
+ * @param row Pixel row of the field.
+ * @param scale Font scale (2 or 3).
+ * @param text Text to draw; truncated to the column width.
+ */
+void draw_large_field(uint row, int scale, const char *text)
+{
+    char field[DISPLAY_COLUMNS + 1];
+    int width = LARGE_TEXT_COLUMNS(scale);
+    snprintf(field, sizeof(field), "%-*.*s", width, width, text);
+    ssd1306_draw_string_scaled(LARGE_TEXT_X, row, field, scale, true);
+}
+
+/**
+ * @brief Updates the large-type screen with the state of the first intersection.
+ *
+ * - The walk icon during the phase that serves pedestrians, the hand
+ *   icon otherwise.
+ * - The signal label.
+ * - The seconds left, while the status screen would show its countdown.
+ * - The instruction while a pedestrian request is pending.
+ *
+ * Like update_display(), each part is drawn only when its value changes.
+ * The icon and the glyphs are pre-scaled column bytes, so even a full
+ * icon change is a column copy into the framebuffer; only the columns
+ * that differ are flushed.
+ *
+ * @param snapshots State of every intersection.
+ */
+void update_large_display(const struct light_snapshot *snapshots)
+{
+    const struct light_snapshot *snapshot = &snapshots[0];
+    struct large_display *l = &large_display;
+
+    if (!l->valid)
+    {
+        ssd1306_clear();
+        l->icon = -1;
+        l->signal = NULL;
+        l->request = "";
+        l->countdown = -1;
+        l->valid = true;
+    }
+
+    ssd1306_icon icon = snapshot->phase->serves_pedestrians ? SSD1306_ICON_WALK : SSD1306_ICON_HAND;
+    if ((int)icon != l->icon)
+    {
+        ssd1306_draw_icon(0, 0, icon, true);
+        l->icon = icon;
+    }
+
+    const char *signal = snapshot->phase->label[0];
+    if (signal != l->signal)
+    {
+        draw_large_field(LARGE_SIGNAL_ROW, 2, signal);
+        l->signal = signal;
+    }
+
+    uint64_t now = time_us_64();
+    uint32_t remaining_ms = snapshot->end_us > now ? (snapshot->end_us - now + 999) / 1000 : 0;
+    int countdown = -1;
+    if (choose_message(snapshot, remaining_ms) == MESSAGE_COUNTDOWN)
+        countdown = (remaining_ms + 999) / 1000;
+    if (countdown != l->countdown)
+    {
+        char digits[DISPLAY_COLUMNS + 1] = "";
+        if (countdown >= 0)
+            snprintf(digits, sizeof(digits), "%d", countdown);
+        draw_large_field(LARGE_COUNTDOWN_ROW, LARGE_COUNTDOWN_SCALE, digits);
+        l->countdown = countdown;
+    }
+
+    const char *request = snapshot->pedestrian ? snapshot->phase->label[1] : "";
+    if (LARGE_REQUEST_ROW < SSD1306_HEIGHT && request != l->request)
+    {
+        draw_large_field(LARGE_REQUEST_ROW, 2, request);
+        l->request = request;
+    }
+    flush_display();
+}
+#endif
+
+/**
+ * @brief Starts playing a buzzer pattern, replacing the one playing.
+ *
+ * The pattern loops until duration_ms has elapsed (rounded up to the end
+ * of a step) or until another pattern replaces it. Takes one alarm; the
+ * steps that follow are chained by buzzer_step(). Safe to call from the
+ * control side and from the main loop.
+ *
+ * @param pattern Pattern to play, or NULL to silence the buzzer.
+ * @param duration_ms How long to play it (0 = until replaced).
+ */
+void buzzer_play(const struct buzzer_pattern *pattern, uint32_t duration_ms)
+{
+    uint32_t irq_status = control_enter();
+    uint64_t now = time_us_64();
+
+    if (buzzer.alarm > 0)
+        cancel_alarm(buzzer.alarm);
+    buzzer.alarm = 0;
+    buzzer.pattern = pattern;
+    buzzer.index = 0;
+    buzzer.end_us = duration_ms ? now + (uint64_t)duration_ms * 1000 : 0;
+
+    if (pattern)
+    {
+        buzzer_start_tone(&pattern->tones[0]);
+        buzzer.step_end_us = now + (uint64_t)pattern->tones[0].duration_ms * 1000;
+        buzzer.alarm = add_alarm_at(from_us_since_boot(buzzer.step_end_us), buzzer_step, NULL, true);
+    }
+    else
+    {
+        pwm_set_gpio_level(BUZZER, 0);
+    }
+    control_exit(irq_status);
+}
+
+/**
+ * @brief Drives the buzzer PWM for one step of a pattern.
+ *
+ * Sets the slice wrap for the pitch and the level to half of it (50%
+ * duty cycle). Both registers are double-buffered, so the new tone
+ * starts on a period boundary.
+ *
+ * @param tone Step to play.
+ */
+void buzzer_start_tone(const struct tone *tone)
+{
+    if (!tone->freq_hz)
+    {
+        pwm_set_gpio_level(BUZZER, 0);
+        return;
+    }
+    uint32_t wrap = BUZZER_PWM_HZ / tone->freq_hz - 1;
+    pwm_set_wrap(pwm_gpio_to_slice_num(BUZZER), wrap);
+    pwm_set_gpio_level(BUZZER, (wrap + 1) / 2);
+}
+
+/**
+ * @brief Advances the buzzer pattern to its next step.
+ *
+ * Callback of the buzzer alarm. Returning the negated step length
+ * reschedules the same alarm relative to the previous step end, so the
+ * cadence does not drift with interrupt latency and buzzer.step_end_us
+ * keeps matching the alarm.
+ *
+ * @param id Alarm identifier.
+ * @param user_data Unused.
+ * @return Minus the microseconds until the next step, or 0 once the
+ *         pattern is over.
+ */
+int64_t buzzer_step(alarm_id_t id, void *user_data)
+{
+    const struct buzzer_pattern *pattern = buzzer.pattern;
+    if (!pattern || (buzzer.end_us && buzzer.step_end_us >= buzzer.end_us))
+    {
+        pwm_set_gpio_level(BUZZER, 0);
+        buzzer.pattern = NULL;
+        buzzer.alarm = 0;
+        return 0;
+    }
+
+    buzzer.index = buzzer.index + 1 < pattern->count ? buzzer.index + 1 : 0;
+    const struct tone *tone = &pattern->tones[buzzer.index];
+    buzzer_start_tone(tone);
+    buzzer.step_end_us += (uint64_t)tone->duration_ms * 1000;
+    return -(int64_t)tone->duration_ms * 1000;
+}
+
+/**
+ * @brief Initializes the PWM configuration for the buzzer.
+ *
+ * Configures the specified GPIO pin for PWM output with the counter at
+ * BUZZER_PWM_HZ. Initially sets the duty cycle to 0 (silent); the pitch
+ * is set per tone by buzzer_start_tone().
+ *
+ * @param pin GPIO pin connected to the buzzer.
+ */
+void pwm_init_buzzer(uint pin)
+{
+    gpio_set_function(pin, GPIO_FUNC_PWM);
+    uint slice_num = pwm_gpio_to_slice_num(pin);
+    pwm_config config = pwm_get_default_config();
+    pwm_config_set_clkdiv(&config, (float)clock_get_hz(clk_sys) / BUZZER_PWM_HZ);
+    pwm_init(slice_num, &config, true);
+    pwm_set_gpio_level(pin, 0);
+}
+
+/**
+ * @brief Recomputes the buzzer PWM divider for the current clk_sys.
+ *
+ * The PWM slice is clocked from clk_sys, so the divider set by
+ * pwm_init_buzzer() must be recomputed whenever clk_sys changes to keep
+ * the counter at BUZZER_PWM_HZ and the pitches in tune.
+ *
+ * @param pin GPIO pin connected to the buzzer.
+ */
+void pwm_update_buzzer_clock(uint pin)
+{
+    pwm_set_clkdiv(pwm_gpio_to_slice_num(pin), (float)clock_get_hz(clk_sys) / BUZZER_PWM_HZ);
+}
+
+/**
+ * @brief Prepares the clock tree for clk_sys scaling.
+ *
+ * Moves clk_peri to pll_usb so the UART and I2C keep their baud rates
+ * when clk_sys changes. Must run before stdio and the I2C are
+ * initialized, since their baud divisors are computed from clk_peri.
+ */
+void init_clocks()
+{
+    clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB,
+                    PERI_CLOCK_HZ, PERI_CLOCK_HZ);
+}
+
+/**
+ * @brief Switches clk_sys between the full and quiet frequencies.
+ *
+ * Both PLLs keep running, so the switch is a glitchless mux change that
+ * takes a few cycles. Logs the time spent in the previous mode, except
+ * in dual-core mode, where this runs on core 0 and stdio belongs to
+ * core 1.
+ *
+ * @param mode POWER_ACTIVE or POWER_QUIET.
+ */
+void set_power_mode(power_mode mode)
+{
+    if (mode == current_power_mode)
+        return;
+
+    if (mode == POWER_ACTIVE)
+        clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                        CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS,
+                        SYS_CLOCK_FULL_HZ, SYS_CLOCK_FULL_HZ);
+    else
+        clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                        CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB,
+                        SYS_CLOCK_QUIET_HZ, SYS_CLOCK_QUIET_HZ);
+    pwm_update_buzzer_clock(BUZZER);
+    update_debounce_clock();
+
+    uint64_t now = time_us_64();
+#if !TRAFFIC_LIGHT_DUAL_CORE
+    // Core 1 owns stdio in dual-core mode; core 0 never waits on USB
+    printf("Power: %s (%lu MHz) after %llu ms in previous mode\n",
+           mode == POWER_ACTIVE ? "active" : "quiet",
+           (unsigned long)(clock_get_hz(clk_sys) / MHZ),
+           (unsigned long long)((now - power_mode_since_us) / 1000));
+#endif
+    current_power_mode = mode;
+    power_mode_since_us = now;
+}
+
+/**
+ * @brief Selects the power mode for the current controller state.
+ *
+ * Called from the main loop after the event queue has been drained:
+ * - All intersections resting at night: dormant until a button edge
+ *   (single-core only, since core 1 could be in the middle of an I2C
+ *   transfer).
+ * - Pedestrian request pending: full clock.
+ * - Otherwise: quiet clock.
+ */
+void update_power_mode()
+{
+    struct light_snapshot snapshots[INTERSECTION_COUNT];
+    read_snapshots(snapshots);
+#if !TRAFFIC_LIGHT_DUAL_CORE
+    if (all_resting(snapshots))
+    {
+        enter_dormant();
+        return;
+    }
+#endif
+    set_power_mode(any_button_pressed(snapshots) ? POWER_ACTIVE : POWER_QUIET);
+}
+
+/**
+ * @brief Puts the chip in dormant mode until a pedestrian button edge.
+ *
+ * Runs the system from the XOSC, stops both PLLs and then the XOSC itself.
+ * The signal outputs keep their levels and the display keeps its image.
+ * After wake-up the PIO debouncer sees the press that is still held and
+ * reports it (for GPIO-IRQ buttons the wake-up edge stays latched), so
+ * the regular button handling restarts the cycle. The system timer does
+ * not advance while dormant.
+ *
+ * @note USB CDC is lost while dormant; the host sees a disconnect.
+ */
+void enter_dormant()
+{
+    ssd1306_update_wait();
+    printf("Power: dormant after %llu ms in previous mode\n",
+           (unsigned long long)((time_us_64() - power_mode_since_us) / 1000));
+    stdio_flush();
+
+    uint32_t irq_status = save_and_disable_interrupts();
+
+    // A press that arrived since the last check is still pending
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+    {
+        const struct intersection_config *config = intersections[i].config;
+        uint32_t pending = gpio_get_irq_event_mask(config->button_a) | gpio_get_irq_event_mask(config->button_b);
+        for (uint b = 0; b < 2; b++)
+            if (button_sms[i][b] >= 0 && !pio_sm_is_rx_fifo_empty(BUTTON_PIO, button_sms[i][b]))
+                pending |= GPIO_IRQ_EDGE_FALL;
+        if (!(intersections[i].current & LIGHT_RESTING) || (pending & GPIO_IRQ_EDGE_FALL))
+        {
+            restore_interrupts(irq_status);
+            return;
+        }
+        // Drop edges latched by earlier, already debounced presses
+        if (button_sms[i][0] >= 0)
+            gpio_acknowledge_irq(config->button_a, GPIO_IRQ_EDGE_FALL);
+        if (button_sms[i][1] >= 0)
+            gpio_acknowledge_irq(config->button_b, GPIO_IRQ_EDGE_FALL);
+    }
+
+    // Run everything from the XOSC so the PLLs can be stopped
+    clock_configure(clk_ref, CLOCKS_CLK_REF_CTRL_SRC_VALUE_XOSC_CLKSRC, 0,
+                    XOSC_KHZ * KHZ, XOSC_KHZ * KHZ);
+    clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLK_REF, 0,
+                    XOSC_KHZ * KHZ, XOSC_KHZ * KHZ);
+    clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLK_SYS,
+                    XOSC_KHZ * KHZ, XOSC_KHZ * KHZ);
+    clock_stop(clk_usb);
+    clock_stop(clk_adc);
+    pll_deinit(pll_sys);
+    pll_deinit(pll_usb);
+
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+    {
+        gpio_set_dormant_irq_enabled(intersection_configs[i].button_a, GPIO_IRQ_EDGE_FALL, true);
+        gpio_set_dormant_irq_enabled(intersection_configs[i].button_b, GPIO_IRQ_EDGE_FALL, true);
+    }
+    xosc_dormant();
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+    {
+        gpio_set_dormant_irq_enabled(intersection_configs[i].button_a, GPIO_IRQ_EDGE_FALL, false);
+        gpio_set_dormant_irq_enabled(intersection_configs[i].button_b, GPIO_IRQ_EDGE_FALL, false);
+    }
+
+    // Restore the boot clock tree (clk_sys at full speed)
+    clocks_init();
+    init_clocks();
+    pwm_update_buzzer_clock(BUZZER);
+    update_debounce_clock();
+    current_power_mode = POWER_ACTIVE;
+    power_mode_since_us = time_us_64();
+    dormant_entries++;
+
+    restore_interrupts(irq_status);
+}
+
+/**
+ * @brief Enters the control-side critical section.
+ *
+ * Masks interrupts on this core around one state transition. Every
+ * section covers a bounded amount of work (a few field updates, at most
+ * one event post and an alarm re-arm, no I/O), so interrupts are masked
+ * for a few microseconds at most.
+ *
+ * @return Interrupt state to pass to control_exit().
+ */
+uint32_t control_enter()
+{
+    return save_and_disable_interrupts();
+}
+
+/**
+ * @brief Leaves the control-side critical section.
+ *
+ * @param irq_status Value returned by control_enter().
+ */
+void control_exit(uint32_t irq_status)
+{
+    restore_interrupts(irq_status);
+}
+
+/**
+ * @brief Services every intersection whose step deadline has passed.
+ *
+ * Callback of the one-shot scheduler alarm. Advances each due
+ * intersection, applies all the resulting signal changes in one register
+ * write and re-arms the alarm for the earliest remaining deadline.
+ *
+ * Runs in timer interrupt context; it performs no I2C or stdio work.
+ * Each intersection is advanced in its own critical section, so a button
+ * press is handled either before or after a step, never in the middle.
+ *
+ * @param id The alarm identifier.
+ * @param user_data Unused.
+ * @return Always 0; the alarm is re-armed by schedule_next_step().
+ */
+int64_t state_controller(alarm_id_t id, void *user_data)
+{
+    uint64_t now = time_us_64();
+    record_latency(STAT_TICK_JITTER, now - scheduler_deadline_us);
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+    {
+        struct intersection *x = &intersections[i];
+        uint32_t irq_status = control_enter();
+        if (x->step_deadline_us && x->step_deadline_us <= now)
+            advance_intersection(x);
+        control_exit(irq_status);
+    }
+
+    // This alarm has fired; one armed by a press meanwhile is replaced
+    uint32_t irq_status = control_enter();
+    if (scheduler_alarm == id)
+        scheduler_alarm = 0;
+    flush_signals();
+    schedule_next_step();
+    control_exit(irq_status);
+
+    record_latency(STAT_CONTROLLER, time_us_64() - now);
+    return 0;
+}
+
+/**
+ * @brief Manages traffic light state transitions for one intersection.
+ *
+ * Called when the step in progress has ended, inside the control-side
+ * critical section:
+ * - Decreases the remaining time for the current state by the step length.
+ * - Posts a tick event so the main loop refreshes the display and logs
+ *   the countdown.
+ * - With a button pressed, starts the phase beep pattern when the
+ *   countdown starts (RED: 5 seconds of walk ticks at exactly 5 seconds).
+ * - If the state duration reaches zero, transitions to the next state.
+ *   A rest-point phase (GREEN) without a pending request is repeated
+ *   instead, so no pedestrian phase is run for nobody; in low-power mode,
+ *   after NIGHT_IDLE_CYCLES such periods it stops scheduling until a
+ *   button is pressed.
+ * - Starts the next step, chained to the previous deadline so callback
+ *   latency does not accumulate.
+ *
+ * @param x Intersection to advance.
+ */
+void advance_intersection(struct intersection *x)
+{
+    light_state s = x->current;
+    const struct phase *phase = &x->phases[LIGHT_PHASE(s)];
+    uint64_t step_end_us = x->step_deadline_us;
+    uint32_t duration = x->phase_end_us > step_end_us ? (x->phase_end_us - step_end_us) / 1000 : 0;
+
+    x->current = LIGHT_STATE(LIGHT_PHASE(s), duration, s);
+    post_event(EVENT_TICK, x, 0);
+
+    if ((s & LIGHT_REQUESTS) && phase->beep_duration && duration == phase->countdown_from)
+    {
+        buzzer_play(phase->beep, phase->beep_duration);
+    }
+    if (is_time_to_change(x) && phase->rest_point && !(s & LIGHT_REQUESTS))
+    {
+        x->idle_cycles++;
+        update_demand(x, x->step_deadline_us);
+#if TRAFFIC_LIGHT_LOW_POWER
+        // Without demand for a long time, rest here until a press
+        if (x->idle_cycles >= NIGHT_IDLE_CYCLES)
+        {
+            x->current |= LIGHT_RESTING;
+            x->phase_end_us = 0;
+            x->step_deadline_us = 0;
+            post_event(EVENT_TICK, x, 0);
+            return;
+        }
+#endif
+        // Nobody waiting: another period of the same phase
+#if TRAFFIC_LIGHT_GREEN_WAVE
+        x->wave_locked = wave.synced;
+#endif
+        x->current = LIGHT_STATE(LIGHT_PHASE(s), phase_duration(x, LIGHT_PHASE(s), step_end_us), s);
+        x->phase_end_us = step_end_us + LIGHT_DURATION(x->current) * 1000ull;
+    }
+    else if (is_time_to_change(x))
+    {
+        change_state(x);
+    }
+
+    start_step(x, step_end_us);
+}
+
+/**
+ * @brief Computes the next instant an intersection needs attention.
+ *
+ * Without a pending pedestrian countdown nothing visible changes until
+ * the phase ends. In a phase with a countdown and a button pressed, the
+ * display shows whole seconds from `countdown_from` down, so the step
+ * stops there (when the beep starts) and then at every whole second
+ * before the end. Every deadline is derived from the absolute phase end,
+ * so steps never accumulate rounding or callback latency.
+ *
+ * @param x Intersection to check.
+ * @param from_us Absolute time the step starts at.
+ * @return Absolute deadline in microseconds since boot (0 = none, resting).
+ */
+uint64_t next_step_deadline(const struct intersection *x, uint64_t from_us)
+{
+    light_state s = x->current;
+    uint64_t end_us = x->phase_end_us;
+    uint64_t countdown_us = x->phases[LIGHT_PHASE(s)].countdown_from * 1000ull;
+    if (!countdown_us || !(s & LIGHT_REQUESTS) || end_us <= from_us)
+        return end_us;
+
+    uint64_t left_us = end_us - from_us;
+    if (left_us > countdown_us)
+        return end_us - countdown_us;
+    return end_us - (left_us - 1) / 1000000 * 1000000;
+}
+
+/**
+ * @brief Starts the next step of an intersection.
+ *
+ * @param x Intersection to schedule.
+ * @param from_us Absolute time, in microseconds since boot, the step starts at.
+ */
+void start_step(struct intersection *x, uint64_t from_us)
+{
+    x->step_deadline_us = next_step_deadline(x, from_us);
+}
+
+/**
+ * @brief Arms the scheduler alarm for the earliest step deadline.
+ *
+ * Called from the alarm itself and from the button handler, inside the
+ * control-side critical section, so the deadlines cannot change while the
+ * alarm is re-armed. Deadlines already in the past fire immediately.
+ */
+void schedule_next_step()
+{
+    uint64_t next = UINT64_MAX;
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+    {
+        uint64_t deadline = intersections[i].step_deadline_us;
+        if (deadline && deadline < next)
+            next = deadline;
+    }
+
+    if (scheduler_alarm > 0)
+        cancel_alarm(scheduler_alarm);
+    scheduler_alarm = 0;
+    if (next != UINT64_MAX)
+    {
+        scheduler_deadline_us = next;
+        scheduler_alarm = add_alarm_at(from_us_since_boot(next), state_controller, NULL, true);
+    }
+}
+
+/**
+ * @brief Checks if the traffic light should transition to the next state.
+ *
+ * Determines whether the current state's remaining duration has elapsed.
+ *
+ * @param x Intersection to check.
+ * @return true if no time is left in the current phase; false otherwise.
+ */
+bool is_time_to_change(const struct intersection *x)
+{
+    return LIGHT_DURATION(x->current) == 0;
+}
+
+/**
+ * @brief Transitions the traffic light to the next state.
+ *
+ * Follows the `next` field of the phase table (RED → GREEN → YELLOW → RED).
+ * Leaving a phase that serves pedestrians (RED) completes the pending
+ * request: the button flags are reset.
+ *
+ * @param x Intersection to transition.
+ */
+void change_state(struct intersection *x)
+{
+    light_state s = x->current;
+    const struct phase *phase = &x->phases[LIGHT_PHASE(s)];
+    if (phase->serves_pedestrians)
+    {
+        x->current = s & ~LIGHT_REQUESTS;
+    }
+    enter_phase(x, phase->next);
+}
+
+/**
+ * @brief Enters a phase: loads its duration and queues its outputs.
+ *
+ * The phase and its duration (stretched by demand, or fitted to the
+ * shared cycle) are stored together; the request and resting flags are
+ * kept. Entering a pedestrian phase completes the wait of the pending
+ * request.
+ *
+ * @param x Intersection entering the phase.
+ * @param state Phase to enter.
+ */
+void enter_phase(struct intersection *x, traffic_light_state state)
+{
+    uint64_t now = time_us_64();
+    // Nominal start: the deadline of the step that just ended
+    uint64_t start = x->step_deadline_us ? x->step_deadline_us : now;
+    update_demand(x, now);
+#if TRAFFIC_LIGHT_GREEN_WAVE
+    if (x->phases[state].rest_point)
+    {
+        // A GREEN reached through a coordinated cycle should start on the shared cycle start
+        if (x->wave_locked && wave.synced)
+            record_latency(STAT_WAVE_ALIGNMENT, green_wave_error_us(now));
+        x->wave_locked = wave.synced;
+    }
+#endif
+    x->current = LIGHT_STATE(state, phase_duration(x, state, start), x->current);
+    x->phase_end_us = start + LIGHT_DURATION(x->current) * 1000ull;
+    x->phase_start_us = now;
+
+    if (x->phases[state].serves_pedestrians)
+    {
+        x->pedestrian_phases++;
+        lifetime.cycles++;
+        if (x->request_us)
+            record_latency(STAT_PEDESTRIAN_WAIT, (uint32_t)now - x->request_us);
+        x->request_us = 0;
+    }
+    turn_on_signal(x);
+}
+
+/**
+ * @brief Computes the length of a phase for the current demand.
+ *
+ * In step with a green wave the cycle is fixed instead: the other phases
+ * keep their base length and the rest point (GREEN) lasts until the
+ * shared force-off point.
+ *
+ * @param x Intersection.
+ * @param state Phase.
+ * @param start_us Nominal start of the phase, in microseconds since boot.
+ * @return Phase length in milliseconds.
+ */
+uint32_t phase_duration(const struct intersection *x, traffic_light_state state, uint64_t start_us)
+{
+    const struct phase *phase = &x->phases[state];
+#if TRAFFIC_LIGHT_GREEN_WAVE
+    if (wave.synced)
+        return phase->rest_point ? green_wave_hold_ms(x, state, start_us) : phase->duration;
+#endif
+    if (!phase->max_duration)
+        return phase->duration;
+    return MIN(phase->duration + (uint64_t)x->demand * phase->stretch, phase->max_duration);
+}
+
+/**
+ * @brief Closes the demand window if it has ended.
+ *
+ * A window that ends after a whole window without any call leaves a
+ * demand of zero.
+ *
+ * @param x Intersection.
+ * @param now_us Current time, in microseconds since boot.
+ */
+void update_demand(struct intersection *x, uint64_t now_us)
+{
+    const uint64_t window_us = DEMAND_WINDOW_MS * 1000ull;
+    uint64_t elapsed = now_us - x->window_start_us;
+    if (elapsed < window_us)
+        return;
+    x->demand = elapsed < 2 * window_us ? x->window_requests : 0;
+    x->window_requests = 0;
+    x->window_start_us = now_us - elapsed % window_us;
+}
+
+/**
+ * @brief Time left in the current phase.
+ *
+ * @param x Intersection.
+ * @param now_us Current time, in microseconds since boot.
+ * @return Milliseconds until the phase ends; 0 when resting.
+ */
+uint32_t phase_remaining_ms(const struct intersection *x, uint64_t now_us)
+{
+    return x->phase_end_us > now_us ? (x->phase_end_us - now_us) / 1000 : 0;
+}
+
+/**
+ * @brief Registers a pedestrian request with the actuated controller.
+ *
+ * Called inside the control-side critical section. The request is
+ * counted for the demand window and:
+ * - merged, when a request is already pending or the pedestrians are
+ *   being served (the phase is running or already on its way);
+ * - otherwise it starts the locator tone and cuts a phase that has a
+ *   `min_duration` (GREEN) short, to whatever is left of that minimum but
+ *   no less than REQUEST_CLEARANCE_MS, and wakes a resting intersection.
+ *   A GREEN locked to a green wave is never cut; the request is served
+ *   at its force-off point.
+ *
+ * @param x Intersection.
+ * @param request LIGHT_REQUEST_A or LIGHT_REQUEST_B.
+ * @return true if the request changed the signal timing.
+ */
+bool request_crossing(struct intersection *x, light_state request)
+{
+    uint64_t now = time_us_64();
+    light_state s = x->current;
+    const struct phase *phase = &x->phases[LIGHT_PHASE(s)];
+
+    update_demand(x, now);
+    x->window_requests++;
+    x->requests++;
+    lifetime.presses++;
+    x->idle_cycles = 0;
+    x->current = s | request;
+
+    if ((s & LIGHT_REQUESTS) || phase->serves_pedestrians)
+    {
+        x->merged_requests++;
+        return false;
+    }
+    x->request_us = (uint32_t)now ? (uint32_t)now : 1;
+    buzzer_play(&locator_pattern, 0);
+    if (!phase->min_duration)
+        return false;
+#if TRAFFIC_LIGHT_GREEN_WAVE
+    if (x->wave_locked)
+        return false;
+#endif
+
+    uint64_t min_end_us = x->phase_start_us + phase->min_duration * 1000ull;
+    uint64_t end_us = MAX(min_end_us, now + REQUEST_CLEARANCE_MS * 1000ull);
+    uint32_t left_ms = (end_us - now) / 1000;
+    if (!(s & LIGHT_RESTING) && left_ms >= phase_remaining_ms(x, now))
+        return false;
+
+    x->current = LIGHT_STATE(LIGHT_PHASE(s), left_ms, (s | request) & ~LIGHT_RESTING);
+    x->phase_end_us = end_us;
+    start_step(x, now);
+    schedule_next_step();
+    return true;
+}
+
+#if TRAFFIC_LIGHT_NETWORK
+/**
+ * @brief Brings up the CYW43 radio and starts joining WIFI_SSID.
+ *
+ * Called once from main() after the controller is running. The
+ * connection is made in the background (and retried by
+ * network_link_up()), so boot never waits for the access point. lwIP
+ * then runs from the cyw43 async context in a low-priority interrupt:
+ * the scheduler alarm and the button handlers preempt it, so a Wi-Fi
+ * stall never delays the signals.
+ *
+ * @return false if the radio could not be initialized.
+ */
+bool init_network()
+{
+    if (cyw43_arch_init())
+    {
+        printf("Network: Wi-Fi init failed\n");
+        return false;
+    }
+    cyw43_arch_enable_sta_mode();
+    cyw43_arch_wifi_connect_async(WIFI_SSID, WIFI_PASSWORD, CYW43_AUTH_WPA2_AES_PSK);
+    network_ready = true;
+    return true;
+}
+
+/**
+ * @brief Checks the Wi-Fi link, starting a new join if it was lost.
+ *
+ * Called from the periodic network workers; a failed join is retried at
+ * most every NETWORK_RETRY_MS.
+ *
+ * @return true if the link is up with an IP address.
+ */
+bool network_link_up()
+{
+    int link = cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA);
+    uint64_t now = time_us_64();
+    if ((link < 0 || link == CYW43_LINK_DOWN) && now >= network_retry_us)
+    {
+        cyw43_arch_wifi_connect_async(WIFI_SSID, WIFI_PASSWORD, CYW43_AUTH_WPA2_AES_PSK);
+        network_retry_us = now + NETWORK_RETRY_MS * 1000ull;
+    }
+    return link == CYW43_LINK_UP;
+}
+#endif
+
+#if TRAFFIC_LIGHT_GREEN_WAVE
+/**
+ * @brief Length of a coordinated rest-point phase.
+ *
+ * The phases after the rest point (YELLOW and the walk phase) keep their
+ * base length, so the rest point must end that long before the next
+ * shared cycle start: its force-off point. A phase that would end
+ * sooner than its `min_duration` is held one more cycle, which also
+ * covers the first cycle after the wave is joined.
+ *
+ * @param x Intersection.
+ * @param state Rest-point phase.
+ * @param start_us Nominal start of the phase, in microseconds since boot (local clock).
+ * @return Phase length in milliseconds.
+ */
+uint32_t green_wave_hold_ms(const struct intersection *x, traffic_light_state state, uint64_t start_us)
+{
+    const struct phase *table = x->phases;
+    const uint64_t cycle_us = GREEN_WAVE_CYCLE_MS * 1000ull;
+
+    uint64_t tail_us = 0;
+    for (traffic_light_state s = table[state].next; s != state; s = table[s].next)
+        tail_us += table[s].duration * 1000ull;
+
+    uint64_t force_off_us = (wave.offset_ms * 1000ull + cycle_us - tail_us % cycle_us) % cycle_us;
+    uint64_t position_us = (start_us + wave.clock_offset_us) % cycle_us;
+    uint64_t hold_us = (force_off_us + cycle_us - position_us) % cycle_us;
+    if (hold_us < table[state].min_duration * 1000ull)
+        hold_us += cycle_us;
+    return (hold_us + 500) / 1000;
+}
+
+/**
+ * @brief Distance of an instant from the shared cycle start.
+ *
+ * @param now_us Local time, in microseconds since boot.
+ * @return Microseconds to the nearest start of this controller's cycle.
+ */
+uint32_t green_wave_error_us(uint64_t now_us)
+{
+    const uint64_t cycle_us = GREEN_WAVE_CYCLE_MS * 1000ull;
+    uint64_t position_us = (now_us + wave.clock_offset_us + cycle_us - wave.offset_ms * 1000ull) % cycle_us;
+    return MIN(position_us, cycle_us - position_us);
+}
+
+/**
+ * @brief Opens the time-sync socket and starts the sync worker.
+ *
+ * Called once from main() after init_network(); the signals keep their
+ * free timing until the first valid exchange. The master is in step by
+ * definition.
+ */
+void init_green_wave()
+{
+    const struct phase *table = intersections[0].phases;
+    uint32_t tail_ms = 0;
+    for (traffic_light_state s = table[GREEN].next; s != GREEN; s = table[s].next)
+        tail_ms += table[s].duration;
+    if (GREEN_WAVE_CYCLE_MS < tail_ms + table[GREEN].min_duration)
+        printf("Green wave: cycle %u ms is shorter than one minimum cycle (%lu ms)\n",
+               GREEN_WAVE_CYCLE_MS, (unsigned long)(tail_ms + table[GREEN].min_duration));
+
+    if (!network_ready)
+    {
+        printf("Green wave: no network, running free\n");
+        return;
+    }
+
+    wave.is_master = GREEN_WAVE_MASTER[0] == '\0';
+    if (!wave.is_master && !ipaddr_aton(GREEN_WAVE_MASTER, &wave.master))
+    {
+        printf("Green wave: bad master address %s, running free\n", GREEN_WAVE_MASTER);
+        return;
+    }
+
+    cyw43_arch_lwip_begin();
+    wave.pcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+    if (wave.pcb && udp_bind(wave.pcb, IP_ANY_TYPE, GREEN_WAVE_PORT) == ERR_OK)
+        udp_recv(wave.pcb, green_wave_recv, NULL);
+    cyw43_arch_lwip_end();
+    if (!wave.pcb)
+    {
+        printf("Green wave: no UDP socket, running free\n");
+        return;
+    }
+
+    if (wave.is_master)
+    {
+        uint32_t irq_status = control_enter();
+        wave.clock_offset_us = 0;
+        wave.synced = true;
+        control_exit(irq_status);
+    }
+    wave.worker.do_work = green_wave_sync;
+    async_context_add_at_time_worker_in_ms(cyw43_arch_async_context(), &wave.worker, GREEN_WAVE_SYNC_MS);
+    printf("Green wave: %s, cycle %u ms, offset %lu ms\n", wave.is_master ? "master" : GREEN_WAVE_MASTER,
+           GREEN_WAVE_CYCLE_MS, (unsigned long)wave.offset_ms);
+}
+
+/**
+ * @brief Periodic worker: times one exchange with the master.
+ *
+ * Runs in the cyw43 async context every GREEN_WAVE_SYNC_MS. A follower
+ * that has had no valid exchange for GREEN_WAVE_HOLDOVER_MS leaves the
+ * wave; its next GREEN is timed freely again.
+ *
+ * @param context cyw43 async context.
+ * @param worker This worker, re-armed for the next period.
+ */
+void green_wave_sync(async_context_t *context, async_at_time_worker_t *worker)
+{
+    async_context_add_at_time_worker_in_ms(context, worker, GREEN_WAVE_SYNC_MS);
+
+    bool link_up = network_link_up();
+    if (wave.is_master)
+        return;
+
+    if (wave.synced && time_us_64() - wave.last_sync_us > GREEN_WAVE_HOLDOVER_MS * 1000ull)
+    {
+        uint32_t irq_status = control_enter();
+        wave.synced = false;
+        control_exit(irq_status);
+    }
+    if (!link_up)
+        return;
+
+    struct green_wave_packet request = {.magic = GREEN_WAVE_MAGIC, .seq = ++wave.seq};
+    request.t1 = wave.request_us = time_us_64();
+    green_wave_send(&request, &wave.master, GREEN_WAVE_PORT);
+}
+
+/**
+ * @brief Sends one sync packet.
+ *
+ * @param packet Packet to send.
+ * @param addr Destination address.
+ * @param port Destination UDP port.
+ */
+void green_wave_send(const struct green_wave_packet *packet, const ip_addr_t *addr, u16_t port)
+{
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, sizeof(*packet), PBUF_RAM);
+    if (!p)
+        return;
+    memcpy(p->payload, packet, sizeof(*packet));
+    udp_sendto(wave.pcb, p, addr, port);
+    pbuf_free(p);
+}
+
+/**
+ * @brief Receives sync packets.
+ *
+ * The receive time is taken first, before any parsing. The master
+ * answers requests with its receive and send times; a follower feeds
+ * replies to its offset filter.
+ *
+ * @param arg Unused.
+ * @param pcb Socket.
+ * @param p Received datagram.
+ * @param addr Sender address.
+ * @param port Sender port.
+ */
+void green_wave_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+    uint64_t rx_us = time_us_64();
+    struct green_wave_packet packet;
+    bool valid = p->tot_len == sizeof(packet) && pbuf_copy_partial(p, &packet, sizeof(packet), 0) == sizeof(packet) &&
+                 packet.magic == GREEN_WAVE_MAGIC;
+    pbuf_free(p);
+
+    if (!valid)
+    {
+        wave.rejected++;
+        return;
+    }
+    if (wave.is_master)
+    {
+        if (packet.t2 == 0)
+        {
+            packet.t2 = rx_us;
+            packet.t3 = time_us_64();
+            green_wave_send(&packet, addr, port);
+        }
+        return;
+    }
+    green_wave_add_sample(&packet, rx_us);
+}
+
+/**
+ * @brief Adds one timed exchange and updates the shared time base.
+ *
+ * Queueing in the radio and the network stack only ever adds delay, so
+ * the exchange with the shortest round trip has the smallest error; the
+ * offset is taken from the fastest of the last GREEN_WAVE_SAMPLES.
+ *
+ * @param packet Reply from the master.
+ * @param t4 Local time the reply was received.
+ */
+void green_wave_add_sample(const struct green_wave_packet *packet, uint64_t t4)
+{
+    if (packet->seq != wave.seq || packet->t1 != wave.request_us || !packet->t2)
+    {
+        wave.rejected++;
+        return;
+    }
+    int64_t rtt_us = (int64_t)(t4 - packet->t1) - (int64_t)(packet->t3 - packet->t2);
+    if (rtt_us < 0 || rtt_us > GREEN_WAVE_MAX_RTT_US)
+    {
+        wave.rejected++;
+        return;
+    }
+
+    wave.samples[wave.next_sample] = (struct green_wave_sample){
+        .offset_us = ((int64_t)(packet->t2 - packet->t1) + (int64_t)(packet->t3 - t4)) / 2,
+        .rtt_us = (uint32_t)rtt_us,
+    };
+    wave.next_sample = (wave.next_sample + 1) % GREEN_WAVE_SAMPLES;
+    if (wave.sample_count < GREEN_WAVE_SAMPLES)
+        wave.sample_count++;
+    wave.exchanges++;
+
+    const struct green_wave_sample *best = &wave.samples[0];
+    for (uint i = 1; i < wave.sample_count; i++)
+        if (wave.samples[i].rtt_us < best->rtt_us)
+            best = &wave.samples[i];
+
+    uint32_t irq_status = control_enter();
+    wave.clock_offset_us = best->offset_us;
+    wave.rtt_us = best->rtt_us;
+    wave.last_sync_us = t4;
+    wave.synced = true;
+    control_exit(irq_status);
+}
+
+/**
+ * @brief Prints the green-wave state for the "wave" console command.
+ */
+void print_green_wave()
+{
+    uint64_t now = time_us_64();
+    printf("Green wave: %s, %s, cycle %u ms, offset %lu ms\n", wave.is_master ? "master" : GREEN_WAVE_MASTER,
+           wave.synced ? "in step" : "free", GREEN_WAVE_CYCLE_MS, (unsigned long)wave.offset_ms);
+    if (!wave.is_master)
+        printf("clock offset %lld us, error <= %lu us, last exchange %llu ms ago, %lu exchanges, %lu rejected\n",
+               (long long)wave.clock_offset_us, (unsigned long)(wave.rtt_us / 2),
+               (unsigned long long)(wave.last_sync_us ? (now - wave.last_sync_us) / 1000 : 0),
+               (unsigned long)wave.exchanges, (unsigned long)wave.rejected);
+    if (wave.synced)
+        printf("cycle position %lu ms\n",
+               (unsigned long)(((now + wave.clock_offset_us) % (GREEN_WAVE_CYCLE_MS * 1000ull)) / 1000));
+}
+#endif
+
+#if TRAFFIC_LIGHT_TELEMETRY
+#define ROTL64(x, b) (((x) << (b)) | ((x) >> (64 - (b))))
+
+/**
+ * @brief One SipHash round over the state words.
+ */
+void sipround(uint64_t v[4])
+{
+    v[0] += v[1];
+    v[1] = ROTL64(v[1], 13) ^ v[0];
+    v[0] = ROTL64(v[0], 32);
+    v[2] += v[3];
+    v[3] = ROTL64(v[3], 16) ^ v[2];
+    v[0] += v[3];
+    v[3] = ROTL64(v[3], 21) ^ v[0];
+    v[2] += v[1];
+    v[1] = ROTL64(v[1], 17) ^ v[2];
+    v[2] = ROTL64(v[2], 32);
+}
+
+/**
+ * @brief SipHash-2-4 message authentication code.
+ *
+ * A keyed 64-bit MAC that costs a few microseconds for a command on the
+ * Cortex-M0+, with no tables and no dynamic memory.
+ *
+ * @param key 128-bit key, as two little-endian words.
+ * @param data Message.
+ * @param len Message length in bytes.
+ * @return MAC of the message.
+ */
+uint64_t siphash24(const uint64_t key[2], const uint8_t *data, size_t len)
+{
+    uint64_t v[4] = {key[0] ^ 0x736f6d6570736575ull, key[1] ^ 0x646f72616e646f6dull,
+                     key[0] ^ 0x6c7967656e657261ull, key[1] ^ 0x7465646279746573ull};
+    size_t whole = len & ~(size_t)7;
+
+    for (size_t i = 0; i < whole; i += 8)
+    {
+        uint64_t m;
+        memcpy(&m, data + i, sizeof(m));
+        v[3] ^= m;
+        sipround(v);
+        sipround(v);
+        v[0] ^= m;
+    }
+
+    uint64_t last = (uint64_t)len << 56;
+    for (size_t i = whole; i < len; i++)
+        last |= (uint64_t)data[i] << (8 * (i - whole));
+    v[3] ^= last;
+    sipround(v);
+    sipround(v);
+    v[0] ^= last;
+
+    v[2] ^= 0xff;
+    for (uint i = 0; i < 4; i++)
+        sipround(v);
+    return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+/**
+ * @brief Opens the telemetry socket and starts the stream worker.
+ *
+ * Called once from main() after init_network(). Draws the session
+ * number, parses TELEMETRY_KEY and copies nothing: the stream reads the
+ * event ring in place.
+ */
+void init_telemetry()
+{
+    if (!network_ready)
+    {
+        printf("Telemetry: no network\n");
+        return;
+    }
+
+    telemetry.session = get_rand_32();
+    telemetry.streaming = TELEMETRY_HOST[0] != '\0' && ipaddr_aton(TELEMETRY_HOST, &telemetry.host);
+
+    // 32 hex digits, most significant nibble of each byte first
+    telemetry.keyed = strlen(TELEMETRY_KEY) == 32;
+    for (uint i = 0; telemetry.keyed && i < 32; i++)
+    {
+        char c = TELEMETRY_KEY[i] | 0x20;
+        uint nibble = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : 16;
+        telemetry.keyed = nibble < 16;
+        telemetry.key[i / 16] |= (uint64_t)(nibble & 0xF) << (8 * ((i % 16) / 2) + (i % 2 ? 0 : 4));
+    }
+
+    cyw43_arch_lwip_begin();
+    telemetry.pcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+    if (telemetry.pcb && udp_bind(telemetry.pcb, IP_ANY_TYPE, TELEMETRY_PORT) == ERR_OK)
+        udp_recv(telemetry.pcb, telemetry_recv, NULL);
+    cyw43_arch_lwip_end();
+    if (!telemetry.pcb)
+    {
+        printf("Telemetry: no UDP socket\n");
+        return;
+    }
+
+    telemetry.stats_due_us = time_us_64() + TELEMETRY_STATS_MS * 1000ull;
+    telemetry.worker.do_work = telemetry_work;
+    async_context_add_at_time_worker_in_ms(cyw43_arch_async_context(), &telemetry.worker, TELEMETRY_PERIOD_MS);
+    print_telemetry();
+}
+
+/**
+ * @brief Periodic worker: streams new events and, when due, the counters.
+ *
+ * Runs in the cyw43 async context every TELEMETRY_PERIOD_MS. While the
+ * link is down nothing is sent; events the ring overwrites meanwhile are
+ * counted as lost.
+ *
+ * @param context cyw43 async context.
+ * @param worker This worker, re-armed for the next period.
+ */
+void telemetry_work(async_context_t *context, async_at_time_worker_t *worker)
+{
+    async_context_add_at_time_worker_in_ms(context, worker, TELEMETRY_PERIOD_MS);
+    if (!network_link_up() || !telemetry.streaming)
+        return;
+
+    telemetry_send_events();
+    if (time_us_64() >= telemetry.stats_due_us)
+    {
+        telemetry_send_stats();
+        telemetry.stats_due_us += TELEMETRY_STATS_MS * 1000ull;
+    }
+}
+
+/**
+ * @brief Streams the event records posted since the last period.
+ *
+ * The stream is a second, lossy reader of event_queue with its own tail:
+ * it never holds the producer back, so post_event() and the local
+ * consumer behave exactly as without telemetry. Each datagram body is a
+ * PBUF_REF pointing straight at a contiguous run of ring slots; the
+ * records are copied once, by the radio driver, onto the bus.
+ *
+ * A slot the producer reuses before or while it is sent is counted as
+ * lost; a record overwritten during the send arrives with a later `seq`
+ * the collector can tell apart.
+ */
+void telemetry_send_events()
+{
+    uint32_t head = event_head;
+    __dmb();
+
+    if (head - telemetry.tail > EVENT_QUEUE_SIZE)
+    {
+        telemetry.events_lost += head - telemetry.tail - EVENT_QUEUE_SIZE;
+        telemetry.tail = head - EVENT_QUEUE_SIZE;
+    }
+
+    while (telemetry.tail != head)
+    {
+        uint32_t start = telemetry.tail;
+        uint index = start & (EVENT_QUEUE_SIZE - 1);
+        uint count = MIN(MIN(head - start, EVENT_QUEUE_SIZE - index), TELEMETRY_BATCH);
+
+        struct pbuf *body = pbuf_alloc(PBUF_RAW, count * sizeof(struct light_event), PBUF_REF);
+        if (!body)
+            return;
+        body->payload = &event_queue[index];
+        if (!telemetry_send(TELEMETRY_EVENTS, count, body, &telemetry.host, TELEMETRY_PORT))
+            return;
+        telemetry.tail = start + count;
+
+        uint32_t reused = event_head - start;
+        if (reused > EVENT_QUEUE_SIZE)
+            telemetry.events_lost += MIN(reused - EVENT_QUEUE_SIZE, count);
+    }
+}
+
+/**
+ * @brief Sends the global counters and every latency histogram.
+ *
+ * Histograms are copied without locking, like print_latency_stats().
+ */
+void telemetry_send_stats()
+{
+    size_t size = sizeof(struct telemetry_counters) + STAT_COUNT * sizeof(struct telemetry_stat);
+    struct pbuf *body = pbuf_alloc(PBUF_RAW, size, PBUF_RAM);
+    if (!body)
+        return;
+
+    struct telemetry_counters *counters = body->payload;
+    *counters = (struct telemetry_counters){
+        .uptime_ms = to_ms_since_boot(get_absolute_time()),
+        .events_dropped = events_dropped,
+        .events_lost = telemetry.events_lost,
+        .commands_refused = telemetry.commands_refused,
+    };
+    struct telemetry_stat *stats = (struct telemetry_stat *)(counters + 1);
+    for (uint i = 0; i < STAT_COUNT; i++)
+    {
+        stats[i].count = latency_stats[i].count;
+        stats[i].min = latency_stats[i].min;
+        stats[i].max = latency_stats[i].max;
+        memcpy(stats[i].buckets, latency_stats[i].buckets, sizeof(stats[i].buckets));
+    }
+    telemetry_send(TELEMETRY_STATS, STAT_COUNT, body, &telemetry.host, TELEMETRY_PORT);
+}
+
+/**
+ * @brief Prepends a header to a datagram body and sends it.
+ *
+ * @param type Datagram type.
+ * @param count Records in the body.
+ * @param body Datagram body; owned by this function, freed in every case.
+ * @param addr Destination address.
+ * @param port Destination UDP port.
+ * @return true if lwIP accepted the datagram.
+ */
+bool telemetry_send(telemetry_type type, uint count, struct pbuf *body, const ip_addr_t *addr, u16_t port)
+{
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, sizeof(struct telemetry_header), PBUF_RAM);
+    if (!p)
+    {
+        pbuf_free(body);
+        return false;
+    }
+    *(struct telemetry_header *)p->payload = (struct telemetry_header){
+        .magic = TELEMETRY_MAGIC,
+        .version = TELEMETRY_VERSION,
+        .type = type,
+        .count = count,
+        .session = telemetry.session,
+        .seq = telemetry.seq,
+    };
+    pbuf_cat(p, body);
+
+    bool sent = udp_sendto(telemetry.pcb, p, addr, port) == ERR_OK;
+    pbuf_free(p);
+    if (sent)
+    {
+        telemetry.seq++;
+        telemetry.datagrams++;
+    }
+    return sent;
+}
+
+/**
+ * @brief Receives command datagrams and acknowledges them.
+ *
+ * Datagrams that are not commands at all are dropped silently and do
+ * not count as refused commands; every command gets a TELEMETRY_ACK
+ * with its outcome.
+ *
+ * @param arg Unused.
+ * @param pcb Socket.
+ * @param p Received datagram.
+ * @param addr Sender address.
+ * @param port Sender port.
+ */
+void telemetry_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+    struct telemetry_command command;
+    bool whole = p->tot_len == sizeof(command) && pbuf_copy_partial(p, &command, sizeof(command), 0) == sizeof(command);
+    pbuf_free(p);
+    if (!whole || command.magic != TELEMETRY_MAGIC || command.version != TELEMETRY_VERSION)
+        return;
+
+    command_status status = run_remote_command(&command);
+    if (status == COMMAND_OK)
+        telemetry.commands++;
+    else
+        telemetry.commands_refused++;
+
+    struct pbuf *body = pbuf_alloc(PBUF_RAW, sizeof(struct telemetry_ack), PBUF_RAM);
+    if (!body)
+        return;
+    *(struct telemetry_ack *)body->payload = (struct telemetry_ack){
+        .counter = command.counter,
+        .opcode = command.opcode,
+        .status = status,
+    };
+    telemetry_send(TELEMETRY_ACK, 1, body, addr, port);
+}
+
+/**
+ * @brief Authenticates and runs one command.
+ *
+ * The MAC is checked first (in constant time), then the session and the
+ * replay counter; only then are the values looked at. A new phase
+ * timing is validated against the packed state limits and the phase's
+ * countdown, and written inside the control-side critical section so
+ * the scheduler never sees half of it.
+ *
+ * @param command Command received.
+ * @return Outcome for the acknowledgement.
+ */
+command_status run_remote_command(const struct telemetry_command *command)
+{
+    if (!telemetry.keyed)
+        return COMMAND_DISABLED;
+
+    uint64_t mac = siphash24(telemetry.key, (const uint8_t *)command, offsetof(struct telemetry_command, mac));
+    uint8_t diff = 0;
+    for (uint i = 0; i < sizeof(command->mac); i++)
+        diff |= command->mac[i] ^ (uint8_t)(mac >> (8 * i));
+    if (diff || command->session != telemetry.session)
+        return COMMAND_BAD_MAC;
+    if (command->counter <= telemetry.last_counter)
+        return COMMAND_REPLAY;
+    telemetry.last_counter = command->counter;
+
+    switch (command->opcode)
+    {
+    case COMMAND_SET_PHASE:
+    {
+        if (command->intersection >= INTERSECTION_COUNT || command->phase >= PHASE_COUNT)
+            return COMMAND_INVALID;
+        struct phase *phase = &phase_tables[command->intersection][command->phase];
+        if (!phase_timing_valid(phase, &command->timing))
+            return COMMAND_INVALID;
+
+        set_phase_timing(phase, &command->timing);
+#if TRAFFIC_LIGHT_PERSIST
+        persist_mark(PERSIST_PHASES + command->intersection);
+#endif
+        return COMMAND_OK;
+    }
+    case COMMAND_RESET_STATS:
+        reset_latency_stats();
+        return COMMAND_OK;
+    default:
+        return COMMAND_INVALID;
+    }
+}
+
+/**
+ * @brief Prints the telemetry state for the "telemetry" console command.
+ */
+void print_telemetry()
+{
+    printf("Telemetry: %s:%u, session %08lx, commands %s\n", telemetry.streaming ? TELEMETRY_HOST : "no collector",
+           TELEMETRY_PORT, (unsigned long)telemetry.session, telemetry.keyed ? "enabled" : "disabled");
+    printf("%lu datagrams, %lu events lost, %lu commands run, %lu refused\n", (unsigned long)telemetry.datagrams,
+           (unsigned long)telemetry.events_lost, (unsigned long)telemetry.commands,
+           (unsigned long)telemetry.commands_refused);
+}
+#endif
+
+#if TRAFFIC_LIGHT_RUNTIME_PHASES
+/**
+ * @brief Checks a new timing for a phase.
+ *
+ * Every length must fit in the packed state word, the countdown must fit
+ * in the phase, the minimum may not exceed the base length and the
+ * maximum, when set, may not be shorter than it.
+ *
+ * @param phase Phase the timing is meant for.
+ * @param timing Proposed timing.
+ * @return true if the timing can be applied.
+ */
+bool phase_timing_valid(const struct phase *phase, const struct phase_timing *timing)
+{
+    return timing->duration && timing->duration <= LIGHT_DURATION_MASK &&
+           timing->duration >= phase->countdown_from && timing->min_duration <= timing->duration &&
+           (!timing->max_duration ||
+            (timing->max_duration >= timing->duration && timing->max_duration <= LIGHT_DURATION_MASK));
+}
+
+/**
+ * @brief Replaces the timing of a phase, from the next time it is entered.
+ *
+ * Written inside the control-side critical section, so the scheduler
+ * never sees half of it.
+ *
+ * @param phase Phase in one of the phase_tables.
+ * @param timing Timing checked with phase_timing_valid().
+ */
+void set_phase_timing(struct phase *phase, const struct phase_timing *timing)
+{
+    uint32_t irq_status = control_enter();
+    phase->duration = timing->duration;
+    phase->min_duration = timing->min_duration;
+    phase->max_duration = timing->max_duration;
+    phase->stretch = timing->stretch;
+    control_exit(irq_status);
+}
+#endif
+
+#if TRAFFIC_LIGHT_PERSIST
+/**
+ * @brief CRC-32 (IEEE 802.3), four bits at a time.
+ *
+ * @param data Bytes to add.
+ * @param len Number of bytes.
+ * @param crc CRC of the preceding bytes, 0 to start.
+ * @return CRC of everything so far.
+ */
+uint32_t crc32(const void *data, size_t len, uint32_t crc)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    const uint8_t *bytes = data;
+
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = (crc >> 4) ^ table[(crc ^ bytes[i]) & 0xF];
+        crc = (crc >> 4) ^ table[(crc ^ (bytes[i] >> 4)) & 0xF];
+    }
+    return ~crc;
+}
+
+/**
+ * @brief Checks whether a flash range reads as erased.
+ *
+ * @param offset Offset from the start of flash, word-aligned.
+ * @param len Bytes to check, a multiple of 4.
+ * @return true if every byte is 0xFF.
+ */
+bool flash_blank(uint32_t offset, size_t len)
+{
+    const uint32_t *words = (const uint32_t *)(XIP_BASE + offset);
+    for (size_t i = 0; i < len / 4; i++)
+        if (words[i] != 0xFFFFFFFF)
+            return false;
+    return true;
+}
+
+/**
+ * @brief Restores the configuration and the lifetime counters from flash.
+ *
+ * Called from setup() after the phase tables are copied to RAM and before
+ * the first phase is entered. Counts the boot; the first counter record
+ * is written as soon as persist_service() finds a window.
+ */
+void init_persist()
+{
+    persist_load_config();
+    persist_load_counters();
+    lifetime.boots++;
+    persist.log_due_us = 0;
+}
+
+/**
+ * @brief Finds the newest record of every key and applies it.
+ *
+ * The active sector is the one holding the newest record overall, and
+ * appending resumes after its last page that is not blank. Values whose
+ * newest record is in another sector are marked dirty, so they move to
+ * the active sector before that sector is erased.
+ */
+void persist_load_config()
+{
+    const struct kv_header *latest[PERSIST_KEY_COUNT] = {NULL};
+    uint next_page[PERSIST_KV_SECTORS] = {0};
+
+    for (uint sector = 0; sector < PERSIST_KV_SECTORS; sector++)
+    {
+        for (uint page = 0; page < KV_PAGES_PER_SECTOR; page++)
+        {
+            uint32_t offset = PERSIST_BASE + sector * FLASH_SECTOR_SIZE + page * FLASH_PAGE_SIZE;
+            const struct kv_header *header = (const struct kv_header *)(XIP_BASE + offset);
+            if (!flash_blank(offset, FLASH_PAGE_SIZE))
+                next_page[sector] = page + 1;
+            if (header->magic != KV_MAGIC || header->key >= PERSIST_KEY_COUNT || header->length > KV_VALUE_MAX ||
+                crc32(header + 1, header->length, crc32(header, offsetof(struct kv_header, crc), 0)) != header->crc)
+                continue;
+
+            if (!latest[header->key] || header->seq > latest[header->key]->seq)
+                latest[header->key] = header;
+            if (header->seq > persist.kv_seq)
+            {
+                persist.kv_seq = header->seq;
+                persist.kv_sector = sector;
+            }
+        }
+    }
+    persist.kv_next_page = next_page[persist.kv_sector];
+
+    for (uint key = 0; key < PERSIST_KEY_COUNT; key++)
+    {
+        const struct kv_header *header = latest[key];
+        if (!header || !persist_decode(key, (const uint8_t *)(header + 1), header->length))
+            continue;
+        uint sector = ((uintptr_t)header - XIP_BASE - PERSIST_BASE) / FLASH_SECTOR_SIZE;
+        if (sector != persist.kv_sector)
+            persist.dirty |= 1u << key;
+    }
+}
+
+/**
+ * @brief Restores the lifetime counters from the newest valid log record.
+ */
+void persist_load_counters()
+{
+    const struct counter_record *records = (const struct counter_record *)(XIP_BASE + PERSIST_LOG_BASE);
+    const struct counter_record *last = NULL;
+
+    for (uint slot = 0; slot < LOG_SLOTS; slot++)
+    {
+        const struct counter_record *record = &records[slot];
+        if (record->magic != LOG_MAGIC || crc32(record, offsetof(struct counter_record, crc), 0) != record->crc)
+            continue;
+        if (!last || record->seq > last->seq)
+        {
+            last = record;
+            persist.log_next = (slot + 1) % LOG_SLOTS;
+        }
+    }
+    if (last)
+    {
+        lifetime = last->counters;
+        persist.logged = last->counters;
+        persist.log_seq = last->seq;
+    }
+}
+
+/**
+ * @brief Schedules a key for writing after its value changed.
+ *
+ * Safe from any context. Changes that follow within
+ * PERSIST_CONFIG_DELAY_MS are written together.
+ *
+ * @param key Key whose value changed.
+ */
+void persist_mark(persist_key key)
+{
+    uint32_t irq_status = control_enter();
+    if (!persist.dirty)
+        persist.config_due_us = time_us_64() + PERSIST_CONFIG_DELAY_MS * 1000ull;
+    persist.dirty |= 1u << key;
+    control_exit(irq_status);
+}
+
+/**
+ * @brief Serializes the current value of a key.
+ *
+ * Called inside the control-side critical section.
+ *
+ * @param key Key to serialize.
+ * @param value Buffer of KV_VALUE_MAX bytes.
+ * @return Value length, or 0 if the key has nothing to store in this build.
+ */
+uint persist_encode(persist_key key, uint8_t *value)
+{
+    switch (key)
+    {
+    case PERSIST_I2C_RATE:
+        value[0] = (uint8_t)i2c_rate_limit;
+        return 1;
+    case PERSIST_WAVE_OFFSET:
+#if TRAFFIC_LIGHT_GREEN_WAVE
+        memcpy(value, &wave.offset_ms, sizeof(wave.offset_ms));
+        return sizeof(wave.offset_ms);
+#else
+        return 0;
+#endif
+    default:
+    {
+        const struct phase *phases = phase_tables[key - PERSIST_PHASES];
+        for (uint i = 0; i < PHASE_COUNT; i++)
+        {
+            struct phase_timing timing = {phases[i].duration, phases[i].min_duration, phases[i].max_duration,
+                                          phases[i].stretch};
+            memcpy(value + i * sizeof(timing), &timing, sizeof(timing));
+        }
+        return PHASE_COUNT * sizeof(struct phase_timing);
+    }
+    }
+}
+
+/**
+ * @brief Checks a stored value and applies it.
+ *
+ * A value that does not fit this build (an older layout, or a table the
+ * firmware would not accept) is ignored, leaving the built-in default.
+ *
+ * @param key Key the value belongs to.
+ * @param value Stored bytes.
+ * @param length Stored length.
+ * @return true if the value was applied.
+ */
+bool persist_decode(persist_key key, const uint8_t *value, uint length)
+{
+    switch (key)
+    {
+    case PERSIST_I2C_RATE:
+        if (length != 1 || value[0] >= count_of(i2c_rates))
+            return false;
+        i2c_rate_limit = value[0];
+        return true;
+    case PERSIST_WAVE_OFFSET:
+    {
+#if TRAFFIC_LIGHT_GREEN_WAVE
+        uint32_t offset_ms;
+        if (length != sizeof(offset_ms))
+            return false;
+        memcpy(&offset_ms, value, sizeof(offset_ms));
+        if (offset_ms >= GREEN_WAVE_CYCLE_MS)
+            return false;
+        wave.offset_ms = offset_ms;
+        return true;
+#else
+        return false;
+#endif
+    }
+    default:
+    {
+        struct phase *phases = phase_tables[key - PERSIST_PHASES];
+        struct phase_timing timings[PHASE_COUNT];
+        if (length != sizeof(timings))
+            return false;
+        memcpy(timings, value, sizeof(timings));
+        for (uint i = 0; i < PHASE_COUNT; i++)
+            if (!phase_timing_valid(&phases[i], &timings[i]))
+                return false;
+        for (uint i = 0; i < PHASE_COUNT; i++)
+            set_phase_timing(&phases[i], &timings[i]);
+        return true;
+    }
+    }
+}
+
+/**
+ * @brief Writes pending configuration and counter records, one flash operation at a time.
+ *
+ * Called from the core 0 main loop. Never blocks waiting for a window:
+ * an operation that does not fit before the next deadline is retried on
+ * a later pass.
+ */
+void persist_service()
+{
+    uint64_t now = time_us_64();
+    if (persist.dirty && now >= persist.config_due_us && persist_write_config())
+        return;
+    if (now >= persist.log_due_us)
+        persist_write_counters();
+}
+
+/**
+ * @brief Appends the record of one dirty key, or moves to a fresh sector.
+ *
+ * When the active sector is full the next one is erased and becomes
+ * active, and every key is marked dirty to be rewritten there.
+ *
+ * @return true if this pass used (or tried to use) the flash.
+ */
+bool persist_write_config()
+{
+    if (persist.kv_next_page == KV_PAGES_PER_SECTOR)
+    {
+        uint sector = (persist.kv_sector + 1) % PERSIST_KV_SECTORS;
+        uint32_t offset = PERSIST_BASE + sector * FLASH_SECTOR_SIZE;
+        if (!flash_blank(offset, FLASH_SECTOR_SIZE) && !persist_flash_op(offset, NULL))
+            return true;
+        persist.kv_sector = sector;
+        persist.kv_next_page = 0;
+        uint32_t irq_status = control_enter();
+        persist.dirty = (1u << PERSIST_KEY_COUNT) - 1;
+        control_exit(irq_status);
+        return true;
+    }
+
+    uint8_t page[FLASH_PAGE_SIZE];
+    for (uint key = 0; key < PERSIST_KEY_COUNT; key++)
+    {
+        if (!(persist.dirty & (1u << key)))
+            continue;
+
+        // Cleared before the value is read, so a change made meanwhile marks it again
+        struct kv_header header = {.magic = KV_MAGIC, .seq = persist.kv_seq + 1, .key = key};
+        memset(page, 0xFF, sizeof(page));
+        uint32_t irq_status = control_enter();
+        persist.dirty &= ~(1u << key);
+        header.length = persist_encode(key, page + sizeof(header));
+        control_exit(irq_status);
+        if (!header.length)
+            continue;
+
+        header.crc = crc32(page + sizeof(header), header.length, crc32(&header, offsetof(struct kv_header, crc), 0));
+        memcpy(page, &header, sizeof(header));
+        uint32_t offset = PERSIST_BASE + persist.kv_sector * FLASH_SECTOR_SIZE + persist.kv_next_page * FLASH_PAGE_SIZE;
+        if (!persist_flash_op(offset, page))
+        {
+            irq_status = control_enter();
+            persist.dirty |= 1u << key;
+            control_exit(irq_status);
+            return true;
+        }
+        persist.kv_seq = header.seq;
+        persist.kv_next_page++;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Appends a counter record if the counters changed since the last one.
+ *
+ * Erases a log sector first when the log wraps into it; slots that are
+ * not blank (a record torn by a reset) are skipped.
+ */
+void persist_write_counters()
+{
+    uint64_t now = time_us_64();
+    uint32_t irq_status = control_enter();
+    struct lifetime_counters counters = lifetime;
+    control_exit(irq_status);
+
+    if (memcmp(&counters, &persist.logged, sizeof(counters)) == 0)
+    {
+        persist.log_due_us = now + PERSIST_LOG_INTERVAL_MS * 1000ull;
+        return;
+    }
+
+    uint slot = persist.log_next;
+    uint32_t offset = PERSIST_LOG_BASE + slot * sizeof(struct counter_record);
+    if (slot % LOG_RECORDS_PER_SECTOR == 0 && !flash_blank(offset, FLASH_SECTOR_SIZE))
+    {
+        persist_flash_op(offset, NULL);
+        return;
+    }
+    if (!flash_blank(offset, sizeof(struct counter_record)))
+    {
+        persist.log_next = (slot + 1) % LOG_SLOTS;
+        return;
+    }
+
+    struct counter_record record = {
+        .magic = LOG_MAGIC,
+        .seq = persist.log_seq + 1,
+        .counters = counters,
+        .reserved = 0xFFFFFFFF,
+    };
+    record.crc = crc32(&record, offsetof(struct counter_record, crc), 0);
+
+    // Bytes left at 0xFF leave the other records of the page as they are
+    uint8_t page[FLASH_PAGE_SIZE];
+    uint32_t page_offset = offset & ~(FLASH_PAGE_SIZE - 1);
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page + (offset - page_offset), &record, sizeof(record));
+    if (!persist_flash_op(page_offset, page))
+        return;
+
+    persist.log_seq = record.seq;
+    persist.logged = counters;
+    persist.log_next = (slot + 1) % LOG_SLOTS;
+    persist.log_due_us = now + PERSIST_LOG_INTERVAL_MS * 1000ull;
+}
+
+/**
+ * @brief Checks that nothing on the control side is due for a while.
+ *
+ * Called with interrupts masked. The window is shut while a step
+ * deadline or a buzzer step falls inside it, or while a display update
+ * is on the bus (its transfer would stall and time out).
+ *
+ * @param need_us Worst-case length of the flash operation.
+ * @return true if the operation can run now without delaying anything.
+ */
+bool persist_window_open(uint32_t need_us)
+{
+    uint64_t until = time_us_64() + need_us;
+    if (ssd1306_update_busy() || (buzzer.alarm > 0 && buzzer.step_end_us < until))
+        return false;
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+    {
+        uint64_t deadline = intersections[i].step_deadline_us;
+        if (deadline && deadline < until)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Erases a sector or programs a page, if it fits before the next deadline.
+ *
+ * XIP is unavailable while the flash is busy, so every interrupt is
+ * masked for the whole operation and, in dual-core mode, core 1 is
+ * parked in RAM by the multicore lockout. The window is checked after
+ * both, so nothing can be scheduled into it in between.
+ *
+ * @param offset Offset from the start of flash, sector- or page-aligned.
+ * @param page Page to program, or NULL to erase the sector.
+ * @return true if the operation ran; false if it was deferred.
+ */
+bool persist_flash_op(uint32_t offset, const uint8_t *page)
+{
+    uint32_t need_us = page ? PERSIST_PROGRAM_WINDOW_US : PERSIST_ERASE_WINDOW_US;
+    uint32_t irq_status = control_enter();
+    bool open = persist_window_open(need_us);
+    control_exit(irq_status);
+    if (!open)
+    {
+        persist.deferred++;
+        return false;
+    }
+
+#if TRAFFIC_LIGHT_DUAL_CORE
+    multicore_lockout_start_blocking();
+#endif
+    irq_status = control_enter();
+    open = persist_window_open(need_us);
+    if (open && page)
+        flash_range_program(offset, page, FLASH_PAGE_SIZE);
+    else if (open)
+        flash_range_erase(offset, FLASH_SECTOR_SIZE);
+    control_exit(irq_status);
+#if TRAFFIC_LIGHT_DUAL_CORE
+    multicore_lockout_end_blocking();
+#endif
+
+    if (!open)
+        persist.deferred++;
+    else if (page)
+        persist.programs++;
+    else
+        persist.erases++;
+    return open;
+}
+#endif
+
+/**
+ * @brief Prints the lifetime counters and the store for the "flash" console command.
+ */
+void print_persist()
+{
+    printf("Lifetime: %lu boots, %lu presses, %lu pedestrian phases, %lu faults\n", (unsigned long)lifetime.boots,
+           (unsigned long)lifetime.presses, (unsigned long)lifetime.cycles, (unsigned long)lifetime.faults);
+#if TRAFFIC_LIGHT_PERSIST
+    printf("Flash: config sector %u, %u/%u pages, seq %lu, %s; log slot %u/%u, seq %lu\n", persist.kv_sector,
+           persist.kv_next_page, KV_PAGES_PER_SECTOR, (unsigned long)persist.kv_seq,
+           persist.dirty ? "changes pending" : "clean", persist.log_next, (uint)LOG_SLOTS,
+           (unsigned long)persist.log_seq);
+    printf("%lu sector erases, %lu page programs, %lu deferred\n", (unsigned long)persist.erases,
+           (unsigned long)persist.programs, (unsigned long)persist.deferred);
+#else
+    printf("Flash: not kept in this build (TRAFFIC_LIGHT_PERSIST)\n");
+#endif
+}
+
+#if TRAFFIC_LIGHT_WATCHDOG
+/**
+ * @brief Reads the state saved before a watchdog reset.
+ *
+ * Called first thing after init_signals(). A power-on reset leaves the
+ * scratch registers without the magic, so the boot is a normal one. A
+ * reset by the watchdog timer counts as a fault; one requested through
+ * the watchdog (a reboot) does not, but resumes the same way.
+ */
+void check_watchdog_reboot()
+{
+    uint32_t tag = watchdog_hw->scratch[0];
+    if (!watchdog_caused_reboot() || (tag & ~0xFFu) != WATCHDOG_MAGIC)
+        return;
+
+    monitor.faults = (tag & 0xFF) + (watchdog_enable_caused_reboot() ? 1 : 0);
+    if (monitor.faults >= WATCHDOG_MAX_FAULTS)
+    {
+        monitor.safe_mode = true;
+        return;
+    }
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+    {
+        light_state saved = watchdog_hw->scratch[1 + i];
+        if (LIGHT_PHASE(saved) >= PHASE_COUNT || !LIGHT_DURATION(saved))
+            return;
+    }
+    monitor.resumed = true;
+    quick_start = true;
+}
+
+/**
+ * @brief Re-enters the saved phase of every intersection with its remaining time.
  *
- * This section contains the configuration parameters and pin definitions
- * related to the OLED display communication using the I2C protocol.
+ * Called by setup() instead of entering RED. Pending pedestrian requests
+ * are kept; the phase ends when it would have, give or take the time
+ * between the last feed and the reset.
  */
-
-#define I2C_PORT i2c1
-#define I2C_SDA 14
-#define I2C_SCL 15
+void resume_saved_phases()
+{
+    uint64_t now = time_us_64();
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+    {
+        struct intersection *x = &intersections[i];
+        light_state saved = watchdog_hw->scratch[1 + i];
+        x->current = saved;
+        x->phase_end_us = now + LIGHT_DURATION(saved) * 1000ull;
+        x->phase_start_us = now;
+        if (saved & LIGHT_REQUESTS)
+            x->request_us = (uint32_t)now ? (uint32_t)now : 1;
+        turn_on_signal(x);
+    }
+}
 
 /**
- * @enum traffic_light_state
- * @brief Possible states of the traffic light.
+ * @brief Starts the watchdog and the heartbeat that wakes the main loop to feed it.
  *
- * Represents the colors of a traffic light in traffic control.
+ * Called just before the main loop, once the blocking start-up work is
+ * done. The watchdog pauses while a debugger halts the cores.
  */
-typedef enum
+void init_watchdog()
 {
-    RED,
-    YELLOW,
-    GREEN
-} traffic_light_state;
+    monitor.last_tail = event_tail;
+    monitor.consumer_us = time_us_64();
+    save_watchdog_state(monitor.consumer_us);
+    watchdog_enable(WATCHDOG_TIMEOUT_MS, true);
+    monitor.heartbeat = add_alarm_in_ms(WATCHDOG_CHECK_MS, watchdog_heartbeat, NULL, true);
+}
 
-struct light_state
+/**
+ * @brief Heartbeat alarm: its only job is to end the WFI of the main loop.
+ */
+int64_t watchdog_heartbeat(alarm_id_t id, void *user_data)
 {
-    traffic_light_state state;
-    uint32_t duration;
-};
+    return WATCHDOG_CHECK_MS * 1000ll;
+}
 
 /**
- * @brief Current traffic light state and its duration.
+ * @brief Feeds the watchdog if both pipelines are making progress.
  *
- * This variable holds the current state of the traffic light along with
- * the time it should remain in this state. Declared volatile because it may
- * be modified by interrupt service routines or other concurrent contexts.
+ * Called from the core 0 main loop. The control side is healthy while
+ * no step deadline is more than WATCHDOG_STALL_MS overdue; the display
+ * side while the event queue keeps draining and no display transfer has
+ * been on the bus for that long. A hang in either stops the feeding, and
+ * the watchdog resets the board.
  */
-volatile struct light_state current = {RED, 10000};
+void service_watchdog()
+{
+    uint64_t now = time_us_64();
+    uint32_t tail = event_tail;
+    if (tail != monitor.last_tail || event_queue_empty())
+    {
+        monitor.last_tail = tail;
+        monitor.consumer_us = now;
+    }
+    bool ok = now - monitor.consumer_us < WATCHDOG_STALL_MS * 1000ull &&
+              !(ssd1306_update_busy() && time_us_32() - display_flush_start_us > WATCHDOG_STALL_MS * 1000u);
+
+    uint32_t irq_status = control_enter();
+    for (uint i = 0; i < INTERSECTION_COUNT && ok; i++)
+    {
+        uint64_t deadline = intersections[i].step_deadline_us;
+        ok = !deadline || now < deadline + WATCHDOG_STALL_MS * 1000ull;
+    }
+    if (ok)
+    {
+        if (monitor.faults && now >= WATCHDOG_STABLE_MS * 1000ull)
+            monitor.faults = 0;
+        save_watchdog_state(now);
+        watchdog_update();
+    }
+    control_exit(irq_status);
+}
 
 /**
- * @brief Flag indicating if button A has been pressed.
+ * @brief Saves the fault count and every intersection's phase and remaining time.
  *
- * Set to true by an interrupt or event handler when button A is pressed.
- * Declared volatile because it can be modified asynchronously.
+ * Called inside the control-side critical section (or before the
+ * scheduler runs), so the states are consistent with each other.
+ *
+ * @param now_us Current time.
  */
-volatile bool button_A_pressed = false;
+void save_watchdog_state(uint64_t now_us)
+{
+    watchdog_hw->scratch[0] = WATCHDOG_MAGIC | MIN(monitor.faults, 0xFFu);
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+    {
+        const struct intersection *x = &intersections[i];
+        uint32_t remaining = phase_remaining_ms(x, now_us);
+        watchdog_hw->scratch[1 + i] = LIGHT_STATE(LIGHT_PHASE(x->current), remaining ? remaining : 1, x->current);
+    }
+}
 
 /**
- * @brief Flag indicating if button B has been pressed.
+ * @brief Enters flashing-red safe mode.
  *
- * Set to true by an interrupt or event handler when button B is pressed.
- * Declared volatile because it can be modified asynchronously.
+ * Used instead of setup() after WATCHDOG_MAX_FAULTS watchdog resets in a
+ * row. Only the signal GPIOs and one alarm are used: every green is off
+ * and every red flashes, the display and buttons are left alone. The
+ * alarm also feeds the watchdog. The mode lasts until the board is reset
+ * from its RUN pin or power-cycled, which clears the scratch registers.
  */
-volatile bool button_B_pressed = false;
-
-// Function prototypes
-
-void turn_on_red_signal();
-void turn_on_yellow_signal();
-void turn_on_green_signal();
-void setup();
-void button_interrupt_handler(uint gpio, uint32_t events);
-void change_state();
-void pwm_init_buzzer(uint pin);
-void beep(uint pin, uint32_t duration_ms);
-int64_t beep_stop_callback(alarm_id_t id, void *user_data);
-bool state_controller();
-bool is_time_to_change();
-void init_display();
-void update_display();
-char *get_state_string();
+void start_safe_mode()
+{
+    stdio_init_all();
+    printf("Safe mode: %lu watchdog resets in a row, flashing red\n", (unsigned long)monitor.faults);
+    watchdog_hw->scratch[0] = WATCHDOG_MAGIC | MIN(monitor.faults, 0xFFu);
+    watchdog_enable(WATCHDOG_TIMEOUT_MS, true);
+    add_alarm_in_ms(SAFE_MODE_FLASH_MS, safe_mode_flash, NULL, true);
+}
 
-int some_button_pressed();
+/**
+ * @brief Safe mode alarm: toggles every red signal and feeds the watchdog.
+ */
+int64_t safe_mode_flash(alarm_id_t id, void *user_data)
+{
+    monitor.lamps_on = !monitor.lamps_on;
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+    {
+        const struct intersection_config *config = &intersection_configs[i];
+        uint32_t mask = (1u << config->green_led) | (1u << config->red_led);
+        pending_signal_mask |= mask;
+        pending_signal_value = (pending_signal_value & ~mask) | (monitor.lamps_on ? 1u << config->red_led : 0);
+    }
+    flush_signals();
+    watchdog_update();
+    return SAFE_MODE_FLASH_MS * 1000ll;
+}
+#endif
 
 /**
- * @brief Returns a string representing the current traffic light state or pedestrian instruction.
+ * @brief GPIO interrupt handler for pedestrian buttons without a PIO debouncer.
  *
- * The returned string depends on button presses and the current traffic light state:
- * - If either button A or B is pressed and the light is RED, returns "Walk!".
- * - If either button A or B is pressed but the light is not RED, returns "Wait".
- * - Otherwise, returns the current traffic light color as a string: "RED", "YELLOW", or "GREEN".
+ * Fallback used only when no PIO state machine was available for a
+ * button. Triggered on every raw falling edge.
  *
- * @return Pointer to a string literal representing the current state or pedestrian instruction.
+ * @param gpio The GPIO pin that triggered the interrupt.
+ * @param events Bitmask of GPIO interrupt events (e.g., falling edge).
  */
-char* get_state_string(){
-    if ((some_button_pressed()) && current.state == RED)
-        return "Walk!";
-    if (some_button_pressed()) return "Wait";
-    if (current.state == RED) return "RED";
-    if (current.state == YELLOW) return "YELLOW";
-    if (current.state == GREEN) return "GREEN";
+void button_interrupt_handler(uint gpio, uint32_t events)
+{
+    uint32_t irq_us = time_us_32();
+    if (events & GPIO_IRQ_EDGE_FALL)
+        handle_button_press(gpio, irq_us);
 }
 
 /**
- * @brief Checks if any pedestrian button is pressed.
- *
- * Returns a non-zero value if either button A or button B is currently pressed.
+ * @brief PIO interrupt handler for debounced button presses.
  *
- * @return int Non-zero if any button is pressed; zero otherwise.
+ * Raised when a debounce state machine pushes a clean press into its RX
+ * FIFO, so a bouncing switch produces a single interrupt. Runs at the
+ * default IRQ priority like the scheduler alarm.
  */
-int some_button_pressed()
+void button_pio_irq_handler()
 {
-    return button_A_pressed || button_B_pressed;
+    uint32_t irq_us = time_us_32();
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+    {
+        for (uint b = 0; b < 2; b++)
+        {
+            int sm = button_sms[i][b];
+            if (sm < 0)
+                continue;
+            while (!pio_sm_is_rx_fifo_empty(BUTTON_PIO, sm))
+            {
+                pio_sm_get(BUTTON_PIO, sm);
+                handle_button_press(b ? intersection_configs[i].button_b : intersection_configs[i].button_a, irq_us);
+            }
+        }
+    }
 }
 
 /**
- * @brief Initializes the OLED display and I2C interface.
+ * @brief Handles a pedestrian button press.
  *
- * Sets up the I2C peripheral with 400 kHz frequency,
- * configures SDA and SCL pins for I2C functionality with pull-ups,
- * and initializes the SSD1306 OLED display.
+ * Looks up the intersection owning the button and, inside the
+ * control-side critical section:
+ * - Registers the request of that button with request_crossing().
+ * - Records the button handling latency and, if the timing changed,
+ *   remembers the press for the button-to-light measurement.
+ * - Posts a button event so the main loop reports which button was pressed.
  *
- * Clears the display buffer and updates the display to show a blank screen.
+ * @param gpio The GPIO of the pressed button.
+ * @param irq_us time_us_32() at entry of the interrupt handler.
  */
-void init_display()
+void handle_button_press(uint gpio, uint32_t irq_us)
 {
-    // Inicializa o I2C com frequência de 400kHz
-    i2c_init(I2C_PORT, 400000);
-    gpio_set_function(I2C_SDA, GPIO_FUNC_I2C);
-    gpio_set_function(I2C_SCL, GPIO_FUNC_I2C);
-    gpio_pull_up(I2C_SDA);
-    gpio_pull_up(I2C_SCL);
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+    {
+        struct intersection *x = &intersections[i];
+        if (gpio != x->config->button_a && gpio != x->config->button_b)
+            continue;
 
-    // Inicializa o display OLED
-    ssd1306_init(I2C_PORT);
-    ssd1306_clear();
-    ssd1306_update(I2C_PORT);
+        uint32_t irq_status = control_enter();
+        if (request_crossing(x, gpio == x->config->button_a ? LIGHT_REQUEST_A : LIGHT_REQUEST_B))
+            x->press_us = irq_us ? irq_us : 1;
+        record_latency(STAT_BUTTON_HANDLER, time_us_32() - irq_us);
+        post_event(EVENT_BUTTON, x, gpio);
+        control_exit(irq_status);
+        return;
+    }
 }
 
 /**
- * @brief Updates the OLED display with current traffic light information.
+ * @brief Queues the signal outputs of an intersection's current phase.
  *
- * Displays the system title, current traffic light state, and additional messages
- * based on state and button interaction:
- * - If in RED state with ≤ 5 seconds remaining and a button is pressed, shows a countdown.
- * - If a button is pressed in other states, shows "Button Pressed!".
- * - Otherwise, shows "Waiting for button...".
+ * Maps the phase's logical outputs to the intersection's LED pins. The
+ * GPIOs are written by flush_signals(), so all heads that change in the
+ * same scheduler pass switch together. Also posts a signal event so the
+ * main loop prints a status message.
+ *
+ * @param x Intersection whose outputs are queued.
  */
-void update_display()
+void turn_on_signal(struct intersection *x)
 {
-    char temp_str[32];
-    char state_str[32];
-    char countdown_str[32];
+    const struct intersection_config *config = x->config;
+    uint32_t outputs = x->phases[LIGHT_PHASE(x->current)].outputs;
+    uint32_t mask = (1u << config->green_led) | (1u << config->red_led);
+    uint32_t value = ((outputs & OUTPUT_GREEN) ? 1u << config->green_led : 0) |
+                     ((outputs & OUTPUT_RED) ? 1u << config->red_led : 0);
 
-    ssd1306_clear();
+    pending_signal_mask |= mask;
+    pending_signal_value = (pending_signal_value & ~mask) | value;
+    if (x->press_us)
+    {
+        x->light_press_us = x->press_us;
+        x->press_us = 0;
+    }
+    post_event(EVENT_SIGNAL, x, 0);
+}
+
+/**
+ * @brief Applies every queued signal output in one write.
+ *
+ * With the PIO signal state machine the whole LED window is pushed to its
+ * FIFO as one word; otherwise a single gpio_put_masked() is used. A write
+ * that answers a button press completes its button-to-light measurement.
+ */
+void flush_signals()
+{
+    if (!pending_signal_mask)
+        return;
 
-    snprintf(temp_str, sizeof(temp_str), "Traffic Light System");
-    ssd1306_draw_string(0, 0, temp_str, true);
+    signal_levels = (signal_levels & ~pending_signal_mask) | pending_signal_value;
+    if (signal_sm >= 0)
+        pio_sm_put(SIGNAL_PIO, signal_sm, signal_levels >> SIGNAL_PIN_BASE);
+    else
+        gpio_put_masked(pending_signal_mask, pending_signal_value);
 
-    snprintf(state_str, sizeof(state_str), "Current State: %s", get_state_string());
-    ssd1306_draw_string(0, 16, state_str, true);
+    pending_signal_mask = 0;
+    pending_signal_value = 0;
 
-    if (current.state == RED && current.duration <= 5000 && (some_button_pressed()))
+    uint32_t now = time_us_32();
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
     {
-        snprintf(countdown_str, sizeof(countdown_str), "Countdown: %d s", current.duration / 1000);
-        ssd1306_draw_string(0, 32, countdown_str, true);
+        if (intersections[i].light_press_us)
+        {
+            record_latency(STAT_BUTTON_TO_LIGHT, now - intersections[i].light_press_us);
+            intersections[i].light_press_us = 0;
+        }
     }
-    else if ((some_button_pressed()))
+}
+
+/**
+ * @brief Loads the PIO programs and starts their state machines.
+ *
+ * - One debounce state machine per pedestrian button on BUTTON_PIO, with
+ *   the RX-not-empty interrupt routed to button_pio_irq_handler(). Buttons
+ *   left without a state machine use the GPIO edge IRQ instead.
+ * - One signal output state machine on SIGNAL_PIO, if every signal LED
+ *   lies inside the SIGNAL_PIN_BASE window.
+ */
+void init_pio()
+{
+    uint debounce_offset = pio_add_program(BUTTON_PIO, &button_debounce_program);
+    float clkdiv = button_debounce_clkdiv(clock_get_hz(clk_sys), DEBOUNCE_MS);
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
     {
-        snprintf(countdown_str, sizeof(countdown_str), "Button Pressed!");
-        ssd1306_draw_string(0, 32, countdown_str, true);
+        for (uint b = 0; b < 2; b++)
+        {
+            uint pin = b ? intersection_configs[i].button_b : intersection_configs[i].button_a;
+            int sm = pio_claim_unused_sm(BUTTON_PIO, false);
+            button_sms[i][b] = sm;
+            if (sm < 0)
+                continue;
+            button_debounce_program_init(BUTTON_PIO, sm, debounce_offset, pin, clkdiv);
+            pio_set_irq0_source_enabled(BUTTON_PIO, pis_sm0_rx_fifo_not_empty + sm, true);
+        }
     }
-    else
+    irq_set_exclusive_handler(PIO0_IRQ_0, button_pio_irq_handler);
+    irq_set_enabled(PIO0_IRQ_0, true);
+
+    uint32_t window = ((1u << SIGNAL_PIN_COUNT) - 1) << SIGNAL_PIN_BASE;
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
     {
-        snprintf(countdown_str, sizeof(countdown_str), "Waiting for button...");
-        ssd1306_draw_string(0, 32, countdown_str, true);
+        uint32_t leds = (1u << intersection_configs[i].green_led) | (1u << intersection_configs[i].red_led);
+        if (leds & ~window)
+            return;
     }
-    ssd1306_update(I2C_PORT);
+    signal_sm = pio_claim_unused_sm(SIGNAL_PIO, false);
+    if (signal_sm >= 0)
+        signal_output_program_init(SIGNAL_PIO, signal_sm, pio_add_program(SIGNAL_PIO, &signal_output_program),
+                                   SIGNAL_PIN_BASE, SIGNAL_PIN_COUNT, signal_levels >> SIGNAL_PIN_BASE);
 }
 
 /**
- * @brief Callback function to stop the buzzer sound.
+ * @brief Recomputes the debounce clock divider for the current clk_sys.
  *
- * This function is called when a timer/alarm expires.
- * It stops the PWM signal on the specified GPIO pin, effectively silencing the buzzer.
+ * The PIO state machines are clocked from clk_sys, so the debounce time
+ * would scale with it otherwise.
+ */
+void update_debounce_clock()
+{
+    float clkdiv = button_debounce_clkdiv(clock_get_hz(clk_sys), DEBOUNCE_MS);
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+        for (uint b = 0; b < 2; b++)
+            if (button_sms[i][b] >= 0)
+                pio_sm_set_clkdiv(BUTTON_PIO, button_sms[i][b], clkdiv);
+}
+
+/**
+ * @brief Lights the fail-safe red on every head.
  *
- * @param id The alarm identifier (unused in this function).
- * @param user_data Pointer to the GPIO pin number (cast from void*).
- * @return Always returns 0 to indicate that the alarm should not be repeated.
+ * The very first thing main() does, so that after a power-up, brownout
+ * or watchdog reset no head is dark while the rest of the system comes
+ * up. All red LEDs come on in one gpio_put_masked() write and the
+ * instant is recorded in boot_red_us.
  */
-int64_t beep_stop_callback(alarm_id_t id, void *user_data)
+void init_signals()
 {
-    uint pin = (uintptr_t)user_data;
-    pwm_set_gpio_level(pin, 0);
-    return 0;
+    uint32_t mask = 0;
+    uint32_t value = 0;
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+    {
+        const struct intersection_config *config = &intersection_configs[i];
+        mask |= (1u << config->green_led) | (1u << config->red_led);
+        value |= 1u << config->red_led;
+    }
+
+    gpio_init_mask(mask);
+    gpio_put_masked(mask, value);
+    gpio_set_dir_out_masked(mask);
+    signal_levels = value;
+    boot_red_us = time_us_64();
 }
 
 /**
- * @brief Activates the buzzer for a specified duration.
+ * @brief Prints how long the boot took.
  *
- * Starts a PWM signal on the given GPIO pin with a 50% duty cycle to produce a beep.
- * Schedules a timer to stop the beep after the specified duration.
+ * Reported once the display is up, so that boot time regressions can be
+ * tracked from the serial log.
+ */
+void report_boot_time()
+{
+    printf("Boot: red signals at %llu us, display at %llu us\n",
+           (unsigned long long)boot_red_us, (unsigned long long)boot_display_us);
+#if TRAFFIC_LIGHT_WATCHDOG
+    if (monitor.resumed)
+        printf("Boot: resumed mid-cycle after a watchdog reset (%lu in a row)\n", (unsigned long)monitor.faults);
+#endif
+}
+
+/**
+ * @brief Initializes hardware peripherals and prepares the system.
  *
- * @param pin GPIO pin connected to the buzzer.
- * @param duration_ms Duration of the beep in milliseconds.
+ * - Initializes standard I/O (on core 1 instead in dual-core mode).
+ * - Configures the pedestrian buttons A and B of every intersection as inputs with pull-up resistors
+ *   (the LEDs are already showing red, see init_signals()).
+ * - Starts the PIO button debouncers and signal output.
+ * - Initializes PWM for the buzzer.
+ * - Waits 2 seconds before starting, unless fast boot is enabled or the
+ *   controller is resuming after a watchdog reset.
+ * - Prints a startup message.
+ * - Enters the RED phase initially on every intersection, or the phases
+ *   saved before a watchdog reset.
  */
-void beep(uint pin, uint32_t duration_ms)
+void setup()
 {
-    // Liga o buzzer com duty cycle de 50%
-    pwm_set_gpio_level(pin, 2048);
+#if !TRAFFIC_LIGHT_DUAL_CORE
+    stdio_init_all();
+    stdio_set_chars_available_callback(console_chars_available, NULL);
+#endif
+
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+    {
+        const struct intersection_config *config = &intersection_configs[i];
+        intersections[i].config = config;
+#if TRAFFIC_LIGHT_RUNTIME_PHASES
+        memcpy(phase_tables[i], config->phases, sizeof(phase_tables[i]));
+        intersections[i].phases = phase_tables[i];
+#else
+        intersections[i].phases = config->phases;
+#endif
+
+        gpio_init(config->button_a);
+        gpio_set_dir(config->button_a, GPIO_IN);
+        gpio_pull_up(config->button_a);
 
-    // Passa o pino como ponteiro para desligar depois
-    add_alarm_in_ms(duration_ms, beep_stop_callback, (void *)(uintptr_t)pin, false);
+        gpio_init(config->button_b);
+        gpio_set_dir(config->button_b, GPIO_IN);
+        gpio_pull_up(config->button_b);
+    }
+
+#if TRAFFIC_LIGHT_PERSIST
+    init_persist();
+#endif
+
+    init_pio();
+    pwm_init_buzzer(BUZZER);
+    if (!quick_start)
+        sleep_ms(2000);
+    printf("Traffic Light System\n");
+#if TRAFFIC_LIGHT_WATCHDOG
+    if (monitor.resumed)
+        resume_saved_phases();
+    else
+#endif
+        for (uint i = 0; i < INTERSECTION_COUNT; i++)
+            enter_phase(&intersections[i], RED);
+    flush_signals();
 }
 
 /**
- * @brief Initializes the PWM configuration for the buzzer.
+ * @brief Posts an event to the event queue.
  *
- * Configures the specified GPIO pin for PWM output and sets the frequency
- * for buzzer operation. Initially sets the duty cycle to 0 (silent).
+ * Called from interrupt context after a state change, inside the
+ * control-side critical section (which keeps the queue single-producer).
+ * Publishes the new state for the renderer, fills a timestamped log
+ * record and makes it visible with a release fence. Never blocks and
+ * never formats text: the cost is a fixed few dozen cycles. If the queue
+ * is full the event is dropped and counted.
  *
- * The PWM frequency is calculated using the system clock, target buzzer frequency,
- * and a resolution of 12 bits (4096 steps).
+ * @param type Kind of event.
+ * @param x Intersection the event refers to.
+ * @param gpio GPIO that triggered the event (button events), 0 otherwise.
+ * @return true if the event was queued; false if it was dropped.
+ */
+bool post_event(light_event_type type, const struct intersection *x, uint gpio)
+{
+    publish_snapshot(x);
+
+    uint16_t seq = event_seq++;
+    uint32_t head = event_head;
+    if (head - event_tail == EVENT_QUEUE_SIZE)
+    {
+        events_dropped++;
+        lifetime.faults++;
+        return false;
+    }
+
+    light_state s = x->current;
+    struct light_event *event = &event_queue[head & (EVENT_QUEUE_SIZE - 1)];
+    event->time_us = time_us_32();
+    event->duration = LIGHT_DURATION(s);
+    event->seq = seq;
+    event->type = type;
+    event->intersection = x - intersections;
+    event->gpio = gpio;
+    event->state = LIGHT_PHASE(s);
+    event->flags = ((s & LIGHT_REQUESTS) ? EVENT_FLAG_PEDESTRIAN : 0) |
+                   ((s & LIGHT_RESTING) ? EVENT_FLAG_RESTING : 0);
+
+    __mem_fence_release();
+    event_head = head + 1;
+
+    // Wake the consumer if it is sleeping in WFE on core 1
+    __sev();
+    return true;
+}
+
+/**
+ * @brief Checks whether the event queue has no pending events.
  *
- * @param pin GPIO pin connected to the buzzer.
+ * @return true if the queue is empty.
  */
-void pwm_init_buzzer(uint pin)
+bool event_queue_empty()
 {
-    gpio_set_function(pin, GPIO_FUNC_PWM);
-    uint slice_num = pwm_gpio_to_slice_num(pin);
-    pwm_config config = pwm_get_default_config();
-    pwm_config_set_clkdiv(&config, clock_get_hz(clk_sys) / (BUZZER_FREQ * 4096));
-    pwm_init(slice_num, &config, true);
-    pwm_set_gpio_level(pin, 0);
+    return event_tail == event_head;
 }
 
 /**
- * @brief Manages traffic light state transitions and display updates.
+ * @brief Removes the oldest event from the event queue.
  *
- * This function is called periodically (e.g., every 1 second) to:
- * - Decrease the remaining time for the current state.
- * - Update the OLED display.
- * - If in RED state and 5 seconds or less remain, and a button is pressed:
- *   - Print the remaining time.
- *   - Trigger a 5-second beep when the countdown reaches exactly 5 seconds.
- * - If the state duration reaches zero, transition to the next state.
+ * Called only from the main loop.
  *
- * @return true Always returns true to indicate successful execution.
+ * @param event Destination for the event.
+ * @return true if an event was returned; false if the queue was empty.
  */
-bool state_controller()
+bool pop_event(struct light_event *event)
 {
-    current.duration -= 1000;
-    update_display();
-    if (current.state == RED && current.duration <= 5000 && (some_button_pressed()))
-        printf("Duration: %d seconds\n", current.duration / 1000);
+    uint32_t tail = event_tail;
+    if (tail == event_head)
+        return false;
 
-    if ((some_button_pressed()) && current.state == RED && current.duration == 5000)
-    {
-        beep(BUZZER, 5000);
-    }
-    if (is_time_to_change())
-        change_state();
+    __mem_fence_acquire();
+    *event = event_queue[tail & (EVENT_QUEUE_SIZE - 1)];
+    __mem_fence_release();
+    event_tail = tail + 1;
     return true;
 }
 
 /**
- * @brief Checks if the traffic light should transition to the next state.
+ * @brief Writes one event record to stdio as a binary frame.
  *
- * Determines whether the current state's remaining duration has elapsed.
+ * Each frame is EVENT_LOG_SYNC followed by the 16 bytes of the record,
+ * written with putchar_raw() so that no newline translation happens.
  *
- * @return true if the current duration is less than or equal to 0; false otherwise.
+ * @param event Record to ship.
  */
-bool is_time_to_change()
+void write_raw_event(const struct light_event *event)
 {
-    return current.duration <= 0;
+    const uint8_t *bytes = (const uint8_t *)event;
+    putchar_raw(EVENT_LOG_SYNC);
+    for (uint i = 0; i < sizeof(*event); i++)
+        putchar_raw(bytes[i]);
 }
 
 /**
- * @brief Transitions the traffic light to the next state.
+ * @brief Prints one event record as text.
  *
- * Updates the current state and its corresponding duration:
- * - RED → GREEN: resets button flags, activates green signal, sets duration to 10 seconds.
- * - GREEN → YELLOW: activates yellow signal, sets duration to 3 seconds.
- * - YELLOW → RED: activates red signal, sets duration to 10 seconds.
+ * Produces the messages that used to be printed from interrupt context,
+ * prefixed with the event timestamp.
  *
- * This function also updates hardware outputs via signal control functions.
+ * @param event Record to format.
  */
-void change_state()
+void print_event(const struct light_event *event)
 {
-    switch (current.state)
+    const struct phase *phase = &intersections[event->intersection].phases[event->state];
+    bool pedestrian = event->flags & EVENT_FLAG_PEDESTRIAN;
+
+    switch (event->type)
     {
-    case RED:
-        button_A_pressed = false;
-        button_B_pressed = false;
-        turn_on_green_signal();
-        current.state = GREEN;
-        current.duration = 10000;
+    case EVENT_TICK:
+        if (!(pedestrian && phase->countdown_from && event->duration <= phase->countdown_from))
+            return;
+        printf("%10lu ", (unsigned long)event->time_us);
+        print_intersection(event->intersection);
+        printf("Duration: %d seconds\n", event->duration / 1000);
         break;
-    case GREEN:
-        turn_on_yellow_signal();
-        current.state = YELLOW;
-        current.duration = 3000;
+    case EVENT_SIGNAL:
+        printf("%10lu ", (unsigned long)event->time_us);
+        print_intersection(event->intersection);
+        printf("Signal: %s!\n", phase->signal_name);
         break;
-    case YELLOW:
-        turn_on_red_signal();
-        current.state = RED;
-        current.duration = 10000;
+    case EVENT_BUTTON:
+        printf("%10lu ", (unsigned long)event->time_us);
+        print_intersection(event->intersection);
+        printf("Pedestrian button %c activated!\n",
+               event->gpio == intersection_configs[event->intersection].button_a ? 'A' : 'B');
         break;
     }
 }
 
 /**
- * @brief GPIO interrupt handler for pedestrian button presses.
+ * @brief Drains the event queue, performing logging and display work.
  *
- * Triggered on a falling edge (button press). When activated:
- * - Prints which button was pressed (A or B).
- * - Forces the traffic light to GREEN state.
- * - Sets the remaining duration to 1 second.
- * - Sets button_A_pressed to true (regardless of which button was pressed).
- *
- * @note The current implementation always sets the state to GREEN and
- *       only sets button_A_pressed = true, even for button B.
- *       Consider updating to distinguish between buttons A and B.
- *
- * @param gpio The GPIO pin that triggered the interrupt.
- * @param events Bitmask of GPIO interrupt events (e.g., falling edge).
+ * Formats every record (or ships it raw with TRAFFIC_LIGHT_RAW_LOG) and
+ * redraws the display once after the queue is empty, no matter how many
+ * events requested a refresh. With TRAFFIC_LIGHT_DASHBOARD, button
+ * presses also go to the history and the progress bar alarm requests
+ * a redraw on its own.
  */
-void button_interrupt_handler(uint gpio, uint32_t events)
+void process_events()
 {
-    if (events & GPIO_IRQ_EDGE_FALL)
+    struct light_event event;
+    bool redraw = false;
+
+    while (pop_event(&event))
+    {
+        if (TRAFFIC_LIGHT_RAW_LOG)
+            write_raw_event(&event);
+        else
+            print_event(&event);
+        if (event.type != EVENT_SIGNAL)
+            redraw = true;
+#if TRAFFIC_LIGHT_DASHBOARD
+        if (event.type == EVENT_BUTTON)
+            dashboard_log_event(&event);
+#endif
+    }
+    if (display_refresh_due)
+    {
+        display_refresh_due = false;
+        redraw = true;
+    }
+
+    if (redraw)
     {
-        printf("Pedestrian button %c activated!\n", gpio == BUTTON_A ? 'A' : 'B');
-        current.duration = 1000;
-        current.state = GREEN;
-        button_A_pressed = true;
+        struct light_snapshot snapshots[INTERSECTION_COUNT];
+        uint32_t start = time_us_32();
+        read_snapshots(snapshots);
+#if TRAFFIC_LIGHT_DASHBOARD
+        update_dashboard(snapshots);
+#elif TRAFFIC_LIGHT_LARGE_DISPLAY
+        update_large_display(snapshots);
+#else
+        update_display(snapshots);
+#endif
+        record_latency(STAT_DISPLAY_RENDER, time_us_32() - start);
     }
 }
 
 /**
- * @brief Turns on the green traffic light signal.
+ * @brief Prefixes a log line with the intersection number.
  *
- * Sets the green LED GPIO high and the red LED GPIO low.
- * Useful when transitioning to the GREEN state in the traffic light system.
+ * Prints nothing when the board drives a single intersection, so the
+ * console output is unchanged in that case.
  *
- * Also prints a status message to the console.
+ * @param index Intersection index.
  */
-void turn_on_green_signal()
+void print_intersection(uint index)
 {
-    gpio_put(GREEN_LED, 1);
-    gpio_put(RED_LED, 0);
-    printf("Signal: Green!\n");
+    if (INTERSECTION_COUNT > 1)
+        printf("[%u] ", index + 1);
 }
 
 /**
- * @brief Turns on the red traffic light signal.
+ * @brief Copies the state of an intersection into a snapshot.
  *
- * Sets the red LED GPIO high and the green LED GPIO low.
- * Used when transitioning to the RED state in the traffic light system.
+ * Must be called from the control side (core 0 interrupt handlers or
+ * before they are enabled).
  *
- * Also prints a status message to the console.
+ * @param x Intersection to copy.
+ * @param snapshot Destination snapshot.
  */
-void turn_on_red_signal()
+void take_snapshot(const struct intersection *x, struct light_snapshot *snapshot)
 {
-    gpio_put(GREEN_LED, 0);
-    gpio_put(RED_LED, 1);
-    printf("Signal: Red!\n");
+    light_state s = x->current;
+    snapshot->state = LIGHT_PHASE(s);
+    snapshot->phase = &x->phases[LIGHT_PHASE(s)];
+    snapshot->start_us = x->phase_start_us;
+    snapshot->end_us = x->phase_end_us;
+    snapshot->pedestrian = s & LIGHT_REQUESTS;
+    snapshot->resting = s & LIGHT_RESTING;
 }
 
 /**
- * @brief Turns on the yellow traffic light signal.
+ * @brief Publishes the state of an intersection for the renderer.
  *
- * Sets both green and red LED GPIOs high to represent the yellow signal.
- * Used when transitioning to the YELLOW state in the traffic light system.
+ * Writer side of the sequence lock. Only called from the control side,
+ * inside its critical section, so two updates never interleave.
  *
- * Also prints a status message to the console.
+ * @param x Intersection to publish.
  */
-void turn_on_yellow_signal()
+void publish_snapshot(const struct intersection *x)
 {
-    gpio_put(GREEN_LED, 1);
-    gpio_put(RED_LED, 1);
-    printf("Signal: Yellow!\n");
+    snapshot_seq++;
+    __mem_fence_release();
+    take_snapshot(x, &published_snapshots[x - intersections]);
+    __mem_fence_release();
+    snapshot_seq++;
 }
 
 /**
- * @brief Initializes hardware peripherals and prepares the system.
+ * @brief Reads the most recently published state of every intersection.
  *
- * - Initializes standard I/O.
- * - Configures GPIO pins for green and red LEDs as outputs, initially off.
- * - Configures pedestrian buttons A and B as inputs with pull-up resistors.
- * - Initializes PWM for the buzzer.
- * - Waits 2 seconds before starting.
- * - Prints a startup message.
- * - Turns on the red traffic light signal initially.
+ * Reader side of the sequence lock. Retries while the writer is updating
+ * a snapshot, which only takes a few instructions.
+ *
+ * @param snapshots Destination array with INTERSECTION_COUNT entries.
  */
-void setup()
+void read_snapshots(struct light_snapshot *snapshots)
 {
-    stdio_init_all();
+    uint32_t seq;
+    do
+    {
+        seq = snapshot_seq;
+        __mem_fence_acquire();
+        for (uint i = 0; i < INTERSECTION_COUNT; i++)
+            snapshots[i] = published_snapshots[i];
+        __mem_fence_acquire();
+    } while ((seq & 1) || seq != snapshot_seq);
+}
+
+/**
+ * @brief Adds one sample to a latency histogram.
+ *
+ * @param stat Histogram to update.
+ * @param us Measured latency in microseconds.
+ */
+void record_latency(latency_stat stat, uint32_t us)
+{
+    struct latency_histogram *h = &latency_stats[stat];
+    uint bucket = us ? 32 - __builtin_clz(us) : 0;
+    if (bucket >= HISTOGRAM_BUCKETS)
+        bucket = HISTOGRAM_BUCKETS - 1;
+
+    if (!h->count || us < h->min)
+        h->min = us;
+    if (us > h->max)
+        h->max = us;
+    h->buckets[bucket]++;
+    h->count++;
+}
+
+/**
+ * @brief Clears every latency histogram.
+ */
+void reset_latency_stats()
+{
+    uint32_t irq_status = save_and_disable_interrupts();
+    for (uint i = 0; i < STAT_COUNT; i++)
+    {
+        struct latency_histogram *h = &latency_stats[i];
+        h->count = h->min = h->max = 0;
+        memset(h->buckets, 0, sizeof(h->buckets));
+    }
+    restore_interrupts(irq_status);
+}
+
+/**
+ * @brief Prints count, min, p50, p90, p99 and max of every histogram.
+ *
+ * Percentiles are upper bounds: the top of the bucket the sample falls in.
+ */
+void print_latency_stats()
+{
+    static const uint32_t percentiles[] = {50, 90, 99};
+    for (uint i = 0; i < STAT_COUNT; i++)
+    {
+        struct latency_histogram h = latency_stats[i];
+        printf("%-16s n=%lu", h.name, (unsigned long)h.count);
+        if (!h.count)
+        {
+            printf("\n");
+            continue;
+        }
+        printf(" min=%lu", (unsigned long)h.min);
+        uint bucket = 0;
+        uint32_t seen = h.buckets[0];
+        for (uint p = 0; p < count_of(percentiles); p++)
+        {
+            uint32_t target = (uint32_t)(((uint64_t)h.count * percentiles[p] + 99) / 100);
+            while (seen < target && bucket < HISTOGRAM_BUCKETS - 1)
+                seen += h.buckets[++bucket];
+            uint32_t bound = bucket ? (1u << bucket) - 1 : 0;
+            printf(" p%lu<=%lu", (unsigned long)percentiles[p], (unsigned long)MIN(bound, h.max));
+        }
+        printf(" max=%lu us\n", (unsigned long)h.max);
+    }
+    printf("events dropped: %lu\n", (unsigned long)events_dropped);
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+    {
+        const struct intersection *x = &intersections[i];
+        print_intersection(i);
+        printf("pedestrian phases: %lu, requests: %lu (%lu merged), demand: %lu per %u s\n",
+               (unsigned long)x->pedestrian_phases, (unsigned long)x->requests,
+               (unsigned long)x->merged_requests, (unsigned long)x->demand, DEMAND_WINDOW_MS / 1000);
+    }
+}
+
+/**
+ * @brief Completion callback of the asynchronous display flush (DMA IRQ).
+ *
+ * Wakes the display loop to present a frame that was drawn while this
+ * flush was in flight.
+ */
+void display_flush_done()
+{
+    record_latency(STAT_DISPLAY_FLUSH, time_us_32() - display_flush_start_us);
+    if (display_present_pending)
+    {
+        display_present_pending = false;
+        display_refresh_due = true;
+        __sev();
+    }
+}
 
-    gpio_init(GREEN_LED);
-    gpio_set_dir(GREEN_LED, GPIO_OUT);
-    gpio_put(GREEN_LED, 0);
+/**
+ * @brief Reads serial console input without blocking.
+ *
+ * Collects characters into console_line and runs the command when a line
+ * ends. Called from the loop that drains the event queue.
+ */
+void poll_console()
+{
+    int c;
+    while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT)
+    {
+        if (c == '\r' || c == '\n')
+        {
+            console_line[console_length] = '\0';
+            if (console_length)
+                run_command(console_line);
+            console_length = 0;
+        }
+        else if (console_length < CONSOLE_LINE_MAX - 1)
+        {
+            console_line[console_length++] = (char)c;
+        }
+    }
+}
 
-    gpio_init(RED_LED);
-    gpio_set_dir(RED_LED, GPIO_OUT);
-    gpio_put(RED_LED, 0);
+/**
+ * @brief Runs one serial console command.
+ *
+ * - "stats": prints the latency histograms.
+ * - "stats reset": clears them.
+ * - "wave": prints the green-wave state (TRAFFIC_LIGHT_GREEN_WAVE).
+ * - "wave offset <ms>": moves this controller's GREEN within the shared
+ *   cycle; applied from the next GREEN.
+ * - "telemetry": prints the stream and command channel state
+ *   (TRAFFIC_LIGHT_TELEMETRY).
+ * - "flash": prints the lifetime counters and the persistent store state.
+ *
+ * @param line Command line without its terminator.
+ */
+void run_command(const char *line)
+{
+#if TRAFFIC_LIGHT_GREEN_WAVE
+    unsigned long offset_ms;
+#endif
+    if (strcmp(line, "stats") == 0)
+        print_latency_stats();
+    else if (strcmp(line, "stats reset") == 0)
+        reset_latency_stats();
+#if TRAFFIC_LIGHT_GREEN_WAVE
+    else if (strcmp(line, "wave") == 0)
+        print_green_wave();
+    else if (sscanf(line, "wave offset %lu", &offset_ms) == 1)
+    {
+        uint32_t irq_status = control_enter();
+        wave.offset_ms = offset_ms % GREEN_WAVE_CYCLE_MS;
+        control_exit(irq_status);
+#if TRAFFIC_LIGHT_PERSIST
+        persist_mark(PERSIST_WAVE_OFFSET);
+#endif
+        print_green_wave();
+    }
+#endif
+#if TRAFFIC_LIGHT_TELEMETRY
+    else if (strcmp(line, "telemetry") == 0)
+        print_telemetry();
+#endif
+    else if (strcmp(line, "flash") == 0)
+        print_persist();
+    else
+        printf("Unknown command: %s\n", line);
+}
 
-    gpio_init(BUTTON_A);
-    gpio_set_dir(BUTTON_A, GPIO_IN);
-    gpio_pull_up(BUTTON_A);
+/**
+ * @brief Wakes the console loop when serial input arrives.
+ *
+ * Runs in the stdio driver's interrupt; the interrupt itself ends the
+ * WFI of core 0, and the event wakes the WFE of core 1.
+ *
+ * @param param Unused.
+ */
+void console_chars_available(void *param)
+{
+    __sev();
+}
 
-    gpio_init(BUTTON_B);
-    gpio_set_dir(BUTTON_B, GPIO_IN);
-    gpio_pull_up(BUTTON_B);
+/**
+ * @brief Entry point of core 1 in dual-core mode.
+ *
+ * Initializes stdio (so USB CDC servicing runs on this core) and the
+ * display, then drains the event queue forever, sleeping in WFE while it
+ * is empty (post_event() signals with SEV). Core 0 never waits on I2C or
+ * USB in this mode.
+ */
+void core1_entry()
+{
+#if TRAFFIC_LIGHT_PERSIST
+    // Lets core 0 park this core in RAM while it writes flash
+    multicore_lockout_victim_init();
+#endif
+    stdio_init_all();
+    stdio_set_chars_available_callback(console_chars_available, NULL);
+    init_display();
+    report_boot_time();
 
-    pwm_init_buzzer(BUZZER);
-    sleep_ms(2000);
-    printf("Traffic Light System\n");
-    turn_on_red_signal();
+    while (true)
+    {
+        process_events();
+        poll_console();
+        if (event_queue_empty() && !display_refresh_due)
+            __wfe();
+    }
 }
 
+#if !TRAFFIC_LIGHT_NO_MAIN
 int main()
 {
+    init_signals();
+#if TRAFFIC_LIGHT_WATCHDOG
+    check_watchdog_reboot();
+    if (monitor.safe_mode)
+    {
+        start_safe_mode();
+        while (true)
+            __wfi();
+    }
+#endif
+#if TRAFFIC_LIGHT_LOW_POWER
+    init_clocks();
+#endif
+#if TRAFFIC_LIGHT_DUAL_CORE
+    multicore_launch_core1(core1_entry);
     setup();
-    init_display();
+#else
+    setup();
+    if (!quick_start)
+    {
+        init_display();
+        report_boot_time();
+    }
+#endif
+
+    uint64_t now = time_us_64();
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+        start_step(&intersections[i], now);
+    schedule_next_step();
 
-    struct repeating_timer timer;
-    struct repeating_timer buzzer_timer;
+    // Buttons without a PIO debouncer fall back to the GPIO edge IRQ
+    gpio_set_irq_callback(&button_interrupt_handler);
+    for (uint i = 0; i < INTERSECTION_COUNT; i++)
+    {
+        if (button_sms[i][0] < 0)
+            gpio_set_irq_enabled(intersection_configs[i].button_a, GPIO_IRQ_EDGE_FALL, true);
+        if (button_sms[i][1] < 0)
+            gpio_set_irq_enabled(intersection_configs[i].button_b, GPIO_IRQ_EDGE_FALL, true);
+    }
+    irq_set_enabled(IO_IRQ_BANK0, true);
 
-    add_repeating_timer_ms(-1000, state_controller, NULL, &timer);
-    gpio_set_irq_enabled_with_callback(BUTTON_A, GPIO_IRQ_EDGE_FALL, true, &button_interrupt_handler);
-    gpio_set_irq_enabled(BUTTON_B, GPIO_IRQ_EDGE_FALL, true);
+#if !TRAFFIC_LIGHT_DUAL_CORE
+    if (quick_start)
+    {
+        // The controller is already running from its alarm; events queued
+        // meanwhile are drawn once the display is up
+        init_display();
+        report_boot_time();
+    }
+#endif
+#if TRAFFIC_LIGHT_NETWORK
+    init_network();
+#endif
+#if TRAFFIC_LIGHT_GREEN_WAVE
+    init_green_wave();
+#endif
+#if TRAFFIC_LIGHT_TELEMETRY
+    init_telemetry();
+#endif
+#if TRAFFIC_LIGHT_WATCHDOG
+    init_watchdog();
+#endif
 
     while (true)
     {
-        tight_loop_contents();
+#if !TRAFFIC_LIGHT_DUAL_CORE
+        process_events();
+        poll_console();
+#endif
+#if TRAFFIC_LIGHT_LOW_POWER
+        update_power_mode();
+#endif
+#if TRAFFIC_LIGHT_PERSIST
+        persist_service();
+#endif
+#if TRAFFIC_LIGHT_WATCHDOG
+        service_watchdog();
+#endif
+        // Sleep until the next interrupt. Interrupts are masked while the
+        // queue is checked so an event posted in between still wakes the
+        // core (WFI returns on a pending interrupt even when masked).
+        uint32_t irq_status = save_and_disable_interrupts();
+        if (TRAFFIC_LIGHT_DUAL_CORE || (event_queue_empty() && !display_refresh_due))
+            __wfi();
+        restore_interrupts(irq_status);
     }
 
     return 0;
 }
+#endif
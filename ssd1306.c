@@ -28,223 +28,1043 @@
  */
 
 #include "ssd1306.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
 
 /**
  * @brief Fonte de caracteres 5x7 pixels
  * 
- * Array que define os padrões de bits para caracteres ASCII de 32 a 126.
- * Cada caractere é definido em uma matriz 5x7 pixels.
+ * Lista dos padrões de bits dos caracteres ASCII de 32 a 126, um GLYPH
+ * por caractere com suas 5 colunas. Cada byte define uma coluna vertical
+ * de 8 pixels (bit 0 no topo). A mesma lista gera a fonte normal e as
+ * fontes ampliadas do atlas de sprites.
  */
+#define SSD1306_FONT5X7(GLYPH) \
+    GLYPH(0x00,0x00,0x00,0x00,0x00) /* Espaço */    \
+    GLYPH(0x00,0x00,0x5F,0x00,0x00) /* ! */         \
+    GLYPH(0x00,0x07,0x00,0x07,0x00) /* " */         \
+    GLYPH(0x14,0x7F,0x14,0x7F,0x14) /* # */         \
+    GLYPH(0x24,0x2A,0x7F,0x2A,0x12) /* $ */         \
+    GLYPH(0x23,0x13,0x08,0x64,0x62) /* % */         \
+    GLYPH(0x36,0x49,0x55,0x22,0x50) /* & */         \
+    GLYPH(0x00,0x05,0x03,0x00,0x00) /* ' */         \
+    GLYPH(0x00,0x1C,0x22,0x41,0x00) /* ( */         \
+    GLYPH(0x00,0x41,0x22,0x1C,0x00) /* ) */         \
+    GLYPH(0x14,0x08,0x3E,0x08,0x14) /* * */         \
+    GLYPH(0x08,0x08,0x3E,0x08,0x08) /* + */         \
+    GLYPH(0x00,0x50,0x30,0x00,0x00) /* , */         \
+    GLYPH(0x08,0x08,0x08,0x08,0x08) /* - */         \
+    GLYPH(0x00,0x60,0x60,0x00,0x00) /* . */         \
+    GLYPH(0x20,0x10,0x08,0x04,0x02) /* / */         \
+    GLYPH(0x3E,0x51,0x49,0x45,0x3E) /* 0 */         \
+    GLYPH(0x00,0x42,0x7F,0x40,0x00) /* 1 */         \
+    GLYPH(0x72,0x49,0x49,0x49,0x46) /* 2 */         \
+    GLYPH(0x21,0x41,0x49,0x4D,0x33) /* 3 */         \
+    GLYPH(0x18,0x14,0x12,0x7F,0x10) /* 4 */         \
+    GLYPH(0x27,0x45,0x45,0x45,0x39) /* 5 */         \
+    GLYPH(0x3C,0x4A,0x49,0x49,0x31) /* 6 */         \
+    GLYPH(0x41,0x21,0x11,0x09,0x07) /* 7 */         \
+    GLYPH(0x36,0x49,0x49,0x49,0x36) /* 8 */         \
+    GLYPH(0x46,0x49,0x49,0x29,0x1E) /* 9 */         \
+    GLYPH(0x00,0x36,0x36,0x00,0x00) /* : */         \
+    GLYPH(0x00,0x56,0x36,0x00,0x00) /* ; */         \
+    GLYPH(0x08,0x14,0x22,0x41,0x00) /* < */         \
+    GLYPH(0x14,0x14,0x14,0x14,0x14) /* = */         \
+    GLYPH(0x00,0x41,0x22,0x14,0x08) /* > */         \
+    GLYPH(0x02,0x01,0x59,0x09,0x06) /* ? */         \
+    GLYPH(0x3E,0x41,0x5D,0x59,0x4E) /* @ */         \
+    GLYPH(0x7C,0x12,0x11,0x12,0x7C) /* A */         \
+    GLYPH(0x7F,0x49,0x49,0x49,0x36) /* B */         \
+    GLYPH(0x3E,0x41,0x41,0x41,0x22) /* C */         \
+    GLYPH(0x7F,0x41,0x41,0x22,0x1C) /* D */         \
+    GLYPH(0x7F,0x49,0x49,0x49,0x41) /* E */         \
+    GLYPH(0x7F,0x09,0x09,0x09,0x01) /* F */         \
+    GLYPH(0x3E,0x41,0x49,0x49,0x7A) /* G */         \
+    GLYPH(0x7F,0x08,0x08,0x08,0x7F) /* H */         \
+    GLYPH(0x00,0x41,0x7F,0x41,0x00) /* I */         \
+    GLYPH(0x20,0x40,0x41,0x3F,0x01) /* J */         \
+    GLYPH(0x7F,0x08,0x14,0x22,0x41) /* K */         \
+    GLYPH(0x7F,0x40,0x40,0x40,0x40) /* L */         \
+    GLYPH(0x7F,0x02,0x0C,0x02,0x7F) /* M */         \
+    GLYPH(0x7F,0x04,0x08,0x10,0x7F) /* N */         \
+    GLYPH(0x3E,0x41,0x41,0x41,0x3E) /* O */         \
+    GLYPH(0x7F,0x09,0x09,0x09,0x06) /* P */         \
+    GLYPH(0x3E,0x41,0x51,0x21,0x5E) /* Q */         \
+    GLYPH(0x7F,0x09,0x19,0x29,0x46) /* R */         \
+    GLYPH(0x46,0x49,0x49,0x49,0x31) /* S */         \
+    GLYPH(0x01,0x01,0x7F,0x01,0x01) /* T */         \
+    GLYPH(0x3F,0x40,0x40,0x40,0x3F) /* U */         \
+    GLYPH(0x1F,0x20,0x40,0x20,0x1F) /* V */         \
+    GLYPH(0x3F,0x40,0x38,0x40,0x3F) /* W */         \
+    GLYPH(0x63,0x14,0x08,0x14,0x63) /* X */         \
+    GLYPH(0x07,0x08,0x70,0x08,0x07) /* Y */         \
+    GLYPH(0x61,0x51,0x49,0x45,0x43) /* Z */         \
+    GLYPH(0x00,0x7F,0x41,0x41,0x00) /* [ */         \
+    GLYPH(0x02,0x04,0x08,0x10,0x20) /* Backslash */ \
+    GLYPH(0x00,0x41,0x41,0x7F,0x00) /* ] */         \
+    GLYPH(0x04,0x02,0x01,0x02,0x04) /* ^ */         \
+    GLYPH(0x40,0x40,0x40,0x40,0x40) /* _ */         \
+    GLYPH(0x00,0x01,0x02,0x04,0x00) /* ` */         \
+    GLYPH(0x20,0x54,0x54,0x54,0x78) /* a */         \
+    GLYPH(0x7F,0x48,0x44,0x44,0x38) /* b */         \
+    GLYPH(0x38,0x44,0x44,0x44,0x20) /* c */         \
+    GLYPH(0x38,0x44,0x44,0x48,0x7F) /* d */         \
+    GLYPH(0x38,0x54,0x54,0x54,0x18) /* e */         \
+    GLYPH(0x08,0x7E,0x09,0x01,0x02) /* f */         \
+    GLYPH(0x0C,0x52,0x52,0x52,0x3E) /* g */         \
+    GLYPH(0x7F,0x08,0x04,0x04,0x78) /* h */         \
+    GLYPH(0x00,0x44,0x7D,0x40,0x00) /* i */         \
+    GLYPH(0x20,0x40,0x44,0x3D,0x00) /* j */         \
+    GLYPH(0x7F,0x10,0x28,0x44,0x00) /* k */         \
+    GLYPH(0x00,0x41,0x7F,0x40,0x00) /* l */         \
+    GLYPH(0x7C,0x04,0x18,0x04,0x78) /* m */         \
+    GLYPH(0x7C,0x08,0x04,0x04,0x78) /* n */         \
+    GLYPH(0x38,0x44,0x44,0x44,0x38) /* o */         \
+    GLYPH(0x7C,0x14,0x14,0x14,0x08) /* p */         \
+    GLYPH(0x08,0x14,0x14,0x18,0x7C) /* q */         \
+    GLYPH(0x7C,0x08,0x04,0x04,0x08) /* r */         \
+    GLYPH(0x48,0x54,0x54,0x54,0x20) /* s */         \
+    GLYPH(0x04,0x3F,0x44,0x40,0x20) /* t */         \
+    GLYPH(0x3C,0x40,0x40,0x20,0x7C) /* u */         \
+    GLYPH(0x1C,0x20,0x40,0x20,0x1C) /* v */         \
+    GLYPH(0x3C,0x40,0x30,0x40,0x3C) /* w */         \
+    GLYPH(0x44,0x28,0x10,0x28,0x44) /* x */         \
+    GLYPH(0x0C,0x50,0x50,0x50,0x3C) /* y */         \
+    GLYPH(0x44,0x64,0x54,0x4C,0x44) /* z */         \
+    GLYPH(0x00,0x08,0x36,0x41,0x00) /* { */         \
+    GLYPH(0x00,0x00,0x7F,0x00,0x00) /* | */         \
+    GLYPH(0x00,0x41,0x36,0x08,0x00) /* } */         \
+    GLYPH(0x08,0x08,0x2A,0x1C,0x08) /* -> */        \
+    GLYPH(0x08,0x1C,0x2A,0x08,0x08) /* <- */
+
+#define SSD1306_GLYPH_X1(a, b, c, d, e) {a, b, c, d, e},
+
 static const uint8_t font5x7[][5] = {
-    // Definição dos caracteres ASCII de 32 (espaço) a 126 (~)
-    // Cada linha representa um caractere com 5 bytes, onde cada byte
-    // define uma coluna vertical de 8 pixels
-    {0x00,0x00,0x00,0x00,0x00}, // Espaço
-    {0x00,0x00,0x5F,0x00,0x00}, // !
-    {0x00,0x07,0x00,0x07,0x00}, // "
-    {0x14,0x7F,0x14,0x7F,0x14}, // #
-    {0x24,0x2A,0x7F,0x2A,0x12}, // $
-    {0x23,0x13,0x08,0x64,0x62}, // %
-    {0x36,0x49,0x55,0x22,0x50}, // &
-    {0x00,0x05,0x03,0x00,0x00}, // '
-    {0x00,0x1C,0x22,0x41,0x00}, // (
-    {0x00,0x41,0x22,0x1C,0x00}, // )
-    {0x14,0x08,0x3E,0x08,0x14}, // *
-    {0x08,0x08,0x3E,0x08,0x08}, // +
-    {0x00,0x50,0x30,0x00,0x00}, // ,
-    {0x08,0x08,0x08,0x08,0x08}, // -
-    {0x00,0x60,0x60,0x00,0x00}, // .
-    {0x20,0x10,0x08,0x04,0x02}, // /
-    {0x3E,0x51,0x49,0x45,0x3E}, // 0
-    {0x00,0x42,0x7F,0x40,0x00}, // 1
-    {0x72,0x49,0x49,0x49,0x46}, // 2
-    {0x21,0x41,0x49,0x4D,0x33}, // 3
-    {0x18,0x14,0x12,0x7F,0x10}, // 4
-    {0x27,0x45,0x45,0x45,0x39}, // 5
-    {0x3C,0x4A,0x49,0x49,0x31}, // 6
-    {0x41,0x21,0x11,0x09,0x07}, // 7
-    {0x36,0x49,0x49,0x49,0x36}, // 8
-    {0x46,0x49,0x49,0x29,0x1E}, // 9
-    {0x00,0x36,0x36,0x00,0x00}, // :
-    {0x00,0x56,0x36,0x00,0x00}, // ;
-    {0x08,0x14,0x22,0x41,0x00}, // <
-    {0x14,0x14,0x14,0x14,0x14}, // =
-    {0x00,0x41,0x22,0x14,0x08}, // >
-    {0x02,0x01,0x59,0x09,0x06}, // ?
-    {0x3E,0x41,0x5D,0x59,0x4E}, // @
-    {0x7C,0x12,0x11,0x12,0x7C}, // A
-    {0x7F,0x49,0x49,0x49,0x36}, // B
-    {0x3E,0x41,0x41,0x41,0x22}, // C
-    {0x7F,0x41,0x41,0x22,0x1C}, // D
-    {0x7F,0x49,0x49,0x49,0x41}, // E
-    {0x7F,0x09,0x09,0x09,0x01}, // F
-    {0x3E,0x41,0x49,0x49,0x7A}, // G
-    {0x7F,0x08,0x08,0x08,0x7F}, // H
-    {0x00,0x41,0x7F,0x41,0x00}, // I
-    {0x20,0x40,0x41,0x3F,0x01}, // J
-    {0x7F,0x08,0x14,0x22,0x41}, // K
-    {0x7F,0x40,0x40,0x40,0x40}, // L
-    {0x7F,0x02,0x0C,0x02,0x7F}, // M
-    {0x7F,0x04,0x08,0x10,0x7F}, // N
-    {0x3E,0x41,0x41,0x41,0x3E}, // O
-    {0x7F,0x09,0x09,0x09,0x06}, // P
-    {0x3E,0x41,0x51,0x21,0x5E}, // Q
-    {0x7F,0x09,0x19,0x29,0x46}, // R
-    {0x46,0x49,0x49,0x49,0x31}, // S
-    {0x01,0x01,0x7F,0x01,0x01}, // T
-    {0x3F,0x40,0x40,0x40,0x3F}, // U
-    {0x1F,0x20,0x40,0x20,0x1F}, // V
-    {0x3F,0x40,0x38,0x40,0x3F}, // W
-    {0x63,0x14,0x08,0x14,0x63}, // X
-    {0x07,0x08,0x70,0x08,0x07}, // Y
-    {0x61,0x51,0x49,0x45,0x43}, // Z
-    {0x00,0x7F,0x41,0x41,0x00}, // [
-    {0x02,0x04,0x08,0x10,0x20}, // Backslash
-    {0x00,0x41,0x41,0x7F,0x00}, // ]
-    {0x04,0x02,0x01,0x02,0x04}, // ^
-    {0x40,0x40,0x40,0x40,0x40}, // _
-    {0x00,0x01,0x02,0x04,0x00}, // `
-    {0x20,0x54,0x54,0x54,0x78}, // a
-    {0x7F,0x48,0x44,0x44,0x38}, // b
-    {0x38,0x44,0x44,0x44,0x20}, // c
-    {0x38,0x44,0x44,0x48,0x7F}, // d
-    {0x38,0x54,0x54,0x54,0x18}, // e
-    {0x08,0x7E,0x09,0x01,0x02}, // f
-    {0x0C,0x52,0x52,0x52,0x3E}, // g
-    {0x7F,0x08,0x04,0x04,0x78}, // h
-    {0x00,0x44,0x7D,0x40,0x00}, // i
-    {0x20,0x40,0x44,0x3D,0x00}, // j
-    {0x7F,0x10,0x28,0x44,0x00}, // k
-    {0x00,0x41,0x7F,0x40,0x00}, // l
-    {0x7C,0x04,0x18,0x04,0x78}, // m
-    {0x7C,0x08,0x04,0x04,0x78}, // n
-    {0x38,0x44,0x44,0x44,0x38}, // o
-    {0x7C,0x14,0x14,0x14,0x08}, // p
-    {0x08,0x14,0x14,0x18,0x7C}, // q
-    {0x7C,0x08,0x04,0x04,0x08}, // r
-    {0x48,0x54,0x54,0x54,0x20}, // s
-    {0x04,0x3F,0x44,0x40,0x20}, // t
-    {0x3C,0x40,0x40,0x20,0x7C}, // u
-    {0x1C,0x20,0x40,0x20,0x1C}, // v
-    {0x3C,0x40,0x30,0x40,0x3C}, // w
-    {0x44,0x28,0x10,0x28,0x44}, // x
-    {0x0C,0x50,0x50,0x50,0x3C}, // y
-    {0x44,0x64,0x54,0x4C,0x44}, // z
-    {0x00,0x08,0x36,0x41,0x00}, // {
-    {0x00,0x00,0x7F,0x00,0x00}, // |
-    {0x00,0x41,0x36,0x08,0x00}, // }
-    {0x08,0x08,0x2A,0x1C,0x08}, // ->
-    {0x08,0x1C,0x2A,0x08,0x08}  // <-
+    SSD1306_FONT5X7(SSD1306_GLYPH_X1)
+};
+
+/**
+ * @brief Ampliação vertical de uma coluna de pixels em tempo de compilação
+ * 
+ * SSD1306_SCALE_BYTE(c, s, p) é o byte da página p da coluna c ampliada s
+ * vezes: o bit k vem da linha (8 * p + k) / s da coluna original. Como são
+ * expressões constantes, o compilador calcula as tabelas ampliadas e elas
+ * ficam na flash como bytes de página prontos para copiar.
+ */
+#define SSD1306_SCALE_BIT(c, s, p, k) ((((c) >> (((p) * 8 + (k)) / (s))) & 1) << (k))
+#define SSD1306_SCALE_BYTE(c, s, p) ((uint8_t)(                                      \
+    SSD1306_SCALE_BIT(c, s, p, 0) | SSD1306_SCALE_BIT(c, s, p, 1) |                   \
+    SSD1306_SCALE_BIT(c, s, p, 2) | SSD1306_SCALE_BIT(c, s, p, 3) |                   \
+    SSD1306_SCALE_BIT(c, s, p, 4) | SSD1306_SCALE_BIT(c, s, p, 5) |                   \
+    SSD1306_SCALE_BIT(c, s, p, 6) | SSD1306_SCALE_BIT(c, s, p, 7)))
+
+/**
+ * @brief Uma coluna da fonte ampliada 2x e 3x
+ * 
+ * Cada coluna original vira s colunas de s páginas; as páginas de uma
+ * coluna ficam em bytes consecutivos.
+ */
+#define SSD1306_PAGES_X2(c) SSD1306_SCALE_BYTE(c, 2, 0), SSD1306_SCALE_BYTE(c, 2, 1)
+#define SSD1306_COLUMN_X2(c) SSD1306_PAGES_X2(c), SSD1306_PAGES_X2(c)
+#define SSD1306_PAGES_X3(c) SSD1306_SCALE_BYTE(c, 3, 0), SSD1306_SCALE_BYTE(c, 3, 1), SSD1306_SCALE_BYTE(c, 3, 2)
+#define SSD1306_COLUMN_X3(c) SSD1306_PAGES_X3(c), SSD1306_PAGES_X3(c), SSD1306_PAGES_X3(c)
+
+#define SSD1306_GLYPH_X2(a, b, c, d, e) \
+    {SSD1306_COLUMN_X2(a), SSD1306_COLUMN_X2(b), SSD1306_COLUMN_X2(c), SSD1306_COLUMN_X2(d), SSD1306_COLUMN_X2(e)},
+#define SSD1306_GLYPH_X3(a, b, c, d, e) \
+    {SSD1306_COLUMN_X3(a), SSD1306_COLUMN_X3(b), SSD1306_COLUMN_X3(c), SSD1306_COLUMN_X3(d), SSD1306_COLUMN_X3(e)},
+
+/**
+ * @brief Fontes ampliadas do atlas: 10x14 pixels em 2 páginas e 15x21 em 3
+ * 
+ * Geradas da mesma lista que font5x7. Cada glifo é guardado coluna a
+ * coluna (10 colunas de 2 bytes, 15 de 3 bytes), então o desenho copia
+ * colunas inteiras em vez de ampliar pixel a pixel em tempo de execução.
+ */
+static const uint8_t font_x2[][10 * 2] = {
+    SSD1306_FONT5X7(SSD1306_GLYPH_X2)
+};
+
+static const uint8_t font_x3[][15 * 3] = {
+    SSD1306_FONT5X7(SSD1306_GLYPH_X3)
+};
+
+/**
+ * @brief Ícones de pedestre, desenhados em 12x16 pixels
+ * 
+ * Cada COLUMN recebe uma coluna de 16 pixels (bit 0 no topo):
+ * 
+ *     SSD1306_ICON_WALK    SSD1306_ICON_HAND
+ *     .....##.....         .....##.....
+ *     ....####....         ...#.##.##..
+ *     ....####....         ..##.##.##..
+ *     .....##.....         ..##.##.##..
+ *     ....####....         ..##.##.##..
+ *     ...######...         ..##.##.##.#
+ *     ..##.##.##..         ..##.##.####
+ *     .##..##..##.         ..#########.
+ *     .....##.....         ..#########.
+ *     ....####....         ..########..
+ *     ...##..##...         ..########..
+ *     ...##...##..         ...#######..
+ *     ..##....##..         ...######...
+ *     ..##.....##.         ....#####...
+ *     .##......##.         ....#####...
+ *     .##.......##         ....#####...
+ */
+#define SSD1306_ICON_WALK_COLUMNS(COLUMN)                                             \
+    COLUMN(0x0000) COLUMN(0xC080) COLUMN(0xF0C0) COLUMN(0x3C60) COLUMN(0x0E36) COLUMN(0x03FF) \
+    COLUMN(0x03FF) COLUMN(0x0636) COLUMN(0x1C60) COLUMN(0x78C0) COLUMN(0xE080) COLUMN(0x8000)
+#define SSD1306_ICON_HAND_COLUMNS(COLUMN)                                             \
+    COLUMN(0x0000) COLUMN(0x0000) COLUMN(0x07FC) COLUMN(0x1FFE) COLUMN(0xFF80) COLUMN(0xFFFF) \
+    COLUMN(0xFFFF) COLUMN(0xFF80) COLUMN(0xFFFE) COLUMN(0x0FFE) COLUMN(0x01C0) COLUMN(0x0060)
+
+_Static_assert(SSD1306_ICON_SCALE == 2 || SSD1306_ICON_SCALE == 4, "SSD1306_ICON_SCALE deve ser 2 ou 4");
+
+/**
+ * @brief Uma coluna de ícone ampliada SSD1306_ICON_SCALE vezes, até a altura do painel
+ */
+#if SSD1306_PAGES == 8
+#define SSD1306_PAGES_ICON(c)                                                                  \
+    SSD1306_SCALE_BYTE(c, SSD1306_ICON_SCALE, 0), SSD1306_SCALE_BYTE(c, SSD1306_ICON_SCALE, 1), \
+    SSD1306_SCALE_BYTE(c, SSD1306_ICON_SCALE, 2), SSD1306_SCALE_BYTE(c, SSD1306_ICON_SCALE, 3), \
+    SSD1306_SCALE_BYTE(c, SSD1306_ICON_SCALE, 4), SSD1306_SCALE_BYTE(c, SSD1306_ICON_SCALE, 5), \
+    SSD1306_SCALE_BYTE(c, SSD1306_ICON_SCALE, 6), SSD1306_SCALE_BYTE(c, SSD1306_ICON_SCALE, 7)
+#else
+#define SSD1306_PAGES_ICON(c)                                                                  \
+    SSD1306_SCALE_BYTE(c, SSD1306_ICON_SCALE, 0), SSD1306_SCALE_BYTE(c, SSD1306_ICON_SCALE, 1), \
+    SSD1306_SCALE_BYTE(c, SSD1306_ICON_SCALE, 2), SSD1306_SCALE_BYTE(c, SSD1306_ICON_SCALE, 3)
+#endif
+#if SSD1306_ICON_SCALE == 4
+#define SSD1306_COLUMN_ICON(c) SSD1306_PAGES_ICON(c), SSD1306_PAGES_ICON(c), SSD1306_PAGES_ICON(c), SSD1306_PAGES_ICON(c),
+#else
+#define SSD1306_COLUMN_ICON(c) SSD1306_PAGES_ICON(c), SSD1306_PAGES_ICON(c),
+#endif
+
+/**
+ * @brief Ícones do atlas, coluna a coluna, com a altura inteira do painel
+ */
+static const uint8_t icon_walk[SSD1306_ICON_WIDTH * SSD1306_PAGES] = {
+    SSD1306_ICON_WALK_COLUMNS(SSD1306_COLUMN_ICON)
+};
+
+static const uint8_t icon_hand[SSD1306_ICON_WIDTH * SSD1306_PAGES] = {
+    SSD1306_ICON_HAND_COLUMNS(SSD1306_COLUMN_ICON)
 };
 
+static const uint8_t *const icons[] = {
+    [SSD1306_ICON_WALK] = icon_walk,
+    [SSD1306_ICON_HAND] = icon_hand,
+};
+
+_Static_assert(SSD1306_HEIGHT % 8 == 0, "SSD1306_HEIGHT deve ser múltiplo de 8");
+
 /**
- * @brief Buffer de framebuffer do display
+ * @brief Desenrola laços sobre as páginas
+ * 
+ * SSD1306_PAGES é constante em cada build (4 ou 8), então os laços por
+ * página viram código linear, sem contador nem desvio.
+ */
+#define SSD1306_UNROLL_PAGES _Pragma("GCC unroll 8")
+
+/**
+ * @brief Par de framebuffers do display
  * 
  * Armazena o estado de todos os pixels do display.
- * O display é organizado em 8 páginas de 128 pixels de largura.
+ * O display é organizado em SSD1306_PAGES páginas de 128 pixels de largura.
+ * 
+ * As funções de desenho escrevem apenas em back; os updates leem apenas
+ * front. ssd1306_present() troca os dois ponteiros, de modo que um quadro
+ * em transmissão nunca é alterado pela renderização do próximo.
+ */
+static uint8_t buffers[2][SSD1306_WIDTH * SSD1306_HEIGHT / 8];
+static uint8_t *back = buffers[0];
+static uint8_t *front = buffers[1];
+
+/**
+ * @brief Cópia do conteúdo já enviado para a GDDRAM do display
+ * 
+ * Permite que ssd1306_update() descarte, dentro das regiões sujas,
+ * as colunas que foram reescritas com o mesmo valor já presente no painel.
+ */
+static uint8_t shadow[SSD1306_WIDTH * SSD1306_HEIGHT / 8];
+
+/**
+ * @brief Faixa de colunas modificadas em cada página
+ * 
+ * start[p] > end[p] indica que a página p está limpa.
+ * Os limites são inclusivos.
+ */
+struct ssd1306_dirty {
+    uint8_t start[SSD1306_PAGES];
+    uint8_t end[SSD1306_PAGES];
+};
+
+/**
+ * @brief Regiões alteradas no back desde o último present
+ */
+static struct ssd1306_dirty back_dirty;
+
+/**
+ * @brief Regiões do front ainda não enviadas ao display
+ */
+static struct ssd1306_dirty front_dirty;
+
+/**
+ * @brief Indica que o conteúdo de shadow não corresponde ao painel
+ * 
+ * Verdadeiro após a inicialização: a GDDRAM tem conteúdo indefinido e o
+ * primeiro update precisa enviar todas as colunas sem comparação.
+ */
+static bool shadow_invalid = true;
+
+/**
+ * @brief Marca uma faixa de colunas de uma página como modificada
+ * 
+ * @param dirty Conjunto de regiões a atualizar
+ * @param page Página (0 a SSD1306_PAGES - 1)
+ * @param x0 Primeira coluna modificada
+ * @param x1 Última coluna modificada (inclusiva)
+ */
+static inline void ssd1306_mark_dirty(struct ssd1306_dirty *dirty, uint8_t page, uint8_t x0, uint8_t x1) {
+    if (x0 < dirty->start[page])
+        dirty->start[page] = x0;
+    if (x1 > dirty->end[page])
+        dirty->end[page] = x1;
+}
+
+/**
+ * @brief Marca todas as páginas como modificadas em toda a largura
+ * 
+ * @param dirty Conjunto de regiões a atualizar
+ */
+static void ssd1306_mark_all_dirty(struct ssd1306_dirty *dirty) {
+    memset(dirty->start, 0, sizeof(dirty->start));
+    memset(dirty->end, SSD1306_WIDTH - 1, sizeof(dirty->end));
+}
+
+/**
+ * @brief Marca todas as páginas como limpas
+ * 
+ * @param dirty Conjunto de regiões a atualizar
+ */
+static void ssd1306_mark_all_clean(struct ssd1306_dirty *dirty) {
+    memset(dirty->start, SSD1306_WIDTH - 1, sizeof(dirty->start));
+    memset(dirty->end, 0, sizeof(dirty->end));
+}
+
+/**
+ * @brief Palavras de endereçamento de cada segmento de um stream assíncrono
+ * 
+ * Pares controle Co=1/comando: 0x21 e 0x22 com seus parâmetros no
+ * endereçamento horizontal, os 3 comandos de página no endereçamento por
+ * página.
+ */
+#if SSD1306_PAGE_MODE
+#define SSD1306_ADDRESS_WORDS 6
+#else
+#define SSD1306_ADDRESS_WORDS 12
+#endif
+
+/**
+ * @brief Custo extra de cada segmento: endereçamento, controle de dados e o endereço após o RESTART
+ */
+#define SSD1306_SEGMENT_OVERHEAD (SSD1306_ADDRESS_WORDS + 2)
+
+/**
+ * @brief Quantidade máxima de palavras de um stream assíncrono
+ * 
+ * No pior caso, um segmento por página: endereçamento, 1 byte de
+ * controle de dados e a página completa.
+ */
+#define SSD1306_STREAM_MAX ((SSD1306_ADDRESS_WORDS + 1) * SSD1306_PAGES + SSD1306_WIDTH * SSD1306_PAGES)
+
+/**
+ * @brief Stream de palavras para o registrador IC_DATA_CMD
+ * 
+ * O I2C do RP2040 recebe cada byte como uma palavra de 16 bits (bits 8-10
+ * são CMD/STOP/RESTART). Escritas de 8 bits no barramento APB são
+ * replicadas nos quatro bytes da palavra e acionariam esses bits, por isso
+ * o DMA precisa de palavras de 16 bits. O stream é montado a partir do
+ * front no início da transferência.
+ */
+static uint16_t tx_stream[SSD1306_STREAM_MAX];
+
+/**
+ * @brief Buffers de transmissão para escritas bloqueantes
+ * 
+ * tx_data comporta o quadro completo: no modo de endereçamento horizontal
+ * a tela inteira é enviada em uma única transação (1025 bytes em 128x64).
+ */
+static uint8_t tx_data[SSD1306_WIDTH * SSD1306_PAGES + 1];
+static uint8_t tx_cmd[SSD1306_CMD_MAX + 1];
+
+/**
+ * @brief Sequência de inicialização conforme datasheet do painel
+ */
+#if SSD1306_PANEL == SSD1306_PANEL_SH1106
+static const uint8_t init_sequence[] = {
+    0xAE,       // Display OFF
+    0xB0,       // Set Page Address
+    0xC8,       // COM Output Scan Direction remapped mode
+    0x02,       // Set low column address (coluna 2: início do painel)
+    0x10,       // Set high column address
+    0x40,       // Set start line address
+    0x81, 0xFF, // Set contrast control
+    0xA1,       // Set segment re-map
+    0xA6,       // Set normal display
+    0xA8, 0x3F, // Set multiplex ratio: 1/64 duty
+    0xA4,       // Output follows RAM content
+    0xD3, 0x00, // Set display offset: no offset
+    0xD5, 0x80, // Set display clock divide ratio/oscillator frequency
+    0xD9, 0x22, // Set discharge/pre-charge period
+    0xDA, 0x12, // Set common pads hardware configuration
+    0xDB, 0x35, // Set VCOM deselect level
+    0xAD, 0x8B, // DC-DC control mode: built-in DC-DC on
+    0x32,       // Set pump voltage: 8,0 V
+    0xAF,       // Turn on SH1106 panel
+};
+#else
+static const uint8_t init_sequence[] = {
+    0xAE,       // Display OFF
+    0x20, 0x00, // Set Memory Addressing Mode: Horizontal Addressing Mode
+    0xB0,       // Set Page Start Address for Page Addressing Mode
+    0xC8,       // COM Output Scan Direction remapped mode
+    0x00,       // Set low column address
+    0x10,       // Set high column address
+    0x40,       // Set start line address
+    0x81, 0xFF, // Set contrast control
+    0xA1,       // Set segment re-map 0 to 127
+    0xA6,       // Set normal display
+    0xA8, SSD1306_HEIGHT - 1, // Set multiplex ratio: 1/SSD1306_HEIGHT duty
+    0xA4,       // Output follows RAM content
+    0xD3, 0x00, // Set display offset: no offset
+    0xD5, 0xF0, // Set display clock divide ratio/oscillator frequency
+    0xD9, 0x22, // Set pre-charge period
+#if SSD1306_HEIGHT == 32
+    0xDA, 0x02, // Set com pins hardware configuration: sequential
+#else
+    0xDA, 0x12, // Set com pins hardware configuration: alternative
+#endif
+    0xDB, 0x20, // Set vcomh
+    0x8D, 0x14, // Set DC-DC enable
+    0xAF,       // Turn on SSD1306 panel
+};
+#endif
+
+/**
+ * @brief Janela retangular (colunas x páginas) com limites inclusivos
+ */
+struct ssd1306_window {
+    int col_first, col_last;
+    int page_first, page_last;
+};
+
+/**
+ * @brief Estado da transferência assíncrona
+ */
+static int dma_chan = -1;                      // Canal DMA (-1 se não alocado)
+static i2c_inst_t *async_i2c = NULL;           // Instância I2C da última transferência
+static volatile ssd1306_done_cb_t async_done_cb = NULL;
+static bool async_pending = false;             // Resultado ainda não verificado
+static volatile bool async_failed = false;     // Abort (NACK) durante a transferência
+static uint64_t async_deadline_us = 0;         // Limite para o fim da transferência
+
+/**
+ * @brief Frequência atual do barramento, usada nos limites de tempo
+ */
+static uint bus_baudrate = 100000;
+
+/**
+ * @brief Falha de barramento ainda não informada por ssd1306_take_error()
+ */
+static bool bus_error = false;
+
+/**
+ * @brief Reduz a faixa suja de uma página às colunas realmente diferentes
+ * 
+ * Descarta as extremidades reescritas com o mesmo valor já enviado.
+ * 
+ * @param page Página (0 a SSD1306_PAGES - 1)
+ * @param x0 Entrada/saída: primeira coluna da faixa
+ * @param x1 Entrada/saída: última coluna da faixa (inclusiva)
+ * @return true se restaram colunas a enviar
+ */
+static bool ssd1306_trim_page(uint8_t page, int *x0, int *x1) {
+    *x0 = front_dirty.start[page];
+    *x1 = front_dirty.end[page];
+    if (*x0 > *x1)
+        return false;
+    if (shadow_invalid)
+        return true;
+
+    const uint8_t *row = &front[SSD1306_WIDTH * page];
+    const uint8_t *sent = &shadow[SSD1306_WIDTH * page];
+    while (*x0 <= *x1 && row[*x0] == sent[*x0])
+        (*x0)++;
+    while (*x1 > *x0 && row[*x1] == sent[*x1])
+        (*x1)--;
+    return *x0 <= *x1;
+}
+
+/**
+ * @brief Reduz as faixas sujas de todas as páginas e calcula a janela que as envolve
+ * 
+ * @param x0 Saída: primeira coluna de cada página (x0 > x1 se limpa)
+ * @param x1 Saída: última coluna de cada página (inclusiva)
+ * @param win Saída: janela que envolve todas as páginas sujas
+ * @return Quantidade de bytes sujos, ou 0 se não há nada a enviar
+ */
+static int ssd1306_collect_dirty(int *x0, int *x1, struct ssd1306_window *win) {
+    int bytes = 0;
+    win->page_first = -1;
+    win->page_last = -1;
+    win->col_first = SSD1306_WIDTH;
+    win->col_last = -1;
+
+    SSD1306_UNROLL_PAGES
+    for (int page = 0; page < SSD1306_PAGES; page++) {
+        if (!ssd1306_trim_page(page, &x0[page], &x1[page])) {
+            x0[page] = 1;
+            x1[page] = 0;
+            continue;
+        }
+        bytes += x1[page] - x0[page] + 1;
+        if (win->page_first < 0)
+            win->page_first = page;
+        win->page_last = page;
+        if (x0[page] < win->col_first)
+            win->col_first = x0[page];
+        if (x1[page] > win->col_last)
+            win->col_last = x1[page];
+    }
+    return bytes;
+}
+
+/**
+ * @brief Decide entre uma janela única e uma janela por página suja
+ * 
+ * Uma janela única custa as colunas limpas que ela engloba; uma janela
+ * por página custa o endereçamento de cada página suja a mais. Sem
+ * endereçamento horizontal (SSD1306_PAGE_MODE) só existe a segunda opção.
+ * 
+ * @param x0 Primeira coluna de cada página (x0 > x1 se limpa)
+ * @param x1 Última coluna de cada página (inclusiva)
+ * @param win Janela que envolve todas as páginas sujas
+ * @param dirty_bytes Quantidade de bytes sujos
+ * @param overhead Bytes extras de cada janela adicional
+ * @return true se a janela única transfere menos bytes
  */
-static uint8_t buffer[SSD1306_WIDTH * SSD1306_HEIGHT / 8];
+static bool ssd1306_use_window(const int *x0, const int *x1, const struct ssd1306_window *win,
+                               int dirty_bytes, int overhead) {
+    if (SSD1306_PAGE_MODE)
+        return false;
+
+    int pages = 0;
+    SSD1306_UNROLL_PAGES
+    for (int page = 0; page < SSD1306_PAGES; page++)
+        if (x0[page] <= x1[page])
+            pages++;
+    int window_bytes = (win->col_last - win->col_first + 1) * (win->page_last - win->page_first + 1);
+    return window_bytes <= dirty_bytes + (pages - 1) * overhead;
+}
 
 /**
- * @brief Envia um comando para o display
+ * @brief Registra uma falha de barramento
+ * 
+ * O conteúdo do painel passa a ser desconhecido: o próximo update
+ * reenvia o quadro inteiro.
+ */
+static void ssd1306_bus_failed() {
+    bus_error = true;
+    shadow_invalid = true;
+    ssd1306_mark_all_dirty(&front_dirty);
+}
+
+/**
+ * @brief Envia uma transação já montada (byte de controle + conteúdo)
  * 
  * @param i2c Instância I2C a ser utilizada
- * @param cmd Comando a ser enviado
+ * @param data Transação, iniciando pelo byte de controle
+ * @param len Quantidade total de bytes
+ * @return true se o display confirmou (ACK) todos os bytes
+ */
+static bool ssd1306_write(i2c_inst_t *i2c, const uint8_t *data, size_t len) {
+    // Limite: o dobro do tempo nominal (9 bits por byte) mais a margem fixa;
+    // um quadro completo leva ~93 ms a 100 kHz
+    uint timeout_us = SSD1306_I2C_TIMEOUT_US + 2 * (uint64_t)(len + 1) * 9 * 1000000 / bus_baudrate;
+    if (i2c_write_timeout_us(i2c, SSD1306_I2C_ADDR, data, len, false, timeout_us) != (int)len) {
+        ssd1306_bus_failed();
+        return false;
+    }
+    return true;
+}
+
+#if SSD1306_PAGE_MODE
+/**
+ * @brief Comandos que posicionam o ponteiro da GDDRAM no endereçamento por página
+ * 
+ * @param cmds Saída: 3 bytes de comando
+ * @param page Página (0 a SSD1306_PAGES - 1)
+ * @param col Coluna do painel; o deslocamento da GDDRAM é somado aqui
  */
-static void ssd1306_write_command(i2c_inst_t *i2c, uint8_t cmd) {
-    uint8_t data[2] = {0x00, cmd};  // 0x00 indica byte de comando
-    i2c_write_blocking(i2c, SSD1306_I2C_ADDR, data, 2, false);
+static inline void ssd1306_page_address(uint8_t *cmds, int page, int col) {
+    col += SSD1306_COLUMN_OFFSET;
+    cmds[0] = 0xB0 | page;        // Set Page Address
+    cmds[1] = 0x00 | (col & 0x0F); // Set low column address
+    cmds[2] = 0x10 | (col >> 4);   // Set high column address
 }
 
 /**
- * @brief Envia dados para o display
+ * @brief Envia uma janela do front, uma transação de dados por página
+ * 
+ * Sem endereçamento horizontal o ponteiro da GDDRAM não avança para a
+ * página seguinte: cada página é posicionada com seus próprios comandos.
+ * 
+ * @param i2c Instância I2C a ser utilizada
+ * @param win Janela a ser enviada
+ * @return true se o display confirmou (ACK) todos os bytes
+ */
+static bool ssd1306_write_window(i2c_inst_t *i2c, const struct ssd1306_window *win) {
+    int width = win->col_last - win->col_first + 1;
+    for (int page = win->page_first; page <= win->page_last; page++) {
+        uint8_t addressing[3];
+        ssd1306_page_address(addressing, page, win->col_first);
+        if (!ssd1306_send_commands(i2c, addressing, sizeof(addressing)))
+            return false;
+
+        tx_data[0] = 0x40; // 0x40 indica bytes de dados
+        memcpy(tx_data + 1, &front[SSD1306_WIDTH * page + win->col_first], width);
+        if (!ssd1306_write(i2c, tx_data, width + 1))
+            return false;
+        memcpy(&shadow[SSD1306_WIDTH * page + win->col_first], tx_data + 1, width);
+    }
+    return true;
+}
+#else
+/**
+ * @brief Envia uma janela do front em uma única transação de dados
+ * 
+ * Os bytes são enviados página a página, na ordem em que o modo de
+ * endereçamento horizontal os grava dentro da janela configurada.
  * 
  * @param i2c Instância I2C a ser utilizada
- * @param data Ponteiro para os dados
- * @param len Quantidade de bytes a serem enviados
+ * @param win Janela a ser enviada
+ * @return true se o display confirmou (ACK) todos os bytes
  */
-static void ssd1306_write_data(i2c_inst_t *i2c, uint8_t *data, size_t len) {
-    uint8_t buf[len + 1];
-    buf[0] = 0x40; // 0x40 indica byte de dados
-    memcpy(buf + 1, data, len);
-    i2c_write_blocking(i2c, SSD1306_I2C_ADDR, buf, len + 1, false);
+static bool ssd1306_write_window(i2c_inst_t *i2c, const struct ssd1306_window *win) {
+    const uint8_t addressing[] = {
+        0x21, win->col_first, win->col_last,   // Set Column Address
+        0x22, win->page_first, win->page_last, // Set Page Address
+    };
+    if (!ssd1306_send_commands(i2c, addressing, sizeof(addressing)))
+        return false;
+
+    int width = win->col_last - win->col_first + 1;
+    uint8_t *w = tx_data;
+    *w++ = 0x40; // 0x40 indica bytes de dados
+    for (int page = win->page_first; page <= win->page_last; page++) {
+        memcpy(w, &front[SSD1306_WIDTH * page + win->col_first], width);
+        w += width;
+    }
+    if (!ssd1306_write(i2c, tx_data, w - tx_data))
+        return false;
+
+    for (int page = win->page_first; page <= win->page_last; page++)
+        memcpy(&shadow[SSD1306_WIDTH * page + win->col_first],
+               &front[SSD1306_WIDTH * page + win->col_first], width);
+    return true;
+}
+#endif
+
+/**
+ * @brief Tratador da interrupção de fim do DMA
+ * 
+ * Chamado quando a última palavra do stream foi entregue à FIFO do I2C.
+ * Registra e limpa um eventual abort (NACK) e invoca o callback do usuário.
+ */
+static void ssd1306_dma_irq_handler() {
+    if (dma_chan < 0 || !dma_channel_get_irq0_status(dma_chan))
+        return;
+    dma_channel_acknowledge_irq0(dma_chan);
+
+    i2c_hw_t *hw = i2c_get_hw(async_i2c);
+    if (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        (void)hw->clr_tx_abrt;
+        async_failed = true;
+    }
+
+    ssd1306_done_cb_t cb = async_done_cb;
+    async_done_cb = NULL;
+    if (cb)
+        cb();
+}
+
+/**
+ * @brief Aloca e configura o canal DMA na primeira transferência
+ */
+static void ssd1306_dma_setup() {
+    if (dma_chan >= 0)
+        return;
+    dma_chan = dma_claim_unused_channel(true);
+    dma_channel_set_irq0_enabled(dma_chan, true);
+    irq_add_shared_handler(DMA_IRQ_0, ssd1306_dma_irq_handler,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
 }
 
 /**
  * @brief Inicializa o display OLED
  * 
  * Configura os registradores do controlador SSD1306 com os valores
- * necessários para operação normal do display.
+ * necessários para operação normal do display, em uma única transação.
+ * A espera pela estabilização (SSD1306_POWER_UP_US) é contada a partir do
+ * boot, então não atrasa uma inicialização feita mais tarde.
+ * 
+ * @param i2c Instância I2C a ser utilizada
+ * @return true se o display confirmou todos os comandos
+ */
+bool ssd1306_init(i2c_inst_t *i2c) {
+    // Aguarda a estabilização do display, contada a partir do boot
+    uint64_t now = time_us_64();
+    if (now < SSD1306_POWER_UP_US)
+        sleep_us(SSD1306_POWER_UP_US - now);
+    bus_error = false;
+
+    ssd1306_send_commands(i2c, init_sequence, sizeof(init_sequence));
+
+    // Conteúdo da GDDRAM é indefinido: o próximo update envia tudo
+    shadow_invalid = true;
+    ssd1306_mark_all_dirty(&front_dirty);
+    ssd1306_mark_all_clean(&back_dirty);
+    return !bus_error;
+}
+
+/**
+ * @brief Envia uma lista de comandos em uma única transação I2C
+ * 
+ * Os comandos seguem um único byte de controle 0x00 (Co=0, D/C#=0).
+ * 
+ * @param i2c Instância I2C a ser utilizada
+ * @param cmds Comandos e seus parâmetros
+ * @param len Quantidade de bytes (até SSD1306_CMD_MAX)
+ * @return true se o display confirmou (ACK) todos os bytes
+ */
+bool ssd1306_send_commands(i2c_inst_t *i2c, const uint8_t *cmds, size_t len) {
+    if (len > SSD1306_CMD_MAX)
+        len = SSD1306_CMD_MAX;
+    tx_cmd[0] = 0x00; // 0x00 indica bytes de comando
+    memcpy(tx_cmd + 1, cmds, len);
+    return ssd1306_write(i2c, tx_cmd, len + 1);
+}
+
+/**
+ * @brief Altera a frequência do barramento I2C
+ * 
+ * Aguarda uma transferência assíncrona em andamento antes da troca.
  * 
  * @param i2c Instância I2C a ser utilizada
+ * @param baudrate Frequência desejada em Hz
+ * @return Frequência efetivamente configurada
+ */
+uint ssd1306_set_baudrate(i2c_inst_t *i2c, uint baudrate) {
+    ssd1306_update_wait();
+    bus_baudrate = i2c_set_baudrate(i2c, baudrate);
+    return bus_baudrate;
+}
+
+/**
+ * @brief Testa o barramento na frequência atual
+ * 
+ * Envia uma sequência de comandos NOP (0xE3) em uma única transação, o
+ * que exercita o barramento sem alterar a configuração nem a GDDRAM.
+ * Uma falha aqui não é registrada por ssd1306_take_error().
+ * 
+ * @param i2c Instância I2C a ser utilizada
+ * @return true se o display confirmou (ACK) todos os bytes a tempo
+ */
+bool ssd1306_probe(i2c_inst_t *i2c) {
+    uint8_t nops[SSD1306_PROBE_LEN];
+    nops[0] = 0x00; // Stream de comandos
+    memset(nops + 1, 0xE3, sizeof(nops) - 1);
+
+    ssd1306_update_wait();
+    return i2c_write_timeout_us(i2c, SSD1306_I2C_ADDR, nops, sizeof(nops), false,
+                                SSD1306_I2C_TIMEOUT_US) == (int)sizeof(nops);
+}
+
+/**
+ * @brief Informa e limpa uma falha de barramento registrada
+ * 
+ * @return true se houve NACK ou timeout desde a última chamada
  */
-void ssd1306_init(i2c_inst_t *i2c) {
-    sleep_ms(100); // Aguarda estabilização do display
-
-    // Sequência de inicialização conforme datasheet
-    ssd1306_write_command(i2c, 0xAE); // Display OFF
-    ssd1306_write_command(i2c, 0x20); // Set Memory Addressing Mode
-    ssd1306_write_command(i2c, 0x00); // Horizontal Addressing Mode
-    ssd1306_write_command(i2c, 0xB0); // Set Page Start Address for Page Addressing Mode
-    ssd1306_write_command(i2c, 0xC8); // COM Output Scan Direction remapped mode
-    ssd1306_write_command(i2c, 0x00); // Set low column address
-    ssd1306_write_command(i2c, 0x10); // Set high column address
-    ssd1306_write_command(i2c, 0x40); // Set start line address
-    ssd1306_write_command(i2c, 0x81); // Set contrast control
-    ssd1306_write_command(i2c, 0xFF);
-    ssd1306_write_command(i2c, 0xA1); // Set segment re-map 0 to 127
-    ssd1306_write_command(i2c, 0xA6); // Set normal display
-    ssd1306_write_command(i2c, 0xA8); // Set multiplex ratio(1 to 64)
-    ssd1306_write_command(i2c, 0x3F); // 1/64 duty
-    ssd1306_write_command(i2c, 0xA4); // Output follows RAM content
-    ssd1306_write_command(i2c, 0xD3); // Set display offset
-    ssd1306_write_command(i2c, 0x00); // No offset
-    ssd1306_write_command(i2c, 0xD5); // Set display clock divide ratio/oscillator frequency
-    ssd1306_write_command(i2c, 0xF0); // Set divide ratio
-    ssd1306_write_command(i2c, 0xD9); // Set pre-charge period
-    ssd1306_write_command(i2c, 0x22);
-    ssd1306_write_command(i2c, 0xDA); // Set com pins hardware configuration
-    ssd1306_write_command(i2c, 0x12);
-    ssd1306_write_command(i2c, 0xDB); // Set vcomh
-    ssd1306_write_command(i2c, 0x20);
-    ssd1306_write_command(i2c, 0x8D); // Set DC-DC enable
-    ssd1306_write_command(i2c, 0x14);
-    ssd1306_write_command(i2c, 0xAF); // Turn on SSD1306 panel
+bool ssd1306_take_error() {
+    ssd1306_update_busy(); // Conclui a verificação da transferência assíncrona
+    bool error = bus_error;
+    bus_error = false;
+    return error;
 }
 
 /**
  * @brief Limpa o buffer do display
  * 
- * Preenche o buffer com zeros, apagando todos os pixels
+ * Preenche o back com zeros, apagando todos os pixels
  */
 void ssd1306_clear() {
-    memset(buffer, 0, sizeof(buffer));
+    memset(back, 0, sizeof(buffers[0]));
+    ssd1306_mark_all_dirty(&back_dirty);
+}
+
+/**
+ * @brief Publica o quadro desenhado no back
+ * 
+ * Troca front e back e acumula as regiões desenhadas nas pendentes de
+ * envio. Em seguida copia essas regiões do novo front para o novo back,
+ * que volta a conter o quadro completo: a renderização incremental
+ * continua a partir do último quadro, e não do anterior a ele.
+ * 
+ * @return true se o quadro foi publicado, false se uma transferência
+ *         assíncrona ainda lê o front (o quadro continua no back)
+ */
+bool ssd1306_present() {
+    if (ssd1306_update_busy())
+        return false;
+
+    uint8_t *drawn = back;
+    back = front;
+    front = drawn;
+
+    SSD1306_UNROLL_PAGES
+    for (uint8_t page = 0; page < SSD1306_PAGES; page++) {
+        int x0 = back_dirty.start[page];
+        int x1 = back_dirty.end[page];
+        if (x0 > x1)
+            continue;
+        ssd1306_mark_dirty(&front_dirty, page, x0, x1);
+        memcpy(&back[SSD1306_WIDTH * page + x0], &front[SSD1306_WIDTH * page + x0], x1 - x0 + 1);
+    }
+    ssd1306_mark_all_clean(&back_dirty);
+    return true;
 }
 
 /**
  * @brief Atualiza o conteúdo do display
  * 
- * Envia o conteúdo do buffer para o display, página por página
+ * Envia para o display apenas as regiões do front (último quadro
+ * publicado por ssd1306_present()) modificadas desde o último update.
+ * Para cada página suja, a faixa de colunas é reduzida descartando as
+ * extremidades que não diferem do conteúdo já enviado (shadow). As regiões
+ * são endereçadas com os comandos Set Column Address (0x21) e Set Page
+ * Address (0x22), válidos no modo de endereçamento horizontal: ou todas
+ * juntas em uma única janela (um quadro completo vira uma transação de
+ * comandos e uma de 1025 bytes de dados), ou uma janela por página, o que
+ * transferir menos bytes. Em painéis só com endereçamento por página
+ * (SSD1306_PAGE_MODE) cada página suja é sempre enviada separadamente.
+ * 
+ * Em caso de NACK ou timeout o envio é interrompido e o quadro inteiro
+ * fica pendente para o próximo update.
+ * 
+ * @param i2c Instância I2C a ser utilizada
+ * @return true se todas as regiões foram confirmadas pelo display
+ */
+bool ssd1306_update(i2c_inst_t *i2c) {
+    // Não disputa o barramento com uma transferência assíncrona
+    ssd1306_update_wait();
+
+    int x0[SSD1306_PAGES], x1[SSD1306_PAGES];
+    struct ssd1306_window win;
+    int dirty_bytes = ssd1306_collect_dirty(x0, x1, &win);
+    if (dirty_bytes == 0) {
+        shadow_invalid = false;
+        ssd1306_mark_all_clean(&front_dirty);
+        return true;
+    }
+
+    // Cada janela a mais custa um par de transações
+    if (ssd1306_use_window(x0, x1, &win, dirty_bytes, SSD1306_WINDOW_OVERHEAD)) {
+        if (!ssd1306_write_window(i2c, &win))
+            return false;
+    } else {
+        for (int page = 0; page < SSD1306_PAGES; page++) {
+            if (x0[page] > x1[page])
+                continue;
+            struct ssd1306_window row = {x0[page], x1[page], page, page};
+            if (!ssd1306_write_window(i2c, &row))
+                return false;
+        }
+    }
+
+    shadow_invalid = false;
+    ssd1306_mark_all_clean(&front_dirty);
+    return true;
+}
+
+/**
+ * @brief Acrescenta uma janela do front ao stream assíncrono
+ * 
+ * Os comandos de endereçamento vão com bytes de controle Co=1 (0x80) e
+ * os dados seguem após um único byte de controle 0x40. Um segmento que
+ * não é o primeiro começa com RESTART, que reenvia o endereço e permite
+ * um novo byte de controle na mesma transação.
+ * 
+ * @param w Próxima palavra livre do stream
+ * @param win Janela a ser enviada (uma única página em SSD1306_PAGE_MODE)
+ * @return Próxima palavra livre após o segmento
+ */
+static uint16_t *ssd1306_stream_window(uint16_t *w, const struct ssd1306_window *win) {
+#if SSD1306_PAGE_MODE
+    uint8_t addressing[3];
+    ssd1306_page_address(addressing, win->page_first, win->col_first);
+#else
+    const uint8_t addressing[] = {
+        0x21, win->col_first, win->col_last,
+        0x22, win->page_first, win->page_last,
+    };
+#endif
+    uint16_t *segment = w;
+    for (size_t i = 0; i < sizeof(addressing); i++) {
+        *w++ = 0x80;
+        *w++ = addressing[i];
+    }
+    if (segment != tx_stream)
+        *segment |= I2C_IC_DATA_CMD_RESTART_BITS;
+    *w++ = 0x40;
+
+    // Dados da janela, página a página, atualizando a cópia do painel
+    int width = win->col_last - win->col_first + 1;
+    for (int page = win->page_first; page <= win->page_last; page++) {
+        const uint8_t *row = &front[SSD1306_WIDTH * page + win->col_first];
+        for (int i = 0; i < width; i++)
+            *w++ = row[i];
+        memcpy(&shadow[SSD1306_WIDTH * page + win->col_first], row, width);
+    }
+    return w;
+}
+
+/**
+ * @brief Inicia a atualização do display via DMA, sem bloquear
+ * 
+ * Envia as regiões modificadas do front em uma única transação I2C:
+ * ou a janela (colunas x páginas) que envolve todas elas, ou um segmento
+ * por página suja separados por RESTART, o que transferir menos bytes
+ * (em SSD1306_PAGE_MODE, sempre um segmento por página). O DMA alimenta a
+ * FIFO de TX do I2C no ritmo do DREQ, deixando a CPU livre durante a
+ * transferência.
  * 
  * @param i2c Instância I2C a ser utilizada
+ * @param done_cb Callback chamado (em contexto de interrupção) quando o
+ *                último byte foi entregue ao I2C; pode ser NULL
+ * @return true se a transferência foi iniciada ou não havia nada a enviar,
+ *         false se a transferência anterior ainda está em andamento
+ */
+bool ssd1306_update_async(i2c_inst_t *i2c, ssd1306_done_cb_t done_cb) {
+    if (ssd1306_update_busy())
+        return false;
+
+    // Janela que envolve todas as páginas sujas
+    int x0[SSD1306_PAGES], x1[SSD1306_PAGES];
+    struct ssd1306_window win;
+    int dirty_bytes = ssd1306_collect_dirty(x0, x1, &win);
+
+    shadow_invalid = false;
+    ssd1306_mark_all_clean(&front_dirty);
+
+    if (dirty_bytes == 0) {
+        if (done_cb)
+            done_cb();
+        return true;
+    }
+
+    uint16_t *w = tx_stream;
+    if (ssd1306_use_window(x0, x1, &win, dirty_bytes, SSD1306_SEGMENT_OVERHEAD)) {
+        w = ssd1306_stream_window(w, &win);
+    } else {
+        for (int page = win.page_first; page <= win.page_last; page++) {
+            if (x0[page] > x1[page])
+                continue;
+            struct ssd1306_window row = {x0[page], x1[page], page, page};
+            w = ssd1306_stream_window(w, &row);
+        }
+    }
+    w[-1] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+    ssd1306_dma_setup();
+    async_i2c = i2c;
+    async_done_cb = done_cb;
+    async_failed = false;
+    async_pending = true;
+
+    // Limite: o dobro do tempo nominal (9 bits por byte) mais 1 ms
+    uint64_t words = w - tx_stream;
+    async_deadline_us = time_us_64() + 2 * words * 9 * 1000000 / bus_baudrate + 1000;
+
+    // Endereço do escravo (mesma sequência usada por i2c_write_blocking)
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    hw->enable = 0;
+    hw->tar = SSD1306_I2C_ADDR;
+    hw->enable = 1;
+
+    dma_channel_config config = dma_channel_get_default_config(dma_chan);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_16);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_dreq(&config, i2c_get_dreq(i2c, true));
+    dma_channel_configure(dma_chan, &config, &hw->data_cmd, tx_stream, w - tx_stream, true);
+    return true;
+}
+
+/**
+ * @brief Verifica se há uma transferência assíncrona em andamento
+ * 
+ * Considera tanto o DMA quanto os bytes ainda na FIFO/barramento do I2C.
+ * Ao detectar o fim, verifica o resultado: um abort (NACK) ou uma
+ * transferência que excedeu o limite de tempo é interrompida e registrada
+ * como falha de barramento.
+ * 
+ * @return true enquanto a transferência não terminou
  */
-void ssd1306_update(i2c_inst_t *i2c) {
-    for (uint8_t page = 0; page < 8; page++) {
-        // Configura endereço da página
-        ssd1306_write_command(i2c, 0xB0 + page);
-        ssd1306_write_command(i2c, 0x00);  // Coluna inicial baixa
-        ssd1306_write_command(i2c, 0x10);  // Coluna inicial alta
+bool ssd1306_update_busy() {
+    if (!async_pending)
+        return false;
+
+    i2c_hw_t *hw = i2c_get_hw(async_i2c);
+    uint32_t status = hw->status;
+    bool busy = dma_channel_is_busy(dma_chan) ||
+                !(status & I2C_IC_STATUS_TFE_BITS) || (status & I2C_IC_STATUS_MST_ACTIVITY_BITS);
+    if (busy && time_us_64() < async_deadline_us)
+        return true;
 
-        // Envia dados da página
-        ssd1306_write_data(i2c, &buffer[SSD1306_WIDTH * page], SSD1306_WIDTH);
+    if (busy) {
+        // Barramento travado: descarta o restante do stream
+        dma_channel_abort(dma_chan);
+        hw->enable = 0;
+        hw->enable = 1;
+        async_failed = true;
+    }
+    if (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        (void)hw->clr_tx_abrt;
+        async_failed = true;
     }
+
+    async_pending = false;
+    if (async_failed)
+        ssd1306_bus_failed();
+    return false;
+}
+
+/**
+ * @brief Aguarda o fim de uma transferência assíncrona
+ */
+void ssd1306_update_wait() {
+    while (ssd1306_update_busy())
+        tight_loop_contents();
 }
 
 /**
  * @brief Define o estado de um pixel no buffer
  * 
- * @param x Coordenada X (0-127)
- * @param y Coordenada Y (0-63)
+ * @param x Coordenada X (0 a SSD1306_WIDTH - 1)
+ * @param y Coordenada Y (0 a SSD1306_HEIGHT - 1)
  * @param color true para pixel aceso, false para apagado
  */
 void ssd1306_draw_pixel(int x, int y, bool color) {
@@ -253,10 +1073,174 @@ void ssd1306_draw_pixel(int x, int y, bool color) {
         return;
 
     // Calcula posição no buffer e bit correspondente
-    if (color)
-        buffer[x + (y / 8) * SSD1306_WIDTH] |= (1 << (y % 8));
-    else
-        buffer[x + (y / 8) * SSD1306_WIDTH] &= ~(1 << (y % 8));
+    // y já é positivo: página e bit por deslocamento e máscara
+    uint8_t *byte = &back[x + (y >> 3) * SSD1306_WIDTH];
+    uint8_t value = color ? (*byte | (1 << (y & 7))) : (*byte & ~(1 << (y & 7)));
+
+    // Só marca a coluna como suja se o byte realmente mudou
+    if (value != *byte) {
+        *byte = value;
+        ssd1306_mark_dirty(&back_dirty, y >> 3, x, x);
+    }
+}
+
+/**
+ * @brief Acende ou apaga os bits da máscara em uma faixa de colunas de uma página
+ * 
+ * @param page Página (0 a SSD1306_PAGES - 1)
+ * @param x0 Primeira coluna
+ * @param x1 Última coluna (inclusiva)
+ * @param mask Bits da página afetados
+ * @param color true para acender, false para apagar
+ */
+static void ssd1306_fill_page(int page, int x0, int x1, uint8_t mask, bool color) {
+    uint8_t *row = &back[page * SSD1306_WIDTH];
+    int first = -1, last = -1;
+
+    for (int x = x0; x <= x1; x++) {
+        uint8_t value = color ? row[x] | mask : row[x] & ~mask;
+        if (value != row[x]) {
+            row[x] = value;
+            if (first < 0)
+                first = x;
+            last = x;
+        }
+    }
+    if (first >= 0)
+        ssd1306_mark_dirty(&back_dirty, page, first, last);
+}
+
+/**
+ * @brief Preenche um retângulo no buffer
+ * 
+ * @param x Coordenada X do canto superior esquerdo
+ * @param y Coordenada Y do canto superior esquerdo
+ * @param w Largura em pixels
+ * @param h Altura em pixels
+ * @param color true para pixels acesos, false para apagados
+ */
+void ssd1306_fill_rect(int x, int y, int w, int h, bool color) {
+    int x0 = MAX(x, 0), x1 = MIN(x + w, SSD1306_WIDTH) - 1;
+    int y0 = MAX(y, 0), y1 = MIN(y + h, SSD1306_HEIGHT) - 1;
+    if (x0 > x1 || y0 > y1)
+        return;
+
+    for (int page = y0 >> 3; page <= y1 >> 3; page++) {
+        // Linhas do retângulo dentro desta página
+        int top = MAX(y0 - page * 8, 0);
+        int bottom = MIN(y1 - page * 8, 7);
+        uint8_t mask = (uint8_t)((0xFF << top) & (0xFF >> (7 - bottom)));
+        ssd1306_fill_page(page, x0, x1, mask, color);
+    }
+}
+
+/**
+ * @brief Desloca um intervalo de páginas uma página para cima
+ * 
+ * Compara coluna a coluna a página com a seguinte e só marca como suja a
+ * faixa que mudou.
+ * 
+ * @param page_first Primeira página do intervalo
+ * @param page_last Última página do intervalo (inclusiva)
+ */
+void ssd1306_scroll_pages(int page_first, int page_last) {
+    page_first = MAX(page_first, 0);
+    page_last = MIN(page_last, SSD1306_PAGES - 1);
+
+    for (int page = page_first; page < page_last; page++) {
+        uint8_t *row = &back[page * SSD1306_WIDTH];
+        const uint8_t *next = row + SSD1306_WIDTH;
+        int first = -1, last = -1;
+        for (int x = 0; x < SSD1306_WIDTH; x++) {
+            if (row[x] != next[x]) {
+                row[x] = next[x];
+                if (first < 0)
+                    first = x;
+                last = x;
+            }
+        }
+        if (first >= 0)
+            ssd1306_mark_dirty(&back_dirty, page, first, last);
+    }
+    if (page_first <= page_last)
+        ssd1306_fill_page(page_last, 0, SSD1306_WIDTH - 1, 0xFF, false);
+}
+
+/**
+ * @brief Copia colunas de um glifo para uma página, preservando os bits fora da máscara
+ * 
+ * Marca como suja apenas a faixa de colunas cujo byte realmente mudou.
+ * 
+ * @param page Página de destino (0 a SSD1306_PAGES - 1)
+ * @param x Coordenada X da coluna 0 do glifo
+ * @param cols Bytes das colunas já deslocados para a página
+ * @param i0 Primeira coluna visível do glifo
+ * @param i1 Última coluna visível do glifo (inclusiva)
+ * @param mask Bits da página cobertos pelo glifo
+ */
+static void ssd1306_blit_page(int page, int x, const uint8_t *cols, int i0, int i1, uint8_t mask) {
+    uint8_t *row = &back[page * SSD1306_WIDTH + x];
+    int first = -1, last = -1;
+
+    for (int i = i0; i <= i1; i++) {
+        uint8_t value = (row[i] & ~mask) | (cols[i] & mask);
+        if (value != row[i]) {
+            row[i] = value;
+            if (first < 0)
+                first = i;
+            last = i;
+        }
+    }
+    if (first >= 0)
+        ssd1306_mark_dirty(&back_dirty, page, x + first, x + last);
+}
+
+/**
+ * @brief Desenha as colunas visíveis de um caractere já recortado
+ * 
+ * Com y alinhado a uma página as 5 colunas da fonte são copiadas
+ * diretamente no buffer (memcpy). Caso contrário cada coluna é dividida
+ * entre duas páginas por deslocamento e máscara.
+ * 
+ * @param x Coordenada X inicial
+ * @param y Coordenada Y inicial (-7 a SSD1306_HEIGHT - 1)
+ * @param c Caractere a ser desenhado
+ * @param color true para pixels acesos, false para apagados
+ * @param i0 Primeira coluna visível (0-4)
+ * @param i1 Última coluna visível (0-4, inclusiva)
+ */
+static void ssd1306_blit_char(int x, int y, char c, bool color, int i0, int i1) {
+    if (c < 32 || c > 126)
+        return;
+
+    const uint8_t *glyph = font5x7[c - 32];
+    uint8_t cols[5];
+    for (int i = i0; i <= i1; i++)
+        cols[i] = color ? glyph[i] : (uint8_t)~glyph[i];
+
+    int shift = y & 7;
+    int page = y >> 3; // Deslocamento aritmético: -1 para y entre -7 e -1
+
+    // Caminho rápido: o glifo ocupa exatamente uma página
+    if (shift == 0) {
+        uint8_t *row = &back[page * SSD1306_WIDTH + x];
+        int len = i1 - i0 + 1;
+        if (memcmp(&row[i0], &cols[i0], len) != 0) {
+            memcpy(&row[i0], &cols[i0], len);
+            ssd1306_mark_dirty(&back_dirty, page, x + i0, x + i1);
+        }
+        return;
+    }
+
+    uint8_t low[5], high[5];
+    for (int i = i0; i <= i1; i++) {
+        low[i] = cols[i] << shift;
+        high[i] = cols[i] >> (8 - shift);
+    }
+    if (page >= 0)
+        ssd1306_blit_page(page, x, low, i0, i1, (uint8_t)(0xFF << shift));
+    if (page + 1 < SSD1306_PAGES)
+        ssd1306_blit_page(page + 1, x, high, i0, i1, 0xFF >> (8 - shift));
 }
 
 /**
@@ -268,30 +1252,145 @@ void ssd1306_draw_pixel(int x, int y, bool color) {
  * @param color true para pixels acesos, false para apagados
  */
 void ssd1306_draw_char(int x, int y, char c, bool color) {
-    if (c < 32 || c > 126)
+    if (y <= -8 || y >= SSD1306_HEIGHT || x <= -5 || x >= SSD1306_WIDTH)
         return;
 
-    // Desenha cada coluna do caractere
-    for (int i = 0; i < 5; i++) {
-        uint8_t line = font5x7[c - 32][i];
-        for (int j = 0; j < 8; j++) {
-            ssd1306_draw_pixel(x + i, y + j, (line & 0x01) ? color : !color);
-            line >>= 1;
-        }
-    }
+    int i0 = x < 0 ? -x : 0;
+    int i1 = x + 4 >= SSD1306_WIDTH ? SSD1306_WIDTH - 1 - x : 4;
+    ssd1306_blit_char(x, y, c, color, i0, i1);
 }
 
 /**
  * @brief Desenha uma string no display
  * 
+ * O recorte vertical é avaliado uma única vez para a string; na horizontal
+ * só o primeiro e o último caractere visíveis são recortados.
+ * 
  * @param x Coordenada X inicial
  * @param y Coordenada Y inicial
  * @param str String a ser desenhada
  * @param color true para pixels acesos, false para apagados
  */
 void ssd1306_draw_string(int x, int y, const char *str, bool color) {
-    while (*str) {
-        ssd1306_draw_char(x, y, *str++, color);
+    if (y <= -8 || y >= SSD1306_HEIGHT)
+        return;
+
+    // Pula os caracteres totalmente à esquerda do display
+    while (*str && x <= -5) {
+        str++;
         x += 6; // Avançar 6 pixels (5 de largura + 1 de espaço)
     }
-}
\ No newline at end of file
+
+    while (*str && x < SSD1306_WIDTH) {
+        int i0 = x < 0 ? -x : 0;
+        int i1 = x + 4 >= SSD1306_WIDTH ? SSD1306_WIDTH - 1 - x : 4;
+        ssd1306_blit_char(x, y, *str++, color, i0, i1);
+        x += 6;
+    }
+}
+
+/**
+ * @brief Copia colunas inteiras de um sprite do atlas para o buffer
+ * 
+ * As páginas de cada coluna do sprite são bytes consecutivos. Com y
+ * alinhado a uma página cada byte vai direto para o buffer; caso
+ * contrário cada byte é dividido entre duas páginas por deslocamento e
+ * máscara. Só a faixa de colunas que realmente mudou em cada página é
+ * marcada como suja.
+ * 
+ * @param x Coordenada X da primeira coluna
+ * @param y Coordenada Y do topo
+ * @param data Colunas do sprite
+ * @param width Largura em colunas
+ * @param pages Altura em páginas
+ * @param color true para pixels acesos, false para o sprite invertido
+ */
+static void ssd1306_blit_columns(int x, int y, const uint8_t *data, int width, int pages, bool color) {
+    if (y <= -8 * pages || y >= SSD1306_HEIGHT || x <= -width || x >= SSD1306_WIDTH)
+        return;
+
+    int i0 = x < 0 ? -x : 0;
+    int i1 = x + width > SSD1306_WIDTH ? SSD1306_WIDTH - 1 - x : width - 1;
+    uint8_t invert = color ? 0x00 : 0xFF;
+    int shift = y & 7;
+    int page = y >> 3; // Deslocamento aritmético: negativo acima do display
+
+    // Um sprite desalinhado alcança uma página a mais
+    for (int k = 0; k < pages + (shift != 0); k++) {
+        if (page + k < 0 || page + k >= SSD1306_PAGES)
+            continue;
+
+        uint8_t *row = &back[(page + k) * SSD1306_WIDTH + x];
+        int first = -1, last = -1;
+
+        if (shift == 0) {
+            // Caminho rápido: cada byte do sprite é um byte da página
+            for (int i = i0; i <= i1; i++) {
+                uint8_t value = data[i * pages + k] ^ invert;
+                if (value != row[i]) {
+                    row[i] = value;
+                    if (first < 0)
+                        first = i;
+                    last = i;
+                }
+            }
+        } else {
+            // Bits do sprite que caem nesta página: fim da página k - 1, início da k
+            uint8_t mask = k == 0 ? (uint8_t)(0xFF << shift) : k == pages ? 0xFF >> (8 - shift) : 0xFF;
+            for (int i = i0; i <= i1; i++) {
+                const uint8_t *col = &data[i * pages];
+                uint8_t below = k < pages ? col[k] ^ invert : 0;
+                uint8_t above = k > 0 ? col[k - 1] ^ invert : 0;
+                uint8_t bits = (uint8_t)(below << shift | above >> (8 - shift));
+                uint8_t value = (row[i] & ~mask) | (bits & mask);
+                if (value != row[i]) {
+                    row[i] = value;
+                    if (first < 0)
+                        first = i;
+                    last = i;
+                }
+            }
+        }
+        if (first >= 0)
+            ssd1306_mark_dirty(&back_dirty, page + k, x + first, x + last);
+    }
+}
+
+/**
+ * @brief Desenha uma string com a fonte ampliada
+ * 
+ * @param x Coordenada X inicial
+ * @param y Coordenada Y inicial
+ * @param str String a ser desenhada
+ * @param scale Ampliação: 1, 2 ou 3
+ * @param color true para texto aceso, false para texto apagado em fundo aceso
+ */
+void ssd1306_draw_string_scaled(int x, int y, const char *str, int scale, bool color) {
+    if (scale == 1) {
+        ssd1306_draw_string(x, y, str, color);
+        return;
+    }
+    if (scale != 2 && scale != 3)
+        return;
+
+    for (; *str && x < SSD1306_WIDTH; str++, x += 6 * scale) {
+        if (*str < 32 || *str > 126)
+            continue;
+        const uint8_t *glyph = scale == 2 ? font_x2[*str - 32] : font_x3[*str - 32];
+        ssd1306_blit_columns(x, y, glyph, 5 * scale, scale, color);
+    }
+}
+
+/**
+ * @brief Desenha um ícone do atlas
+ * 
+ * @param x Coordenada X da primeira coluna
+ * @param y Coordenada Y do topo
+ * @param icon Ícone a ser desenhado
+ * @param color true para ícone aceso, false para ícone apagado em fundo aceso
+ */
+void ssd1306_draw_icon(int x, int y, ssd1306_icon icon, bool color) {
+    if ((unsigned)icon >= count_of(icons))
+        return;
+    ssd1306_blit_columns(x, y, icons[icon], SSD1306_ICON_WIDTH, SSD1306_PAGES, color);
+}
@@ -36,11 +36,69 @@
  #include <string.h>             // Para memcpy e memset
  
  /**
-  * @brief Definições básicas do display OLED SSD1306
+  * @brief Painéis suportados, escolhidos em tempo de compilação
+  * 
+  * SSD1306_PANEL seleciona a geometria, a sequência de inicialização e o
+  * modo de endereçamento (definido pelo CMake, TRAFFIC_LIGHT_DISPLAY_PANEL).
+  * Cada build contém apenas o código do seu painel, sem testes em tempo
+  * de execução:
+  * - SSD1306_PANEL_128X64: SSD1306 128x64, endereçamento horizontal.
+  * - SSD1306_PANEL_128X32: SSD1306 128x32, endereçamento horizontal.
+  * - SSD1306_PANEL_SH1106: SH1106 128x64 (GDDRAM de 132 colunas, painel
+  *   centrado a partir da coluna 2), apenas endereçamento por página.
+  */
+ #define SSD1306_PANEL_128X64 1
+ #define SSD1306_PANEL_128X32 2
+ #define SSD1306_PANEL_SH1106 3
+ 
+ #ifndef SSD1306_PANEL
+ #define SSD1306_PANEL SSD1306_PANEL_128X64
+ #endif
+ 
+ /**
+  * @brief Definições básicas do display OLED
   */
  #define SSD1306_I2C_ADDR 0x3C   // Endereço I2C padrão do display
  #define SSD1306_WIDTH 128       // Largura do display em pixels
+ #if SSD1306_PANEL == SSD1306_PANEL_128X32
+ #define SSD1306_HEIGHT 32       // Altura do display em pixels
+ #elif SSD1306_PANEL == SSD1306_PANEL_128X64 || SSD1306_PANEL == SSD1306_PANEL_SH1106
  #define SSD1306_HEIGHT 64       // Altura do display em pixels
+ #else
+ #error "SSD1306_PANEL: painel desconhecido"
+ #endif
+ #if SSD1306_PANEL == SSD1306_PANEL_SH1106
+ #define SSD1306_COLUMN_OFFSET 2 // Primeira coluna da GDDRAM visível no painel
+ #define SSD1306_PAGE_MODE 1     // Sem endereçamento horizontal: uma janela por página
+ #else
+ #define SSD1306_COLUMN_OFFSET 0
+ #define SSD1306_PAGE_MODE 0
+ #endif
+ #define SSD1306_PAGES (SSD1306_HEIGHT / 8) // Páginas de 8 linhas
+ #define SSD1306_ICON_SCALE (SSD1306_HEIGHT / 16)   // Ampliação dos ícones de 12x16
+ #define SSD1306_ICON_WIDTH (12 * SSD1306_ICON_SCALE) // Largura dos ícones em pixels
+ #define SSD1306_I2C_TIMEOUT_US 20000  // Margem fixa do limite de cada transação bloqueante
+ #define SSD1306_PROBE_LEN 32           // Bytes de cada teste de barramento
+ #define SSD1306_CMD_MAX 32             // Comandos por transação de ssd1306_send_commands()
+ #define SSD1306_WINDOW_OVERHEAD 10     // Bytes extras de cada janela (endereços, controle, comandos)
+ #define SSD1306_POWER_UP_US 100000     // Estabilização do display após o boot
+ 
+ /**
+  * @brief Callback de fim de transferência assíncrona
+  * 
+  * Executado em contexto de interrupção (DMA_IRQ_0).
+  */
+ typedef void (*ssd1306_done_cb_t)(void);
+ 
+ /**
+  * @brief Ícones do atlas de sprites
+  * 
+  * Todos têm SSD1306_ICON_WIDTH colunas e a altura inteira do painel.
+  */
+ typedef enum {
+     SSD1306_ICON_WALK,  // Pedestre andando (siga)
+     SSD1306_ICON_HAND   // Mão espalmada (pare)
+ } ssd1306_icon;
  
  /**
   * @brief Inicializa o display OLED
@@ -49,33 +107,129 @@
   * Deve ser chamada antes de qualquer outra função do display.
   * 
   * @param i2c Ponteiro para a instância I2C a ser utilizada
+  * @return true se o display respondeu (ACK) a todos os comandos
+  */
+ bool ssd1306_init(i2c_inst_t *i2c);
+ 
+ /**
+  * @brief Envia uma lista de comandos em uma única transação I2C
+  * 
+  * Usa um único byte de controle 0x00 para toda a lista, em vez de uma
+  * transação (START, endereço, controle, comando, STOP) por comando.
+  * 
+  * @param i2c Ponteiro para a instância I2C a ser utilizada
+  * @param cmds Comandos e seus parâmetros, na ordem de envio
+  * @param len Quantidade de bytes (até SSD1306_CMD_MAX)
+  * @return true se o display confirmou todos os bytes
   */
- void ssd1306_init(i2c_inst_t *i2c);
+ bool ssd1306_send_commands(i2c_inst_t *i2c, const uint8_t *cmds, size_t len);
+ 
+ /**
+  * @brief Altera a frequência do barramento I2C do display
+  * 
+  * Deve ser usada no lugar de i2c_set_baudrate(): o driver usa a
+  * frequência para calcular o limite de tempo das transferências.
+  * 
+  * @param i2c Ponteiro para a instância I2C a ser utilizada
+  * @param baudrate Frequência desejada em Hz
+  * @return Frequência efetivamente configurada em Hz
+  */
+ uint ssd1306_set_baudrate(i2c_inst_t *i2c, uint baudrate);
+ 
+ /**
+  * @brief Verifica se o display responde na frequência atual
+  * 
+  * Envia comandos NOP, sem efeito visível.
+  * 
+  * @param i2c Ponteiro para a instância I2C a ser utilizada
+  * @return true se todos os bytes foram confirmados a tempo
+  */
+ bool ssd1306_probe(i2c_inst_t *i2c);
+ 
+ /**
+  * @brief Informa se houve falha de barramento desde a última chamada
+  * 
+  * Falhas (NACK ou timeout) podem ocorrer em qualquer update, bloqueante ou
+  * assíncrono. Após uma falha o quadro inteiro é reenviado no próximo
+  * update; cabe à aplicação reduzir a frequência, se desejar.
+  * 
+  * @return true se houve falha; o indicador é limpo
+  */
+ bool ssd1306_take_error();
  
  /**
   * @brief Limpa todo o conteúdo do display
   * 
-  * Apaga todos os pixels do buffer interno.
-  * Para aplicar a mudança, é necessário chamar ssd1306_update().
+  * Apaga todos os pixels do buffer de desenho (back).
+  * Para aplicar a mudança, é necessário chamar ssd1306_present() e
+  * ssd1306_update().
   */
  void ssd1306_clear();
  
+ /**
+  * @brief Publica o quadro desenhado
+  * 
+  * Troca o buffer de desenho (back) com o buffer enviado ao display
+  * (front). As funções de desenho escrevem sempre no back e os updates
+  * leem sempre o front, então um quadro nunca é alterado enquanto é
+  * transmitido. Após a troca o back já contém o quadro publicado, e o
+  * desenho pode continuar de forma incremental.
+  * 
+  * @return true se o quadro foi publicado; false se uma atualização
+  *         assíncrona ainda está em andamento. Nesse caso o quadro é
+  *         descartado sem bloquear e as alterações permanecem no back
+  *         para o próximo present.
+  */
+ bool ssd1306_present();
+ 
  /**
   * @brief Atualiza o conteúdo do display
   * 
-  * Envia o conteúdo do buffer interno para o display.
-  * Deve ser chamada após modificações no buffer para que
+  * Envia o último quadro publicado (front) para o display.
+  * Deve ser chamada após ssd1306_present() para que
   * as alterações sejam visíveis.
   * 
+  * Apenas as páginas e faixas de colunas alteradas desde o último
+  * update são transmitidas; uma alteração pequena (um dígito) custa
+  * algumas centenas de microssegundos em vez de um quadro completo.
+  * 
+  * @param i2c Ponteiro para a instância I2C a ser utilizada
+  * @return true se o envio foi confirmado; false em NACK ou timeout
+  */
+ bool ssd1306_update(i2c_inst_t *i2c);
+ 
+ /**
+  * @brief Atualiza o conteúdo do display sem bloquear a CPU
+  * 
+  * Envia as regiões modificadas em uma única transação I2C alimentada por
+  * DMA. O back pode ser redesenhado durante a transferência; o próximo
+  * quadro só pode ser publicado quando ssd1306_update_busy() retornar
+  * false.
+  * 
   * @param i2c Ponteiro para a instância I2C a ser utilizada
+  * @param done_cb Callback chamado ao fim da transferência (pode ser NULL)
+  * @return true se a transferência foi iniciada (ou nada havia a enviar),
+  *         false se a anterior ainda está em andamento
+  */
+ bool ssd1306_update_async(i2c_inst_t *i2c, ssd1306_done_cb_t done_cb);
+ 
+ /**
+  * @brief Indica se uma atualização assíncrona ainda está em andamento
+  * 
+  * @return true enquanto DMA ou barramento I2C estiverem ocupados
   */
- void ssd1306_update(i2c_inst_t *i2c);
+ bool ssd1306_update_busy();
+ 
+ /**
+  * @brief Bloqueia até o fim da atualização assíncrona em andamento
+  */
+ void ssd1306_update_wait();
  
  /**
   * @brief Define o estado de um pixel específico
   * 
-  * @param x Coordenada X do pixel (0 a 127)
-  * @param y Coordenada Y do pixel (0 a 63)
+  * @param x Coordenada X do pixel (0 a SSD1306_WIDTH - 1)
+  * @param y Coordenada Y do pixel (0 a SSD1306_HEIGHT - 1)
   * @param color true para acender o pixel, false para apagar
   * 
   * @note As coordenadas são verificadas para garantir que estejam
@@ -83,6 +237,34 @@
   */
  void ssd1306_draw_pixel(int x, int y, bool color);
  
+ /**
+  * @brief Preenche um retângulo
+  * 
+  * @param x Coordenada X do canto superior esquerdo
+  * @param y Coordenada Y do canto superior esquerdo
+  * @param w Largura em pixels
+  * @param h Altura em pixels
+  * @param color true para acender os pixels, false para apagar
+  * 
+  * @note O retângulo é recortado nos limites do display. Cada página é
+  *       escrita por máscara, e só as colunas que mudaram são marcadas
+  *       como sujas.
+  */
+ void ssd1306_fill_rect(int x, int y, int w, int h, bool color);
+ 
+ /**
+  * @brief Desloca um intervalo de páginas uma página para cima
+  * 
+  * O conteúdo da primeira página é descartado e a última é apagada, como
+  * em uma lista que rola uma linha de texto. Apenas as colunas cujo byte
+  * mudou são marcadas como sujas, então o update envia só o que difere
+  * de fato entre linhas vizinhas.
+  * 
+  * @param page_first Primeira página do intervalo
+  * @param page_last Última página do intervalo (inclusiva)
+  */
+ void ssd1306_scroll_pages(int page_first, int page_last);
+ 
  /**
   * @brief Desenha um caractere ASCII no display
   * 
@@ -94,7 +276,9 @@
   * @param color true para caractere aceso em fundo apagado,
   *              false para caractere apagado em fundo aceso
   * 
-  * @note Caracteres fora do intervalo ASCII 32-126 são ignorados
+  * @note Caracteres fora do intervalo ASCII 32-126 são ignorados.
+  *       Com y múltiplo de 8 as colunas da fonte são copiadas direto
+  *       para uma página do buffer, sem desenhar pixel a pixel.
   */
  void ssd1306_draw_char(int x, int y, char c, bool color);
  
@@ -116,4 +300,38 @@
   */
  void ssd1306_draw_string(int x, int y, const char *str, bool color);
  
+ /**
+  * @brief Desenha uma string com a fonte 5x7 ampliada
+  * 
+  * As fontes 2x (10x14) e 3x (15x21) são calculadas em tempo de
+  * compilação a partir da fonte 5x7 e ficam na flash, coluna a coluna e
+  * já divididas em páginas. Cada caractere ocupa 6 * scale pixels de
+  * largura e scale páginas de altura.
+  * 
+  * @param x Coordenada X inicial da string
+  * @param y Coordenada Y inicial da string
+  * @param str Ponteiro para a string a ser desenhada
+  * @param scale Ampliação: 1, 2 ou 3 (outros valores não desenham nada)
+  * @param color true para texto aceso em fundo apagado,
+  *              false para texto apagado em fundo aceso
+  * 
+  * @note Com y múltiplo de 8 cada coluna é copiada byte a byte para as
+  *       páginas do buffer, sem desenhar pixel a pixel.
+  */
+ void ssd1306_draw_string_scaled(int x, int y, const char *str, int scale, bool color);
+ 
+ /**
+  * @brief Desenha um ícone do atlas de sprites
+  * 
+  * Os ícones são desenhados em 12x16 e ampliados em tempo de compilação
+  * para a altura do painel (48x64 ou 24x32).
+  * 
+  * @param x Coordenada X da primeira coluna
+  * @param y Coordenada Y do topo (0 para ocupar a altura inteira)
+  * @param icon Ícone a ser desenhado
+  * @param color true para ícone aceso em fundo apagado,
+  *              false para ícone apagado em fundo aceso
+  */
+ void ssd1306_draw_icon(int x, int y, ssd1306_icon icon, bool color);
+ 
  #endif // SSD1306_H
\ No newline at end of file